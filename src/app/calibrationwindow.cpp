@@ -1,5 +1,4 @@
 #include "calibrationwindow.h"
-#include "../drivers/scanners/Knokke.h"
 
 #include <QApplication>
 #include <QCloseEvent>
@@ -17,18 +16,17 @@
 #include <algorithm>
 #include <cmath>
 
-CalibrationWindow::CalibrationWindow(QWidget *parent)
-    : QWidget(parent), m_previewLabel(nullptr), m_previewTimer(nullptr),
-      m_knokke(std::make_unique<Knokke>()), m_frameCounter(0), m_redSlider(nullptr),
-      m_greenSlider(nullptr), m_blueSlider(nullptr), m_redValueLabel(nullptr),
-      m_greenValueLabel(nullptr), m_blueValueLabel(nullptr), m_exposureSlider(nullptr),
-      m_gainSlider(nullptr), m_exposureValueLabel(nullptr), m_gainValueLabel(nullptr),
-      m_redMinLabel(nullptr), m_redMaxLabel(nullptr), m_redAvgLabel(nullptr),
-      m_greenMinLabel(nullptr), m_greenMaxLabel(nullptr), m_greenAvgLabel(nullptr),
-      m_blueMinLabel(nullptr), m_blueMaxLabel(nullptr), m_blueAvgLabel(nullptr),
-      m_saveButton(nullptr), m_motorLeftButton(nullptr), m_motorRightButton(nullptr),
-      m_sharpnessLabel(nullptr), m_sliderUpdateTimer(nullptr), m_sliderUpdatePending(false),
-      m_pendingExposure(100), m_pendingGain(0)
+CalibrationWindow::CalibrationWindow(ScannerService *scanner, QWidget *parent)
+    : QWidget(parent), m_previewLabel(nullptr), m_previewBridge(nullptr), m_scanner(scanner),
+      m_scannerReady(false), m_redSlider(nullptr), m_greenSlider(nullptr), m_blueSlider(nullptr),
+      m_redValueLabel(nullptr), m_greenValueLabel(nullptr), m_blueValueLabel(nullptr),
+      m_exposureSlider(nullptr), m_gainSlider(nullptr), m_exposureValueLabel(nullptr),
+      m_gainValueLabel(nullptr), m_redMinLabel(nullptr), m_redMaxLabel(nullptr),
+      m_redAvgLabel(nullptr), m_greenMinLabel(nullptr), m_greenMaxLabel(nullptr),
+      m_greenAvgLabel(nullptr), m_blueMinLabel(nullptr), m_blueMaxLabel(nullptr),
+      m_blueAvgLabel(nullptr), m_saveButton(nullptr), m_motorLeftButton(nullptr),
+      m_motorRightButton(nullptr), m_sharpnessLabel(nullptr), m_sliderUpdateTimer(nullptr),
+      m_sliderUpdatePending(false), m_pendingExposure(100), m_pendingGain(0)
 {
     setWindowTitle("Scanner Calibration Preview");
     setFixedSize(1920, 400); // Increased height to accommodate all controls including motor buttons
@@ -46,6 +44,13 @@ CalibrationWindow::CalibrationWindow(QWidget *parent)
     m_sliderUpdateTimer->setInterval(100); // 100ms debounce
     connect(m_sliderUpdateTimer, &QTimer::timeout, this, &CalibrationWindow::onSliderUpdateTimeout);
 
+    // Follow the shared scanner across unplug/replug
+    connect(m_scanner, &ScannerService::scannerConnected, this, &CalibrationWindow::setupScanner);
+    connect(m_scanner,
+            &ScannerService::scannerDisconnected,
+            this,
+            &CalibrationWindow::onScannerDisconnected);
+
     // Defer scanner setup until window is shown
     QTimer::singleShot(100, this, &CalibrationWindow::setupScanner);
 }
@@ -286,179 +291,135 @@ void CalibrationWindow::setupUI()
 
 void CalibrationWindow::setupScanner()
 {
-    try
-    {
-        // Initialize and connect to the scanner
-        Knokke::Error initResult = m_knokke->initialize();
-        if (initResult != Knokke::Error::SUCCESS)
-        {
-            m_previewLabel->setText("Failed to initialize scanner");
-            return;
-        }
-
-        Knokke::Error connectResult = m_knokke->connect();
-        if (connectResult != Knokke::Error::SUCCESS)
-        {
-            m_previewLabel->setText("Failed to connect to scanner");
-            return;
-        }
-    }
-    catch (const std::exception &e)
-    {
-        m_previewLabel->setText("Scanner error: " + QString::fromStdString(e.what()));
-        return;
-    }
-    catch (...)
+    // Both the deferred start-up call and scannerConnected can land for the same connection;
+    // a second run would reset sliders the user may already have moved
+    if (m_scannerReady)
     {
-        m_previewLabel->setText("Unknown scanner error");
         return;
     }
 
-    // Read current scanner parameters and set sliders
-    Knokke::BacklightParams currentBacklight;
-    uint32_t                currentExposure;
-    uint16_t                currentGain;
-
-    Knokke::Error backlightResult = m_knokke->getBacklight(currentBacklight);
-    Knokke::Error exposureResult  = m_knokke->getExposureTime(currentExposure);
-    Knokke::Error gainResult      = m_knokke->getGain(currentGain);
-
-    if (backlightResult == Knokke::Error::SUCCESS)
-    {
-        // Temporarily disconnect slider signals to prevent triggering scanner updates
-        m_redSlider->blockSignals(true);
-        m_greenSlider->blockSignals(true);
-        m_blueSlider->blockSignals(true);
-
-        // Set slider values to current backlight values
-        m_redSlider->setValue(static_cast<int>(currentBacklight.red));
-        m_greenSlider->setValue(static_cast<int>(currentBacklight.green));
-        m_blueSlider->setValue(static_cast<int>(currentBacklight.blue));
-
-        // Update value labels
-        m_redValueLabel->setText(QString::number(currentBacklight.red));
-        m_greenValueLabel->setText(QString::number(currentBacklight.green));
-        m_blueValueLabel->setText(QString::number(currentBacklight.blue));
-
-        // Initialize pending backlight values
-        m_pendingBacklight = currentBacklight;
-
-        // Re-enable slider signals
-        m_redSlider->blockSignals(false);
-        m_greenSlider->blockSignals(false);
-        m_blueSlider->blockSignals(false);
-
-        qDebug() << "Set sliders to current backlight values - R:" << currentBacklight.red
-                 << "G:" << currentBacklight.green << "B:" << currentBacklight.blue;
-    }
-    else
+    if (!m_scanner || !m_scanner->isConnected())
     {
-        qDebug() << "Failed to read current backlight values, using defaults";
-    }
-
-    if (exposureResult == Knokke::Error::SUCCESS)
-    {
-        m_exposureSlider->blockSignals(true);
-        m_exposureSlider->setValue(static_cast<int>(currentExposure));
-        m_exposureValueLabel->setText(QString::number(currentExposure) + "μs");
-        m_pendingExposure = currentExposure;
-        m_exposureSlider->blockSignals(false);
-        qDebug() << "Set exposure slider to current value:" << currentExposure;
-    }
-    else
-    {
-        qDebug() << "Failed to read current exposure, using default";
-    }
-
-    if (gainResult == Knokke::Error::SUCCESS)
-    {
-        m_gainSlider->blockSignals(true);
-        // Convert from device units (gain_db * 100) to dB for slider
-        int gainDb = static_cast<int>(currentGain / 100);
-        m_gainSlider->setValue(gainDb);
-        m_gainValueLabel->setText(QString::number(gainDb) + "dB");
-        m_pendingGain = currentGain; // Store original device value
-        m_gainSlider->blockSignals(false);
-        qDebug() << "Set gain slider to current value:" << currentGain << "device units (" << gainDb
-                 << "dB)";
-    }
-    else
-    {
-        qDebug() << "Failed to read current gain, using default";
-    }
-
-    // Start streaming
-    Knokke::Error streamResult = m_knokke->startStreaming();
-    if (streamResult != Knokke::Error::SUCCESS)
-    {
-        m_previewLabel->setText("Failed to start streaming");
+        m_previewLabel->setText("Waiting for scanner...");
         return;
     }
+    m_scannerReady = true;
+
+    // Set sliders from the scanner parameters read by the service when it connected
+    const Knokke::ScannerParams   params           = m_scanner->parameters();
+    const Knokke::BacklightParams currentBacklight = params.backlight;
+    const uint32_t                currentExposure  = params.exposure_time;
+    const uint16_t                currentGain      = params.gain;
+
+    // Temporarily disconnect slider signals to prevent triggering scanner updates
+    m_redSlider->blockSignals(true);
+    m_greenSlider->blockSignals(true);
+    m_blueSlider->blockSignals(true);
+
+    // Set slider values to current backlight values
+    m_redSlider->setValue(static_cast<int>(currentBacklight.red));
+    m_greenSlider->setValue(static_cast<int>(currentBacklight.green));
+    m_blueSlider->setValue(static_cast<int>(currentBacklight.blue));
+
+    // Update value labels
+    m_redValueLabel->setText(QString::number(currentBacklight.red));
+    m_greenValueLabel->setText(QString::number(currentBacklight.green));
+    m_blueValueLabel->setText(QString::number(currentBacklight.blue));
+
+    // Initialize pending backlight values
+    m_pendingBacklight = currentBacklight;
+
+    // Re-enable slider signals
+    m_redSlider->blockSignals(false);
+    m_greenSlider->blockSignals(false);
+    m_blueSlider->blockSignals(false);
+
+    qDebug() << "Set sliders to current backlight values - R:" << currentBacklight.red
+             << "G:" << currentBacklight.green << "B:" << currentBacklight.blue;
+
+    m_exposureSlider->blockSignals(true);
+    m_exposureSlider->setValue(static_cast<int>(currentExposure));
+    m_exposureValueLabel->setText(QString::number(currentExposure) + "μs");
+    m_pendingExposure = currentExposure;
+    m_exposureSlider->blockSignals(false);
+    qDebug() << "Set exposure slider to current value:" << currentExposure;
+
+    m_gainSlider->blockSignals(true);
+    // Convert from device units (gain_db * 100) to dB for slider
+    int gainDb = static_cast<int>(currentGain / 100);
+    m_gainSlider->setValue(gainDb);
+    m_gainValueLabel->setText(QString::number(gainDb) + "dB");
+    m_pendingGain = currentGain; // Store original device value
+    m_gainSlider->blockSignals(false);
+    qDebug() << "Set gain slider to current value:" << currentGain << "device units (" << gainDb
+             << "dB)";
+
+    // The stream and the bridge survive a replug, only take them once
+    if (!m_previewBridge)
+    {
+        m_scanner->acquireStream();
+
+        // Woken by each new frame, the preview only ever renders the newest one
+        m_previewBridge = new FrameSignalBridge(m_scanner, PREVIEW_RATE, this);
+        connect(m_previewBridge,
+                &FrameSignalBridge::frameReady,
+                this,
+                &CalibrationWindow::updatePreview);
+    }
 
     m_previewLabel->setText("Scanner connected. Starting preview...");
 
-    // Start the preview timer
+    // Start delivering frames
     startPreview();
 }
 
+void CalibrationWindow::onScannerDisconnected()
+{
+    m_scannerReady = false;
+    m_previewLabel->setText("Scanner disconnected. Waiting for scanner...");
+}
+
 void CalibrationWindow::startPreview()
 {
-    if (m_previewTimer)
+    // Before the scanner is set up there is nothing to deliver yet
+    if (m_previewBridge)
     {
-        return; // Already running
+        m_previewBridge->start(); // No-op if already running
     }
-
-    m_previewTimer = new QTimer(this);
-    connect(m_previewTimer, &QTimer::timeout, this, &CalibrationWindow::updatePreview);
-    m_previewTimer->start(PREVIEW_INTERVAL_MS);
-
-    m_frameCounter = 0;
 }
 
 void CalibrationWindow::stopPreview()
 {
-    if (m_previewTimer)
+    // Give the stream back to the scanner service, which keeps the device open
+    if (m_previewBridge)
     {
-        m_previewTimer->stop();
-        m_previewTimer->deleteLater();
-        m_previewTimer = nullptr;
-    }
-
-    if (m_knokke)
-    {
-        m_knokke->stopStreaming();
-        m_knokke->disconnect();
+        m_previewBridge->stop();
+        m_previewBridge->deleteLater();
+        m_previewBridge = nullptr;
+        if (m_scanner)
+        {
+            m_scanner->releaseStream();
+        }
     }
 }
 
-void CalibrationWindow::updatePreview()
+void CalibrationWindow::updatePreview(const FrameLease &frame)
 {
-    if (!m_knokke || !m_knokke->isStreaming())
+    // Frames carry the dimensions of the mode they were streamed in (RAW16)
+    const int frameWidth  = frame.info().width;
+    const int frameHeight = frame.info().height;
+    if (frameWidth == 0 || frame.size() != static_cast<size_t>(frameWidth) * frameHeight * 2)
     {
         return;
     }
 
-    // Drop frames to achieve 50fps from 400fps
-    m_frameCounter++;
-    if (m_frameCounter % FRAME_DROP_COUNT != 0)
-    {
-        return;
-    }
-
-    // Get the latest frame from streaming
-    std::vector<uint8_t> frameData(FRAME_BYTES);
-    Knokke::Error        result = m_knokke->getLatestFrame(frameData.data(), FRAME_BYTES);
-
-    if (result != Knokke::Error::SUCCESS)
-    {
-        return;
-    }
+    const uint8_t *frameData = frame.data();
 
     // Convert raw data to OpenCV Mat (12-bit bayer data)
     // Handle little-endian 16-bit data like Python implementation
-    cv::Mat   bayerMat(FRAME_HEIGHT, FRAME_WIDTH, CV_16UC1);
+    cv::Mat   bayerMat(frameHeight, frameWidth, CV_16UC1);
     uint16_t *matData = reinterpret_cast<uint16_t *>(bayerMat.data);
-    for (size_t i = 0; i < FRAME_WIDTH * FRAME_HEIGHT; i++)
+    for (size_t i = 0; i < static_cast<size_t>(frameWidth) * frameHeight; i++)
     {
         // Convert little-endian bytes to uint16_t
         matData[i] = static_cast<uint16_t>(frameData[i * 2]) |
@@ -466,10 +427,10 @@ void CalibrationWindow::updatePreview()
     }
 
     // Convert 12-bit to 8-bit for processing (matching Python implementation)
-    cv::Mat bayer8bit = cv::Mat::zeros(FRAME_HEIGHT, FRAME_WIDTH, CV_8UC1);
-    for (int y = 0; y < FRAME_HEIGHT; y++)
+    cv::Mat bayer8bit = cv::Mat::zeros(frameHeight, frameWidth, CV_8UC1);
+    for (int y = 0; y < frameHeight; y++)
     {
-        for (int x = 0; x < FRAME_WIDTH; x++)
+        for (int x = 0; x < frameWidth; x++)
         {
             uint16_t pixel_value = bayerMat.at<uint16_t>(y, x);
             uint8_t  normalized_value =
@@ -668,7 +629,7 @@ void CalibrationWindow::onRedSliderChanged(int value)
     // Update value label
     m_redValueLabel->setText(QString::number(value));
 
-    if (m_knokke && m_knokke->isConnected())
+    if (m_scanner && m_scanner->isConnected())
     {
         // Update pending backlight values
         m_pendingBacklight.red = static_cast<uint16_t>(value);
@@ -687,7 +648,7 @@ void CalibrationWindow::onGreenSliderChanged(int value)
     // Update value label
     m_greenValueLabel->setText(QString::number(value));
 
-    if (m_knokke && m_knokke->isConnected())
+    if (m_scanner && m_scanner->isConnected())
     {
         // Update pending backlight values
         m_pendingBacklight.green = static_cast<uint16_t>(value);
@@ -706,7 +667,7 @@ void CalibrationWindow::onBlueSliderChanged(int value)
     // Update value label
     m_blueValueLabel->setText(QString::number(value));
 
-    if (m_knokke && m_knokke->isConnected())
+    if (m_scanner && m_scanner->isConnected())
     {
         // Update pending backlight values
         m_pendingBacklight.blue = static_cast<uint16_t>(value);
@@ -725,7 +686,7 @@ void CalibrationWindow::onExposureSliderChanged(int value)
     // Update value label
     m_exposureValueLabel->setText(QString::number(value) + "μs");
 
-    if (m_knokke && m_knokke->isConnected())
+    if (m_scanner && m_scanner->isConnected())
     {
         // Update pending exposure value
         m_pendingExposure     = static_cast<uint32_t>(value);
@@ -744,7 +705,7 @@ void CalibrationWindow::onGainSliderChanged(int value)
     // Update value label to show dB value
     m_gainValueLabel->setText(QString::number(value) + "dB");
 
-    if (m_knokke && m_knokke->isConnected())
+    if (m_scanner && m_scanner->isConnected())
     {
         // Convert dB to device units (multiply by 100)
         m_pendingGain         = static_cast<uint16_t>(value * 100);
@@ -760,42 +721,20 @@ void CalibrationWindow::onGainSliderChanged(int value)
 
 void CalibrationWindow::onSliderUpdateTimeout()
 {
-    if (m_sliderUpdatePending && m_knokke && m_knokke->isConnected())
+    if (m_sliderUpdatePending && m_scanner && m_scanner->isConnected())
     {
-        // Apply the pending backlight changes
-        Knokke::Error backlightResult = m_knokke->setBacklight(m_pendingBacklight);
-        if (backlightResult != Knokke::Error::SUCCESS)
-        {
-            qDebug() << "Failed to set backlight values:" << static_cast<int>(backlightResult);
-        }
-        else
-        {
-            qDebug() << "Backlight updated - R:" << m_pendingBacklight.red
-                     << "G:" << m_pendingBacklight.green << "B:" << m_pendingBacklight.blue;
-        }
-
-        // Apply the pending exposure changes
-        Knokke::Error exposureResult = m_knokke->setExposureTime(m_pendingExposure);
-        if (exposureResult != Knokke::Error::SUCCESS)
-        {
-            qDebug() << "Failed to set exposure time:" << static_cast<int>(exposureResult);
-        }
-        else
-        {
-            qDebug() << "Exposure updated to:" << m_pendingExposure << "us";
-        }
+        // Queue the pending changes on the driver's control thread so the UI never waits on
+        // USB; values still waiting there are replaced rather than sent twice. Failures are
+        // reported through ScannerService::errorOccurred.
+        m_scanner->setBacklight(
+            m_pendingBacklight.red, m_pendingBacklight.green, m_pendingBacklight.blue);
+        m_scanner->setExposureTime(m_pendingExposure);
+        m_scanner->setGain(m_pendingGain);
 
-        // Apply the pending gain changes
-        Knokke::Error gainResult = m_knokke->setGain(m_pendingGain);
-        if (gainResult != Knokke::Error::SUCCESS)
-        {
-            qDebug() << "Failed to set gain:" << static_cast<int>(gainResult);
-        }
-        else
-        {
-            double gainDb = m_pendingGain / 100.0;
-            qDebug() << "Gain updated to:" << m_pendingGain << "device units (" << gainDb << "dB)";
-        }
+        qDebug() << "Parameters queued - R:" << m_pendingBacklight.red
+                 << "G:" << m_pendingBacklight.green << "B:" << m_pendingBacklight.blue
+                 << "Exposure:" << m_pendingExposure << "us"
+                 << "Gain:" << m_pendingGain / 100.0 << "dB";
 
         m_sliderUpdatePending = false;
     }
@@ -835,65 +774,33 @@ double CalibrationWindow::calculateSharpness(const cv::Mat &image)
 
 void CalibrationWindow::onMotorLeftPressed()
 {
-    if (m_knokke && m_knokke->isConnected())
+    if (m_scanner && m_scanner->isConnected())
     {
-        Knokke::Error result = m_knokke->setMotorSpeed(-200 * 1000); // -200 rpm * 1000
-        if (result != Knokke::Error::SUCCESS)
-        {
-            qDebug() << "Failed to set motor speed (left):" << static_cast<int>(result);
-        }
-        else
-        {
-            qDebug() << "Motor set to -200 rpm (left)";
-        }
+        m_scanner->setMotorSpeed(-200 * 1000); // -200 rpm * 1000
     }
 }
 
 void CalibrationWindow::onMotorLeftReleased()
 {
-    if (m_knokke && m_knokke->isConnected())
+    if (m_scanner && m_scanner->isConnected())
     {
-        Knokke::Error result = m_knokke->setMotorSpeed(0);
-        if (result != Knokke::Error::SUCCESS)
-        {
-            qDebug() << "Failed to set motor speed (stop):" << static_cast<int>(result);
-        }
-        else
-        {
-            qDebug() << "Motor stopped (0 rpm)";
-        }
+        m_scanner->setMotorSpeed(0);
     }
 }
 
 void CalibrationWindow::onMotorRightPressed()
 {
-    if (m_knokke && m_knokke->isConnected())
+    if (m_scanner && m_scanner->isConnected())
     {
-        Knokke::Error result = m_knokke->setMotorSpeed(200 * 1000); // +200 rpm * 1000
-        if (result != Knokke::Error::SUCCESS)
-        {
-            qDebug() << "Failed to set motor speed (right):" << static_cast<int>(result);
-        }
-        else
-        {
-            qDebug() << "Motor set to +200 rpm (right)";
-        }
+        m_scanner->setMotorSpeed(200 * 1000); // +200 rpm * 1000
     }
 }
 
 void CalibrationWindow::onMotorRightReleased()
 {
-    if (m_knokke && m_knokke->isConnected())
+    if (m_scanner && m_scanner->isConnected())
     {
-        Knokke::Error result = m_knokke->setMotorSpeed(0);
-        if (result != Knokke::Error::SUCCESS)
-        {
-            qDebug() << "Failed to set motor speed (stop):" << static_cast<int>(result);
-        }
-        else
-        {
-            qDebug() << "Motor stopped (0 rpm)";
-        }
+        m_scanner->setMotorSpeed(0);
     }
 }
 
@@ -907,17 +814,6 @@ void CalibrationWindow::onSaveImageClicked()
         return;
     }
 
-    // Ensure streaming is active for better frame quality
-    if (m_knokke && m_knokke->isConnected() && !m_knokke->isStreaming())
-    {
-        Knokke::Error streamResult = m_knokke->startStreaming();
-        if (streamResult != Knokke::Error::SUCCESS)
-        {
-            QMessageBox::warning(
-                this, "Save Image", "Failed to start streaming for better frame quality.");
-        }
-    }
-
     // Use file dialog to let user choose save location
     QString defaultFilename = QString("scanner_capture_%1.png")
                                   .arg(QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss"));
@@ -1,7 +1,8 @@
 #ifndef CALIBRATIONWINDOW_H
 #define CALIBRATIONWINDOW_H
 
-#include "../drivers/scanners/Knokke.h"
+#include "framesignalbridge.h"
+#include "scannerservice.h"
 #include <QLabel>
 #include <QPushButton>
 #include <QSlider>
@@ -15,7 +16,7 @@ class CalibrationWindow : public QWidget
     Q_OBJECT
 
   public:
-    explicit CalibrationWindow(QWidget *parent = nullptr);
+    explicit CalibrationWindow(ScannerService *scanner, QWidget *parent = nullptr);
     ~CalibrationWindow();
 
     void startPreview();
@@ -33,7 +34,9 @@ class CalibrationWindow : public QWidget
     void closeEvent(QCloseEvent *event) override;
 
   private slots:
-    void updatePreview();
+    void setupScanner();
+    void onScannerDisconnected();
+    void updatePreview(const FrameLease &frame);
     void onRedSliderChanged(int value);
     void onGreenSliderChanged(int value);
     void onBlueSliderChanged(int value);
@@ -48,15 +51,15 @@ class CalibrationWindow : public QWidget
 
   private:
     void    setupUI();
-    void    setupScanner();
     cv::Mat demosaicBayer(const cv::Mat &bayerData);
     cv::Mat interpolateChannel(const cv::Mat &channel);
     QImage  matToQImage(const cv::Mat &mat);
     double  calculateSharpness(const cv::Mat &image);
 
-    QLabel                 *m_previewLabel;
-    QTimer                 *m_previewTimer;
-    std::unique_ptr<Knokke> m_knokke;
+    QLabel            *m_previewLabel;
+    FrameSignalBridge *m_previewBridge; // Created once the stream is taken
+    ScannerService    *m_scanner;
+    bool               m_scannerReady; // setupScanner() ran for the current connection
 
     // Backlight control sliders
     QSlider *m_redSlider;
@@ -107,13 +110,8 @@ class CalibrationWindow : public QWidget
     uint32_t                m_pendingExposure;
     uint16_t                m_pendingGain;
 
-    // Frame dropping for 50fps (400fps / 8 = 50fps)
-    int                  m_frameCounter;
-    static constexpr int FRAME_DROP_COUNT    = 8;
-    static constexpr int PREVIEW_INTERVAL_MS = 20; // 50fps = 20ms interval
-    static constexpr int FRAME_WIDTH         = 3840;
-    static constexpr int FRAME_HEIGHT        = 12;
-    static constexpr int FRAME_BYTES         = FRAME_WIDTH * FRAME_HEIGHT * 2; // RAW16 format
+    // The preview renders the newest frame at most this often
+    static constexpr double PREVIEW_RATE = 50.0; // Frames per second
 };
 
 #endif // CALIBRATIONWINDOW_H
@@ -0,0 +1,111 @@
+#include "framesignalbridge.h"
+
+#include <QMetaObject>
+
+FrameSignalBridge::FrameSignalBridge(ScannerService *scanner, double maxRate, QObject *parent)
+    : QObject(parent), m_scanner(scanner),
+      m_minInterval(maxRate > 0 ? std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                      std::chrono::duration<double>(1.0 / maxRate))
+                                : std::chrono::steady_clock::duration::zero()),
+      m_running(false), m_pending(false), m_generation(0)
+{
+    // Lets receivers on other threads connect with a queued connection of their own
+    qRegisterMetaType<FrameLease>();
+}
+
+FrameSignalBridge::~FrameSignalBridge() { stop(); }
+
+void FrameSignalBridge::start()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_running)
+    {
+        return;
+    }
+
+    m_running = true;
+    m_pending = false;
+    m_thread  = std::thread(&FrameSignalBridge::run, this);
+}
+
+void FrameSignalBridge::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running)
+        {
+            return;
+        }
+        m_running = false;
+        ++m_generation;
+    }
+    m_condition.notify_all();
+
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+}
+
+bool FrameSignalBridge::isRunning() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_running;
+}
+
+void FrameSignalBridge::run()
+{
+    uint64_t lastFrame = Knokke::NO_FRAME;
+    auto     nextFrame = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_running)
+    {
+        // One frame in flight at a time, and none sooner than the rate allows
+        m_condition.wait(lock, [this] { return !m_running || !m_pending; });
+        if (m_condition.wait_until(lock, nextFrame, [this] { return !m_running; }))
+        {
+            break;
+        }
+        const uint64_t generation = m_generation;
+        lock.unlock();
+
+        // Times out while the stream is down and picks it up again once it runs
+        FrameLease          frame;
+        const Knokke::Error result = m_scanner->waitForFrame(lastFrame, frame, WAIT_MS);
+
+        lock.lock();
+        if (result != Knokke::Error::SUCCESS)
+        {
+            continue;
+        }
+
+        lastFrame = frame.info().frameNumber;
+        nextFrame = std::chrono::steady_clock::now() + m_minInterval;
+        m_pending = true;
+        QMetaObject::invokeMethod(
+            this,
+            [this, frame, generation]() { deliver(frame, generation); },
+            Qt::QueuedConnection);
+    }
+}
+
+void FrameSignalBridge::deliver(const FrameLease &frame, uint64_t generation)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (generation != m_generation)
+        {
+            return;
+        }
+    }
+
+    emit frameReady(frame);
+
+    // The receiver is done with it, let the worker fetch the next one
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending = false;
+    }
+    m_condition.notify_all();
+}
@@ -0,0 +1,70 @@
+#ifndef FRAMESIGNALBRIDGE_H
+#define FRAMESIGNALBRIDGE_H
+
+#include "scannerservice.h"
+
+#include <QMetaType>
+#include <QObject>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+Q_DECLARE_METATYPE(FrameLease)
+
+/**
+ * @brief Delivers streamed frames to the thread the bridge lives on as a Qt signal
+ *
+ * A worker thread blocks in ScannerService::waitForFrame() and hands each new frame over with a
+ * queued call, so receivers wake when a frame has arrived instead of polling for one. Frames
+ * are leased, never copied. At most one frame is in flight to the receiver, and frames come
+ * no faster than the requested rate; anything newer that arrives in the meantime replaces the
+ * frame that would have been sent, so a slow receiver always gets the latest.
+ */
+class FrameSignalBridge : public QObject
+{
+    Q_OBJECT
+
+  public:
+    /**
+     * @param scanner Service whose stream is bridged
+     * @param maxRate Most frames per second to emit, 0 for as many as the receiver takes
+     * @param parent Owner; frameReady() is emitted on the thread this object lives on
+     */
+    FrameSignalBridge(ScannerService *scanner, double maxRate, QObject *parent = nullptr);
+    ~FrameSignalBridge();
+
+    /**
+     * @brief Start the worker thread; frames arrive once the stream runs
+     */
+    void start();
+
+    /**
+     * @brief Stop the worker thread; frames already queued are discarded
+     */
+    void stop();
+
+    bool isRunning() const;
+
+  signals:
+    void frameReady(const FrameLease &frame);
+
+  private:
+    void run();
+    void deliver(const FrameLease &frame, uint64_t generation);
+
+    ScannerService                           *m_scanner;
+    const std::chrono::steady_clock::duration m_minInterval;
+    std::thread                               m_thread;
+
+    // Shared between the worker and the receiving thread
+    mutable std::mutex      m_mutex;
+    std::condition_variable m_condition;
+    bool                    m_running;
+    bool                    m_pending;    // A frame is queued to the receiving thread
+    uint64_t                m_generation; // Frames queued before the last stop() are dropped
+
+    static constexpr int WAIT_MS = 100; // Longest stop() waits for the worker
+};
+
+#endif // FRAMESIGNALBRIDGE_H
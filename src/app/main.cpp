@@ -1,7 +1,9 @@
 #include "mainwindow.h"
+#include "scannerservice.h"
 #include "scannerwaitdialog.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
 #include <QMessageBox>
 
 int main(int argc, char *argv[])
@@ -13,19 +15,51 @@ int main(int argc, char *argv[])
     a.setApplicationVersion("1.0");
     a.setOrganizationName("Soke");
 
+    // Without a scanner, --replay serves a recording instead; Qt's "-platform offscreen" runs
+    // the whole application on a machine without a display
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Korova film scanner");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    QCommandLineOption replayOption("replay",
+                                    "Play <file> (journal, raw or PNG strip), not the scanner.",
+                                    "file");
+    QCommandLineOption fastOption("replay-fast", "Replay as fast as possible, not in real time.");
+    QCommandLineOption loopOption("replay-loop", "Start the replay over when it ends.");
+    parser.addOptions({replayOption, fastOption, loopOption});
+    parser.process(a);
+
     try
     {
+        std::unique_ptr<KnokkeTransport> replay;
+        if (parser.isSet(replayOption))
+        {
+            replay = ScannerService::openReplay(
+                parser.value(replayOption), !parser.isSet(fastOption), parser.isSet(loopOption));
+            if (!replay)
+            {
+                QMessageBox::critical(
+                    nullptr, "Error", QString("Cannot replay %1").arg(parser.value(replayOption)));
+                return 1;
+            }
+        }
+
+        // Single owner of the scanner for the lifetime of the application
+        ScannerService scanner(std::move(replay));
+        scanner.start();
+        QObject::connect(&a, &QApplication::aboutToQuit, [&scanner]() { scanner.stop(); });
+
         // Create and show the scanner wait dialog
-        ScannerWaitDialog waitDialog;
+        ScannerWaitDialog waitDialog(&scanner);
 
         // Connect signals
         QObject::connect(&waitDialog,
                          &ScannerWaitDialog::scannerDetected,
-                         [&waitDialog, &a]()
+                         [&waitDialog, &a, &scanner]()
                          {
                              // Scanner found, create and show main window
                              std::cout << "Creating MainWindow..." << std::endl;
-                             MainWindow *mainWindow = new MainWindow();
+                             MainWindow *mainWindow = new MainWindow(&scanner);
                              std::cout << "MainWindow created successfully" << std::endl;
                              mainWindow->show();
                              std::cout << "MainWindow shown successfully" << std::endl;
@@ -8,7 +8,8 @@
 #include <QVBoxLayout>
 #include <opencv2/opencv.hpp>
 
-MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWindow)
+MainWindow::MainWindow(ScannerService *scanner, QWidget *parent)
+    : QMainWindow(parent), ui(new Ui::MainWindow), m_scanner(scanner)
 {
     std::cout << "MainWindow constructor started" << std::endl;
     ui->setupUi(this);
@@ -407,7 +408,7 @@ void MainWindow::on_actionCalibration_triggered()
     // Create or reuse calibration window
     if (m_calibrationWindow == nullptr)
     {
-        m_calibrationWindow = new CalibrationWindow(this);
+        m_calibrationWindow = new CalibrationWindow(m_scanner, this);
 
         // Connect to the calibration window's signals
         connect(m_calibrationWindow,
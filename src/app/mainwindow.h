@@ -3,6 +3,7 @@
 
 #include "calibrationwindow.h"
 #include "imageviewer.h"
+#include "scannerservice.h"
 #include "thumbnailcontainer.h"
 #include <QMainWindow>
 
@@ -18,7 +19,7 @@ class MainWindow : public QMainWindow
     Q_OBJECT
 
   public:
-    MainWindow(QWidget *parent = nullptr);
+    MainWindow(ScannerService *scanner, QWidget *parent = nullptr);
     ~MainWindow();
 
   private slots:
@@ -78,6 +79,9 @@ class MainWindow : public QMainWindow
     ThumbnailContainer *m_thumbnailContainer;
     int                 m_lastFocusedThumbnailIndex;
 
+    // Shared scanner owner
+    ScannerService *m_scanner;
+
     // Calibration window reference
     CalibrationWindow *m_calibrationWindow;
 
@@ -0,0 +1,413 @@
+#include "scannerservice.h"
+
+#include "../drivers/scanners/ReplayTransport.h"
+
+#include <QImage>
+#include <QMetaObject>
+#include <QTimer>
+#include <QtEndian>
+#include <iostream>
+
+ScannerService::ScannerService(QObject *parent) : ScannerService(nullptr, parent) {}
+
+ScannerService::ScannerService(std::unique_ptr<KnokkeTransport> transport, QObject *parent)
+    : QObject(parent), m_context(new QObject()), m_retryTimer(nullptr),
+      m_knokke(transport ? std::make_unique<Knokke>(std::move(transport))
+                         : std::make_unique<Knokke>()),
+      m_connected(false), m_streaming(false), m_present(false), m_streamUsers(0)
+{
+    m_thread.setObjectName("ScannerService");
+    m_context->moveToThread(&m_thread);
+
+    // Driver errors can come from any of its threads; signals are safe to emit from there
+    m_knokke->setErrorCallback(
+        [this](Knokke::Error error, const std::string &message)
+        {
+            emit errorOccurred(QString::fromStdString(message));
+
+            // The driver gave up on the stream by itself, catch up on the worker thread
+            if (error == Knokke::Error::STREAM_LOST)
+            {
+                runOnDevice(
+                    [this]()
+                    {
+                        if (m_streaming && !m_knokke->isStreaming())
+                        {
+                            m_streaming = false;
+                            emit streamingStopped();
+                        }
+                    });
+            }
+        });
+}
+
+ScannerService::~ScannerService()
+{
+    // m_context and the timers parented to it live on the worker thread and must be deleted
+    // there, after the last event queued to them
+    if (m_thread.isRunning())
+    {
+        connect(&m_thread, &QThread::finished, m_context, &QObject::deleteLater);
+        stop();
+    }
+    else
+    {
+        // The worker never ran or has already finished, so no event can reach m_context and
+        // shutdown() stopped its timers
+        delete m_context;
+    }
+}
+
+void ScannerService::start()
+{
+    if (m_thread.isRunning())
+    {
+        return;
+    }
+
+    m_thread.start();
+    runOnDevice([this]() { startMonitor(); });
+}
+
+void ScannerService::stop()
+{
+    if (!m_thread.isRunning())
+    {
+        return;
+    }
+
+    QMetaObject::invokeMethod(m_context, [this]() { shutdown(); }, Qt::BlockingQueuedConnection);
+    m_thread.quit();
+    m_thread.wait();
+}
+
+std::unique_ptr<KnokkeTransport>
+ScannerService::openReplay(const QString &path, bool realTime, bool loop)
+{
+    FrameMode mode;
+    mode.formatIndex   = Knokke::DEFAULT_FORMAT_INDEX;
+    mode.frameIndex    = Knokke::DEFAULT_FRAME_INDEX;
+    mode.width         = Knokke::DEFAULT_FRAME_WIDTH;
+    mode.height        = Knokke::DEFAULT_FRAME_HEIGHT;
+    mode.bitsPerPixel  = Knokke::DEFAULT_BITS_PER_PIXEL;
+    mode.frameInterval = Knokke::DEFAULT_FRAME_INTERVAL;
+
+    std::unique_ptr<ReplaySource> source;
+    if (path.endsWith(".png", Qt::CaseInsensitive))
+    {
+        // The driver knows nothing about images, decode the strip into frames here
+        const QImage image = QImage(path).convertToFormat(QImage::Format_Grayscale16);
+        if (image.isNull())
+        {
+            std::cout << "Cannot read " << path.toStdString() << std::endl;
+            return nullptr;
+        }
+
+        mode.width = static_cast<uint16_t>(image.width());
+        std::vector<std::vector<uint8_t>> frames(image.height() / mode.height);
+        for (size_t i = 0; i < frames.size(); ++i)
+        {
+            frames[i].resize(mode.frameBytes());
+            uint8_t *frame = frames[i].data();
+            for (int line = 0; line < mode.height; ++line)
+            {
+                const auto *pixels = reinterpret_cast<const quint16 *>(
+                    image.constScanLine(static_cast<int>(i) * mode.height + line));
+                for (int x = 0; x < mode.width; ++x)
+                {
+                    qToLittleEndian(pixels[x], frame);
+                    frame += 2;
+                }
+            }
+        }
+        if (!frames.empty())
+        {
+            source = std::make_unique<MemoryReplaySource>(mode, std::move(frames));
+        }
+    }
+    else
+    {
+        source = ReplaySource::openFile(path.toStdString(), mode);
+    }
+
+    if (!source)
+    {
+        return nullptr;
+    }
+    return std::make_unique<ReplayTransport>(std::move(source),
+                                             realTime
+                                                 ? ReplayTransport::Pacing::REAL_TIME
+                                                 : ReplayTransport::Pacing::AS_FAST_AS_POSSIBLE,
+                                             loop);
+}
+
+bool ScannerService::isConnected() const { return m_connected; }
+
+bool ScannerService::isStreaming() const { return m_streaming; }
+
+Knokke::ScannerParams ScannerService::parameters() const
+{
+    std::lock_guard<std::mutex> lock(m_paramsMutex);
+    return m_params;
+}
+
+std::vector<FrameMode> ScannerService::frameModes() const { return m_knokke->getFrameModes(); }
+
+void ScannerService::setFrameMode(const FrameMode &mode)
+{
+    runOnDevice(
+        [this, mode]()
+        {
+            // The mode is fixed while streaming; subscribers see frames of the new size as soon
+            // as the stream comes back
+            if (m_streaming)
+            {
+                m_knokke->stopStreaming();
+                m_streaming = false;
+                emit streamingStopped();
+            }
+
+            Knokke::Error result = m_knokke->setFrameMode(mode);
+            if (result != Knokke::Error::SUCCESS)
+            {
+                emit errorOccurred(QString::fromStdString(Knokke::getErrorMessage(result)));
+            }
+
+            updateStreaming();
+        });
+}
+
+std::shared_ptr<FrameSubscription>
+ScannerService::subscribe(const FrameSubscription::Options &options)
+{
+    return m_knokke->subscribe(options);
+}
+
+void ScannerService::unsubscribe(const std::shared_ptr<FrameSubscription> &subscription)
+{
+    m_knokke->unsubscribe(subscription);
+}
+
+Knokke::Error
+ScannerService::waitForFrame(uint64_t afterFrameNumber, FrameLease &frame, int timeoutMs)
+{
+    return m_knokke->waitForFrame(afterFrameNumber, frame, timeoutMs);
+}
+
+void ScannerService::acquireStream()
+{
+    runOnDevice(
+        [this]()
+        {
+            ++m_streamUsers;
+            updateStreaming();
+        });
+}
+
+void ScannerService::releaseStream()
+{
+    runOnDevice(
+        [this]()
+        {
+            if (m_streamUsers > 0)
+            {
+                --m_streamUsers;
+            }
+            updateStreaming();
+        });
+}
+
+void ScannerService::setExposureTime(uint32_t exposureTime)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_paramsMutex);
+        m_params.exposure_time = exposureTime;
+    }
+    runOnDevice([this, exposureTime]() { m_knokke->setExposureTimeAsync(exposureTime); });
+    emit parametersChanged();
+}
+
+void ScannerService::setGain(uint16_t gain)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_paramsMutex);
+        m_params.gain = gain;
+    }
+    runOnDevice([this, gain]() { m_knokke->setGainAsync(gain); });
+    emit parametersChanged();
+}
+
+void ScannerService::setBacklight(uint16_t red, uint16_t green, uint16_t blue)
+{
+    Knokke::BacklightParams backlight;
+    backlight.red   = red;
+    backlight.green = green;
+    backlight.blue  = blue;
+
+    {
+        std::lock_guard<std::mutex> lock(m_paramsMutex);
+        m_params.backlight = backlight;
+    }
+    runOnDevice([this, backlight]() { m_knokke->setBacklightAsync(backlight); });
+    emit parametersChanged();
+}
+
+void ScannerService::setMotorSpeed(int32_t speed)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_paramsMutex);
+        m_params.motor_speed = speed;
+    }
+    runOnDevice(
+        [this, speed]()
+        {
+            // Motor moves are rare and watched by the user, so report how the write went instead
+            // of leaving it to the coalescing queue
+            Knokke::Error result = m_knokke->setMotorSpeedAsync(speed).get();
+            if (result != Knokke::Error::SUCCESS)
+            {
+                std::cout << "Motor speed " << speed / 1000 << " rpm not set: "
+                          << Knokke::getErrorMessage(result) << std::endl;
+                emit errorOccurred(QString::fromStdString(Knokke::getErrorMessage(result)));
+                return;
+            }
+            std::cout << "Motor speed set to " << speed / 1000 << " rpm" << std::endl;
+        });
+    emit parametersChanged();
+}
+
+void ScannerService::runOnDevice(std::function<void()> task)
+{
+    QMetaObject::invokeMethod(m_context, std::move(task), Qt::QueuedConnection);
+}
+
+void ScannerService::startMonitor()
+{
+    m_retryTimer = new QTimer(m_context);
+    m_retryTimer->setSingleShot(true);
+    m_retryTimer->setInterval(CONNECT_RETRY_MS);
+    QObject::connect(m_retryTimer, &QTimer::timeout, m_context, [this]() { tryConnect(); });
+
+    // Arrivals are reported from Knokke's monitor thread, including a scanner that is already
+    // plugged in; handle them here on the worker thread
+    Knokke::Error result = m_knokke->startHotplugMonitor(
+        [this](Knokke::HotplugEvent event)
+        {
+            if (event == Knokke::HotplugEvent::DEVICE_ARRIVED)
+            {
+                runOnDevice([this]() { onScannerArrived(); });
+            }
+            else
+            {
+                runOnDevice([this]() { onScannerLeft(); });
+            }
+        });
+
+    if (result != Knokke::Error::SUCCESS)
+    {
+        // No monitor: keep trying to open the scanner until it shows up
+        std::cout << "Scanner monitor unavailable, polling for the scanner" << std::endl;
+        m_present = true;
+        tryConnect();
+    }
+}
+
+void ScannerService::onScannerArrived()
+{
+    std::cout << "Scanner arrived" << std::endl;
+    m_present = true;
+    tryConnect();
+}
+
+void ScannerService::onScannerLeft()
+{
+    std::cout << "Scanner removed" << std::endl;
+    m_present = false;
+    m_retryTimer->stop();
+
+    if (m_connected)
+    {
+        const bool wasStreaming = m_streaming;
+        m_knokke->disconnect();
+        m_streaming = false;
+        m_connected = false;
+
+        if (wasStreaming)
+        {
+            emit streamingStopped();
+        }
+        emit scannerDisconnected();
+    }
+}
+
+void ScannerService::tryConnect()
+{
+    if (m_connected || !m_present)
+    {
+        return;
+    }
+
+    // The device node may not be usable the instant the scanner arrives, retry until it is
+    if (m_knokke->connect() != Knokke::Error::SUCCESS)
+    {
+        m_retryTimer->start();
+        return;
+    }
+
+    Knokke::ScannerParams params;
+    if (m_knokke->getParameters(params, true) == Knokke::Error::SUCCESS)
+    {
+        std::lock_guard<std::mutex> lock(m_paramsMutex);
+        m_params = params;
+    }
+
+    m_connected = true;
+    emit scannerConnected();
+    emit parametersChanged();
+
+    // Resume the stream for windows that were already using it
+    updateStreaming();
+}
+
+void ScannerService::updateStreaming()
+{
+    if (!m_connected)
+    {
+        return;
+    }
+
+    if (m_streamUsers > 0 && !m_streaming)
+    {
+        if (m_knokke->startStreaming() == Knokke::Error::SUCCESS)
+        {
+            m_streaming = true;
+            emit streamingStarted();
+        }
+    }
+    else if (m_streamUsers == 0 && m_streaming)
+    {
+        m_knokke->stopStreaming();
+        m_streaming = false;
+        emit streamingStopped();
+    }
+}
+
+void ScannerService::shutdown()
+{
+    m_knokke->stopHotplugMonitor();
+
+    if (m_retryTimer)
+    {
+        m_retryTimer->stop();
+    }
+
+    if (m_streaming)
+    {
+        m_knokke->stopStreaming();
+        m_streaming = false;
+    }
+
+    m_knokke->disconnect();
+    m_connected = false;
+    m_present   = false;
+}
@@ -0,0 +1,145 @@
+#ifndef SCANNERSERVICE_H
+#define SCANNERSERVICE_H
+
+#include "../drivers/scanners/Knokke.h"
+
+#include <QObject>
+#include <QString>
+#include <QThread>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+QT_BEGIN_NAMESPACE
+class QTimer;
+QT_END_NAMESPACE
+
+/**
+ * @brief Application-wide owner of the scanner
+ *
+ * One instance is started at launch and handed to every window. It owns the only Knokke and
+ * runs every device operation on its own worker thread, so windows never block on USB and
+ * never open the device themselves. The scanner is opened as soon as it is plugged in and
+ * reopened after it is replugged; streaming is shared between windows and runs while at least
+ * one of them holds a stream reference.
+ */
+class ScannerService : public QObject
+{
+    Q_OBJECT
+
+  public:
+    explicit ScannerService(QObject *parent = nullptr);
+
+    /**
+     * @brief Serve a stand-in for the scanner, e.g. from openReplay()
+     * @param transport Link Knokke uses instead of looking for a scanner; nullptr for the
+     * real scanner
+     */
+    explicit ScannerService(std::unique_ptr<KnokkeTransport> transport, QObject *parent = nullptr);
+    ~ScannerService();
+
+    /**
+     * @brief Open a recording to serve instead of the scanner
+     *
+     * Plays a capture journal, a raw strip or a 16-bit grayscale PNG strip (one image line per
+     * sensor line). Strips are cut into frames of the default mode's height.
+     * @param path File to replay
+     * @param realTime Deliver frames at the mode's frame rate instead of as fast as possible
+     * @param loop Start over after the last frame
+     * @return Transport, or nullptr if the file cannot be replayed
+     */
+    static std::unique_ptr<KnokkeTransport>
+    openReplay(const QString &path, bool realTime, bool loop);
+
+    /**
+     * @brief Start the worker thread and begin watching for the scanner
+     */
+    void start();
+
+    /**
+     * @brief Stop streaming, release the scanner and join the worker thread
+     */
+    void stop();
+
+    bool isConnected() const;
+    bool isStreaming() const;
+
+    /**
+     * @brief Last known scanner parameters, read on connect and updated on every change
+     */
+    Knokke::ScannerParams parameters() const;
+
+    /**
+     * @brief Frame modes the scanner offers (see Knokke::getFrameModes)
+     */
+    std::vector<FrameMode> frameModes() const;
+
+    /**
+     * @brief Switch frame mode, restarting the stream if it is running
+     */
+    void setFrameMode(const FrameMode &mode);
+
+    /**
+     * @brief Subscribe to streamed frames (see Knokke::subscribe); callable from any thread
+     */
+    std::shared_ptr<FrameSubscription> subscribe(const FrameSubscription::Options &options);
+
+    /**
+     * @brief Remove a subscription added with subscribe(); callable from any thread
+     */
+    void unsubscribe(const std::shared_ptr<FrameSubscription> &subscription);
+
+    /**
+     * @brief Wait for a frame newer than afterFrameNumber (see Knokke::waitForFrame); callable
+     * from any thread
+     */
+    Knokke::Error waitForFrame(uint64_t afterFrameNumber, FrameLease &frame, int timeoutMs);
+
+  public slots:
+    // Streaming runs while at least one caller holds a reference
+    void acquireStream();
+    void releaseStream();
+
+    // Parameter writes are queued on the driver's coalescing control thread
+    void setExposureTime(uint32_t exposureTime);
+    void setGain(uint16_t gain);
+    void setBacklight(uint16_t red, uint16_t green, uint16_t blue);
+    void setMotorSpeed(int32_t speed);
+
+  signals:
+    void scannerConnected();
+    void scannerDisconnected();
+    void streamingStarted();
+    void streamingStopped();
+    void parametersChanged();
+    void errorOccurred(const QString &message);
+
+  private:
+    void runOnDevice(std::function<void()> task);
+
+    // Worker thread only
+    void startMonitor();
+    void onScannerArrived();
+    void onScannerLeft();
+    void tryConnect();
+    void updateStreaming();
+    void shutdown();
+
+    QThread                 m_thread;
+    QObject                *m_context;    // Lives on m_thread, receives queued device work
+    QTimer                 *m_retryTimer; // Reopens a scanner that is present but not yet usable
+    std::unique_ptr<Knokke> m_knokke;
+    std::atomic<bool>       m_connected;
+    std::atomic<bool>       m_streaming;
+    bool                    m_present;     // Worker thread only
+    int                     m_streamUsers; // Worker thread only
+
+    mutable std::mutex    m_paramsMutex;
+    Knokke::ScannerParams m_params;
+
+    static constexpr int CONNECT_RETRY_MS = 500;
+};
+
+#endif // SCANNERSERVICE_H
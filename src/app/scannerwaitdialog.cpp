@@ -1,5 +1,5 @@
 #include "scannerwaitdialog.h"
-#include "../drivers/scanners/Knokke.h"
+#include "scannerservice.h"
 
 #include <QApplication>
 #include <QFile>
@@ -14,9 +14,9 @@
 #include <QVBoxLayout>
 #include <iostream>
 
-ScannerWaitDialog::ScannerWaitDialog(QWidget *parent)
+ScannerWaitDialog::ScannerWaitDialog(ScannerService *scanner, QWidget *parent)
     : QDialog(parent), m_statusLabel(nullptr), m_instructionLabel(nullptr), m_cancelButton(nullptr),
-      m_layout(nullptr), m_detectionTimer(nullptr), m_knokke(std::make_unique<Knokke>())
+      m_layout(nullptr), m_detectionTimer(nullptr), m_scanner(scanner), m_scannerReady(false)
 {
     setupUI();
     // Defer scanner detection to avoid immediate USB access
@@ -146,38 +146,16 @@ void ScannerWaitDialog::setupUI()
 void ScannerWaitDialog::startScannerDetection()
 {
     std::cout << "startScannerDetection() called" << std::endl;
-    // First check if scanner is already connected
+
+    // The scanner service opens the scanner the moment it is plugged in
+    connect(m_scanner, &ScannerService::scannerConnected, this, &ScannerWaitDialog::onScannerReady);
     if (isScannerConnected())
     {
-        std::cout << "Scanner is already connected!" << std::endl;
-        m_statusLabel->setText("Knokke scanner found!");
-        m_statusLabel->setStyleSheet(
-            "QLabel { font-size: 14px; font-weight: bold; color: green; }");
-        if (m_instructionLabel)
-        {
-            m_instructionLabel->setText("Opening application...");
-        }
-
-        // Close dialog after a short delay
-        std::cout << "Setting up QTimer::singleShot..." << std::endl;
-        QTimer::singleShot(1000,
-                           this,
-                           [this]()
-                           {
-                               std::cout << "QTimer callback started" << std::endl;
-                               std::cout << "Emitting scannerDetected signal..." << std::endl;
-                               emit scannerDetected();
-                               std::cout << "Signal emitted successfully" << std::endl;
-                               std::cout << "Calling accept()..." << std::endl;
-                               accept();
-                               std::cout << "Dialog closed successfully" << std::endl;
-                           });
-        std::cout << "QTimer::singleShot set up successfully" << std::endl;
+        onScannerReady();
         return;
     }
-    std::cout << "Scanner not connected, starting periodic detection..." << std::endl;
 
-    // Set up timer for periodic checking
+    // Animate the status while waiting
     m_detectionTimer = new QTimer(this);
     connect(m_detectionTimer, &QTimer::timeout, this, &ScannerWaitDialog::checkForScanner);
     m_detectionTimer->start(DETECTION_INTERVAL_MS);
@@ -185,6 +163,11 @@ void ScannerWaitDialog::startScannerDetection()
 
 void ScannerWaitDialog::stopScannerDetection()
 {
+    if (m_scanner)
+    {
+        disconnect(m_scanner, &ScannerService::scannerConnected, this, nullptr);
+    }
+
     if (m_detectionTimer)
     {
         m_detectionTimer->stop();
@@ -197,74 +180,44 @@ void ScannerWaitDialog::checkForScanner()
 {
     if (isScannerConnected())
     {
-        stopScannerDetection();
-
-        m_statusLabel->setText("Connected!");
-        m_statusLabel->setStyleSheet(
-            "QLabel { font-size: 14px; font-weight: bold; color: green; }");
-
-        // Close dialog after a short delay
-        QTimer::singleShot(1000,
-                           this,
-                           [this]()
-                           {
-                               emit scannerDetected();
-                               accept();
-                           });
-    }
-    else
-    {
-        // Update status to show we're still connecting
-        static int dotCount = 0;
-        dotCount            = (dotCount + 1) % 4;
-        QString dots        = QString(".").repeated(dotCount);
-        m_statusLabel->setText(QString("Connecting to Knokke%1").arg(dots));
+        onScannerReady();
+        return;
     }
-}
 
-void ScannerWaitDialog::onCancelClicked()
-{
-    // Cancel button removed in simplified UI
-    // This method is kept for compatibility but won't be called
+    // Update status to show we're still connecting
+    static int dotCount = 0;
+    dotCount            = (dotCount + 1) % 4;
+    QString dots        = QString(".").repeated(dotCount);
+    m_statusLabel->setText(QString("Connecting to Knokke%1").arg(dots));
 }
 
-bool ScannerWaitDialog::isScannerConnected()
+void ScannerWaitDialog::onScannerReady()
 {
-    if (!m_knokke)
+    if (m_scannerReady)
     {
-        return false;
+        return;
     }
 
-    try
-    {
-        // Initialize libusb if not already done
-        Knokke::Error initResult = m_knokke->initialize();
-        if (initResult != Knokke::Error::SUCCESS)
-        {
-            return false;
-        }
+    m_scannerReady = true;
+    stopScannerDetection();
 
-        // Try to connect to the scanner
-        Knokke::Error connectResult = m_knokke->connect();
-        if (connectResult == Knokke::Error::SUCCESS)
-        {
-            // Disconnect immediately since we just wanted to check if it's available
-            m_knokke->disconnect();
-            return true;
-        }
+    m_statusLabel->setText("Connected!");
+    m_statusLabel->setStyleSheet("QLabel { font-size: 14px; font-weight: bold; color: green; }");
 
-        return false;
-    }
-    catch (const std::exception &e)
-    {
-        // Log error but don't crash
-        std::cerr << "Scanner detection error: " << e.what() << std::endl;
-        return false;
-    }
-    catch (...)
-    {
-        // Log error but don't crash
-        std::cerr << "Unknown scanner detection error" << std::endl;
-        return false;
-    }
+    // Close dialog after a short delay
+    QTimer::singleShot(CONNECTED_DISPLAY_MS,
+                       this,
+                       [this]()
+                       {
+                           emit scannerDetected();
+                           accept();
+                       });
 }
+
+void ScannerWaitDialog::onCancelClicked()
+{
+    // Cancel button removed in simplified UI
+    // This method is kept for compatibility but won't be called
+}
+
+bool ScannerWaitDialog::isScannerConnected() { return m_scanner && m_scanner->isConnected(); }
@@ -3,7 +3,6 @@
 
 #include <QDialog>
 #include <QTimer>
-#include <memory>
 
 QT_BEGIN_NAMESPACE
 class QLabel;
@@ -11,15 +10,14 @@ class QPushButton;
 class QVBoxLayout;
 QT_END_NAMESPACE
 
-// Forward declaration to avoid including the full Knokke header
-class Knokke;
+class ScannerService;
 
 class ScannerWaitDialog : public QDialog
 {
     Q_OBJECT
 
   public:
-    explicit ScannerWaitDialog(QWidget *parent = nullptr);
+    explicit ScannerWaitDialog(ScannerService *scanner, QWidget *parent = nullptr);
     ~ScannerWaitDialog();
 
     // Check if scanner is already connected
@@ -31,6 +29,7 @@ class ScannerWaitDialog : public QDialog
 
   private slots:
     void checkForScanner();
+    void onScannerReady();
     void onCancelClicked();
 
   private:
@@ -43,10 +42,12 @@ class ScannerWaitDialog : public QDialog
     QPushButton *m_cancelButton;
     QVBoxLayout *m_layout;
 
-    QTimer                 *m_detectionTimer;
-    std::unique_ptr<Knokke> m_knokke;
+    QTimer         *m_detectionTimer;
+    ScannerService *m_scanner;
+    bool            m_scannerReady; // Scanner opened, dialog is closing
 
-    static constexpr int DETECTION_INTERVAL_MS = 1000; // Check every second
+    static constexpr int DETECTION_INTERVAL_MS = 1000; // Status update interval
+    static constexpr int CONNECTED_DISPLAY_MS  = 300;  // Time "Connected!" is shown
 };
 
 #endif // SCANNERWAITDIALOG_H
@@ -0,0 +1,49 @@
+#ifndef BINARYIO_H
+#define BINARYIO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+// Internal to the driver: USB descriptors, UVC controls and capture journals are all little
+// endian whatever the host, and journals outgrow a 32-bit file offset
+
+inline void writeLe(uint8_t *bytes, uint64_t value, size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        bytes[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+inline uint64_t readLe(const uint8_t *bytes, size_t size)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; ++i)
+    {
+        value |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+    }
+    return value;
+}
+
+inline bool seekTo(std::FILE *file, uint64_t offset)
+{
+#ifdef _WIN32
+    return _fseeki64(file, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+    return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+inline uint64_t fileSize(std::FILE *file)
+{
+#ifdef _WIN32
+    _fseeki64(file, 0, SEEK_END);
+    return static_cast<uint64_t>(_ftelli64(file));
+#else
+    fseeko(file, 0, SEEK_END);
+    return static_cast<uint64_t>(ftello(file));
+#endif
+}
+
+#endif // BINARYIO_H
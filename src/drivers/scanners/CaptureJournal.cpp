@@ -0,0 +1,740 @@
+#include "CaptureJournal.h"
+
+#include "BinaryIo.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+#ifdef KNOKKE_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+namespace
+{
+constexpr char     FILE_MAGIC[8]       = {'K', 'N', 'O', 'K', 'J', 'R', 'N', 'L'};
+constexpr uint32_t FILE_VERSION        = 2; // 2: the header holds the whole frame mode
+constexpr uint32_t FILE_FLAG_LZ4       = 1u << 0;
+constexpr size_t   FILE_HEADER_BYTES   = 64;
+constexpr size_t   RECORD_HEADER_BYTES = 64;
+constexpr size_t   PARAMETER_BYTES     = 28;
+
+constexpr uint32_t RECORD_FRAME      = 0x52464a4b; // "KJFR"
+constexpr uint32_t RECORD_PARAMETERS = 0x52504a4b; // "KJPR"
+constexpr uint32_t RECORD_INDEX      = 0x58494a4b; // "KJIX"
+
+constexpr uint32_t RECORD_FLAG_COMPRESSED       = 1u << 0;
+constexpr uint32_t RECORD_FLAG_DEVICE_TIMESTAMP = 1u << 1;
+
+// An LZ4 block never expands more than this; larger claimed sizes come from a damaged record
+constexpr uint64_t LZ4_MAX_RATIO = 255;
+
+int64_t nanoseconds(FrameInfo::TimePoint time)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+void encodeParameters(const JournalParameters &parameters, uint8_t *bytes)
+{
+    writeLe(bytes + 0, parameters.generation, 8);
+    writeLe(bytes + 8, parameters.validMask, 4);
+    writeLe(bytes + 12, parameters.exposureTime, 4);
+    writeLe(bytes + 16, parameters.gain, 2);
+    writeLe(bytes + 18, parameters.backlightRed, 2);
+    writeLe(bytes + 20, parameters.backlightGreen, 2);
+    writeLe(bytes + 22, parameters.backlightBlue, 2);
+    writeLe(bytes + 24, static_cast<uint32_t>(parameters.motorSpeed), 4);
+}
+
+void decodeParameters(const uint8_t *bytes, JournalParameters &parameters)
+{
+    parameters.generation     = readLe(bytes + 0, 8);
+    parameters.validMask      = static_cast<uint32_t>(readLe(bytes + 8, 4));
+    parameters.exposureTime   = static_cast<uint32_t>(readLe(bytes + 12, 4));
+    parameters.gain           = static_cast<uint16_t>(readLe(bytes + 16, 2));
+    parameters.backlightRed   = static_cast<uint16_t>(readLe(bytes + 18, 2));
+    parameters.backlightGreen = static_cast<uint16_t>(readLe(bytes + 20, 2));
+    parameters.backlightBlue  = static_cast<uint16_t>(readLe(bytes + 22, 2));
+    parameters.motorSpeed     = static_cast<int32_t>(readLe(bytes + 24, 4));
+}
+} // namespace
+
+// Metadata travels through the ring in host layout and is encoded by the writer thread
+struct CaptureJournal::PendingRecord
+{
+    uint32_t type                 = 0;
+    uint32_t payloadBytes         = 0;
+    uint32_t flags                = 0;
+    uint32_t gapCount             = 0;
+    uint64_t frameNumber          = 0;
+    int64_t  hostNs               = 0;
+    int64_t  deviceNs             = 0;
+    uint64_t generation           = 0;
+    uint64_t generationStartFrame = 0;
+    uint32_t devicePts            = 0;
+};
+
+bool CaptureJournal::compressionAvailable()
+{
+#ifdef KNOKKE_HAVE_LZ4
+    return true;
+#else
+    return false;
+#endif
+}
+
+CaptureJournal::CaptureJournal()
+    : m_ringBytes(0), m_head(0), m_tail(0), m_accepting(false), m_writerRunning(false),
+      m_file(nullptr), m_fileOffset(0), m_compress(false), m_framesWritten(0),
+      m_framesDropped(0), m_bytesWritten(0), m_rawBytes(0), m_highWater(0), m_writeFailed(false)
+{
+}
+
+CaptureJournal::~CaptureJournal() { close(); }
+
+bool CaptureJournal::open(const std::string &path, const Options &options)
+{
+    if (isOpen() || options.bufferBytes == 0)
+    {
+        return false;
+    }
+
+    if (options.compress && !compressionAvailable())
+    {
+        std::cout << "Journal compression requested but this build has no LZ4" << std::endl;
+        return false;
+    }
+
+    m_ring.reset(new (std::nothrow) uint8_t[options.bufferBytes]);
+    if (!m_ring)
+    {
+        return false;
+    }
+
+    m_file = std::fopen(path.c_str(), "wb");
+    if (!m_file)
+    {
+        std::cout << "Failed to create journal " << path << std::endl;
+        m_ring.reset();
+        return false;
+    }
+
+    // The index offset and frame count stay zero until close() fills them in
+    const auto steadyStart = std::chrono::steady_clock::now();
+    const auto systemStart = std::chrono::system_clock::now();
+    uint8_t    header[FILE_HEADER_BYTES] = {};
+    std::memcpy(header, FILE_MAGIC, sizeof(FILE_MAGIC));
+    writeLe(header + 8, FILE_VERSION, 4);
+    writeLe(header + 12, options.compress ? FILE_FLAG_LZ4 : 0, 4);
+    writeLe(header + 16, options.mode.width, 2);
+    writeLe(header + 18, options.mode.height, 2);
+    header[20] = options.mode.bitsPerPixel;
+    header[21] = options.mode.formatIndex;
+    header[22] = options.mode.frameIndex;
+    writeLe(header + 40, static_cast<uint64_t>(nanoseconds(steadyStart)), 8);
+    writeLe(header + 48,
+            static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                      systemStart.time_since_epoch())
+                                      .count()),
+            8);
+    writeLe(header + 56, options.mode.frameInterval, 4);
+
+    m_chunk.clear();
+    m_chunk.reserve(WRITE_CHUNK_BYTES + RECORD_HEADER_BYTES);
+    m_chunk.insert(m_chunk.end(), header, header + sizeof(header));
+    m_fileOffset = 0;
+    m_compress   = options.compress;
+    m_frameIndex.clear();
+    m_parameterIndex.clear();
+
+    m_ringBytes     = options.bufferBytes;
+    m_head          = 0;
+    m_tail          = 0;
+    m_framesWritten = 0;
+    m_framesDropped = 0;
+    m_bytesWritten  = 0;
+    m_rawBytes      = 0;
+    m_highWater     = 0;
+    m_writeFailed   = false;
+
+    m_writerRunning = true;
+    m_writer        = std::thread(&CaptureJournal::writerThreadFunction, this);
+
+    std::lock_guard<std::mutex> lock(m_appendMutex);
+    m_accepting = true;
+    return true;
+}
+
+void CaptureJournal::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_appendMutex);
+        if (!m_accepting)
+        {
+            return;
+        }
+        m_accepting = false;
+    }
+
+    // The writer drains the ring before it exits, then writes the index
+    m_writerRunning = false;
+    m_wake.notify_one();
+    if (m_writer.joinable())
+    {
+        m_writer.join();
+    }
+
+    std::fclose(m_file);
+    m_file = nullptr;
+    m_ring.reset();
+
+    std::vector<uint8_t>().swap(m_chunk);
+    std::vector<uint8_t>().swap(m_scratch);
+}
+
+bool CaptureJournal::isOpen() const { return m_writerRunning; }
+
+bool CaptureJournal::appendFrame(const uint8_t *data, const FrameInfo &info)
+{
+    PendingRecord record;
+    record.type                 = RECORD_FRAME;
+    record.payloadBytes         = static_cast<uint32_t>(info.size);
+    record.flags                = info.hasDeviceTimestamp ? RECORD_FLAG_DEVICE_TIMESTAMP : 0;
+    record.gapCount             = info.gapCount;
+    record.frameNumber          = info.frameNumber;
+    record.hostNs               = nanoseconds(info.hostTimestamp);
+    record.deviceNs             = nanoseconds(info.deviceTimestamp);
+    record.generation           = info.parameterGeneration;
+    record.generationStartFrame = info.generationStartFrame;
+    record.devicePts            = info.devicePts;
+
+    return enqueue(record, data);
+}
+
+bool CaptureJournal::appendParameters(const JournalParameters &parameters)
+{
+    uint8_t payload[PARAMETER_BYTES];
+    encodeParameters(parameters, payload);
+
+    PendingRecord record;
+    record.type         = RECORD_PARAMETERS;
+    record.payloadBytes = sizeof(payload);
+    record.generation   = parameters.generation;
+    record.hostNs       = nanoseconds(std::chrono::steady_clock::now());
+    return enqueue(record, payload);
+}
+
+CaptureJournal::Stats CaptureJournal::stats() const
+{
+    Stats stats;
+    stats.framesWritten   = m_framesWritten;
+    stats.framesDropped   = m_framesDropped;
+    stats.bytesWritten    = m_bytesWritten;
+    stats.rawBytes        = m_rawBytes;
+    stats.bufferHighWater = m_highWater;
+    stats.writeFailed     = m_writeFailed;
+    return stats;
+}
+
+bool CaptureJournal::enqueue(const PendingRecord &record, const uint8_t *payload)
+{
+    std::lock_guard<std::mutex> lock(m_appendMutex);
+    if (!m_accepting)
+    {
+        return false;
+    }
+
+    // Only the writer frees space, so what is free now stays free until we publish
+    const size_t   bytes = sizeof(record) + record.payloadBytes;
+    const uint64_t head  = m_head.load(std::memory_order_relaxed);
+    const uint64_t used  = head - m_tail.load(std::memory_order_acquire);
+    if (bytes > m_ringBytes - used)
+    {
+        if (record.type == RECORD_FRAME)
+        {
+            ++m_framesDropped;
+        }
+        return false;
+    }
+
+    ringWrite(head, reinterpret_cast<const uint8_t *>(&record), sizeof(record));
+    ringWrite(head + sizeof(record), payload, record.payloadBytes);
+    m_head.store(head + bytes, std::memory_order_release);
+
+    if (used + bytes > m_highWater)
+    {
+        m_highWater = used + bytes;
+    }
+
+    m_wake.notify_one();
+    return true;
+}
+
+void CaptureJournal::writerThreadFunction()
+{
+    for (;;)
+    {
+        // Read the flag before the ring so nothing queued before close() is left behind
+        const bool     running = m_writerRunning;
+        const uint64_t tail    = m_tail.load(std::memory_order_relaxed);
+        const uint64_t head    = m_head.load(std::memory_order_acquire);
+
+        if (tail == head)
+        {
+            // Idle: push out what is staged so a crash loses as little as possible
+            flushChunk();
+            if (!running)
+            {
+                break;
+            }
+
+            std::unique_lock<std::mutex> lock(m_wakeMutex);
+            m_wake.wait_for(lock, std::chrono::milliseconds(10));
+            continue;
+        }
+
+        PendingRecord record;
+        ringRead(tail, reinterpret_cast<uint8_t *>(&record), sizeof(record));
+        if (m_scratch.size() < record.payloadBytes)
+        {
+            m_scratch.resize(record.payloadBytes);
+        }
+        ringRead(tail + sizeof(record), m_scratch.data(), record.payloadBytes);
+
+        // Hand the ring space back before touching the disk
+        m_tail.store(tail + sizeof(record) + record.payloadBytes, std::memory_order_release);
+
+        writeRecord(record, m_scratch.data());
+    }
+
+    writeIndex();
+}
+
+bool CaptureJournal::writeRecord(const PendingRecord &record, const uint8_t *payload)
+{
+    if (m_writeFailed)
+    {
+        return false;
+    }
+
+    const uint64_t offset      = m_fileOffset + m_chunk.size();
+    const size_t   headerStart = m_chunk.size();
+    m_chunk.resize(headerStart + RECORD_HEADER_BYTES);
+
+    uint32_t flags       = record.flags;
+    uint32_t storedBytes = record.payloadBytes;
+
+#ifdef KNOKKE_HAVE_LZ4
+    if (m_compress && record.type == RECORD_FRAME)
+    {
+        const int    bound = LZ4_compressBound(static_cast<int>(record.payloadBytes));
+        const size_t start = headerStart + RECORD_HEADER_BYTES;
+        m_chunk.resize(start + bound);
+        const int compressed = LZ4_compress_default(reinterpret_cast<const char *>(payload),
+                                                    reinterpret_cast<char *>(&m_chunk[start]),
+                                                    static_cast<int>(record.payloadBytes),
+                                                    bound);
+
+        // Incompressible frames are stored as they are
+        if (compressed > 0 && static_cast<uint32_t>(compressed) < record.payloadBytes)
+        {
+            flags |= RECORD_FLAG_COMPRESSED;
+            storedBytes = static_cast<uint32_t>(compressed);
+        }
+
+        // Keep the compressed bytes, or drop them all if the frame goes in uncompressed
+        m_chunk.resize(start + (flags & RECORD_FLAG_COMPRESSED ? storedBytes : 0));
+    }
+#endif
+
+    if (!(flags & RECORD_FLAG_COMPRESSED))
+    {
+        m_chunk.insert(m_chunk.end(), payload, payload + record.payloadBytes);
+    }
+
+    uint8_t *header = &m_chunk[headerStart];
+    writeLe(header + 0, record.type, 4);
+    writeLe(header + 4, storedBytes, 4);
+    writeLe(header + 8, record.payloadBytes, 4);
+    writeLe(header + 12, flags, 4);
+    writeLe(header + 16, record.frameNumber, 8);
+    writeLe(header + 24, static_cast<uint64_t>(record.hostNs), 8);
+    writeLe(header + 32, static_cast<uint64_t>(record.deviceNs), 8);
+    writeLe(header + 40, record.generation, 8);
+    writeLe(header + 48, record.generationStartFrame, 8);
+    writeLe(header + 56, record.devicePts, 4);
+    writeLe(header + 60, record.gapCount, 4);
+
+    if (record.type == RECORD_FRAME)
+    {
+        m_frameIndex.push_back(offset);
+        ++m_framesWritten;
+        m_rawBytes += record.payloadBytes;
+    }
+    else
+    {
+        m_parameterIndex.push_back(offset);
+    }
+
+    return m_chunk.size() < WRITE_CHUNK_BYTES || flushChunk();
+}
+
+bool CaptureJournal::flushChunk()
+{
+    if (m_chunk.empty() || m_writeFailed)
+    {
+        return !m_writeFailed;
+    }
+
+    if (std::fwrite(m_chunk.data(), 1, m_chunk.size(), m_file) != m_chunk.size())
+    {
+        std::cout << "Journal write failed, recording stopped" << std::endl;
+        m_writeFailed = true;
+        return false;
+    }
+
+    m_fileOffset += m_chunk.size();
+    m_bytesWritten += m_chunk.size();
+    m_chunk.clear();
+    return true;
+}
+
+bool CaptureJournal::writeIndex()
+{
+    if (!flushChunk())
+    {
+        return false;
+    }
+
+    const uint64_t indexOffset = m_fileOffset;
+    uint8_t        header[24];
+    writeLe(header + 0, RECORD_INDEX, 4);
+    writeLe(header + 4, 0, 4);
+    writeLe(header + 8, m_frameIndex.size(), 8);
+    writeLe(header + 16, m_parameterIndex.size(), 8);
+    m_chunk.insert(m_chunk.end(), header, header + sizeof(header));
+
+    for (const std::vector<uint64_t> *index : {&m_frameIndex, &m_parameterIndex})
+    {
+        for (uint64_t offset : *index)
+        {
+            uint8_t entry[8];
+            writeLe(entry, offset, 8);
+            m_chunk.insert(m_chunk.end(), entry, entry + sizeof(entry));
+        }
+    }
+
+    if (!flushChunk())
+    {
+        return false;
+    }
+
+    // Point the file header at the index now that everything before it is on disk
+    uint8_t patch[16];
+    writeLe(patch + 0, indexOffset, 8);
+    writeLe(patch + 8, m_frameIndex.size(), 8);
+    if (!seekTo(m_file, 24) || std::fwrite(patch, 1, sizeof(patch), m_file) != sizeof(patch))
+    {
+        m_writeFailed = true;
+        return false;
+    }
+    return std::fflush(m_file) == 0;
+}
+
+void CaptureJournal::ringRead(uint64_t position, uint8_t *destination, size_t bytes) const
+{
+    const size_t start = static_cast<size_t>(position % m_ringBytes);
+    const size_t first = std::min(bytes, m_ringBytes - start);
+    std::memcpy(destination, &m_ring[start], first);
+    std::memcpy(destination + first, &m_ring[0], bytes - first);
+}
+
+void CaptureJournal::ringWrite(uint64_t position, const uint8_t *source, size_t bytes)
+{
+    const size_t start = static_cast<size_t>(position % m_ringBytes);
+    const size_t first = std::min(bytes, m_ringBytes - start);
+    std::memcpy(&m_ring[start], source, first);
+    std::memcpy(&m_ring[0], source + first, bytes - first);
+}
+
+CaptureJournalReader::CaptureJournalReader()
+    : m_file(nullptr), m_fileBytes(0), m_startSteadyNs(0)
+{
+}
+
+CaptureJournalReader::~CaptureJournalReader() { close(); }
+
+bool CaptureJournalReader::isJournal(const std::string &path)
+{
+    std::FILE *file = std::fopen(path.c_str(), "rb");
+    if (!file)
+    {
+        return false;
+    }
+    char       magic[sizeof(FILE_MAGIC)];
+    const bool found = std::fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+                       std::memcmp(magic, FILE_MAGIC, sizeof(magic)) == 0;
+    std::fclose(file);
+    return found;
+}
+
+bool CaptureJournalReader::open(const std::string &path)
+{
+    close();
+
+    m_file = std::fopen(path.c_str(), "rb");
+    if (!m_file)
+    {
+        return false;
+    }
+
+    // Sizes read from the file are checked against it before anything is allocated for them
+    m_fileBytes = fileSize(m_file);
+
+    uint8_t header[FILE_HEADER_BYTES];
+    if (!seekTo(m_file, 0) || std::fread(header, 1, sizeof(header), m_file) != sizeof(header) ||
+        std::memcmp(header, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0)
+    {
+        close();
+        return false;
+    }
+
+    // Fields move between versions, so a journal from another version cannot be read at all
+    const uint32_t version = static_cast<uint32_t>(readLe(header + 8, 4));
+    if (version != FILE_VERSION)
+    {
+        std::cout << "Journal " << path << " has version " << version << ", this build reads "
+                  << FILE_VERSION << std::endl;
+        close();
+        return false;
+    }
+
+    m_mode.width         = static_cast<uint16_t>(readLe(header + 16, 2));
+    m_mode.height        = static_cast<uint16_t>(readLe(header + 18, 2));
+    m_mode.bitsPerPixel  = header[20];
+    m_mode.formatIndex   = header[21];
+    m_mode.frameIndex    = header[22];
+    m_mode.frameInterval = static_cast<uint32_t>(readLe(header + 56, 4));
+    m_startSteadyNs      = static_cast<int64_t>(readLe(header + 40, 8));
+    m_startTime          = std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::nanoseconds(readLe(header + 48, 8))));
+
+    const uint64_t indexOffset = readLe(header + 24, 8);
+    const bool     loaded      = indexOffset != 0 ? loadIndex(indexOffset) : rebuildIndex();
+    if (!loaded)
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void CaptureJournalReader::close()
+{
+    if (m_file)
+    {
+        std::fclose(m_file);
+        m_file = nullptr;
+    }
+    m_fileBytes = 0;
+    m_frameIndex.clear();
+    m_parameters.clear();
+}
+
+size_t CaptureJournalReader::frameCount() const { return m_frameIndex.size(); }
+
+FrameMode CaptureJournalReader::frameMode() const { return m_mode; }
+
+std::chrono::system_clock::time_point CaptureJournalReader::startTime() const
+{
+    return m_startTime;
+}
+
+FrameInfo::TimePoint CaptureJournalReader::startSteadyTime() const
+{
+    return FrameInfo::TimePoint(std::chrono::duration_cast<FrameInfo::TimePoint::duration>(
+        std::chrono::nanoseconds(m_startSteadyNs)));
+}
+
+bool CaptureJournalReader::readFrame(size_t index, std::vector<uint8_t> &data, FrameInfo &info)
+{
+    if (index >= m_frameIndex.size())
+    {
+        return false;
+    }
+
+    uint8_t header[RECORD_HEADER_BYTES];
+    if (!seekTo(m_file, m_frameIndex[index]) ||
+        std::fread(header, 1, sizeof(header), m_file) != sizeof(header) ||
+        readLe(header, 4) != RECORD_FRAME)
+    {
+        return false;
+    }
+
+    const uint32_t storedBytes = static_cast<uint32_t>(readLe(header + 4, 4));
+    const uint32_t rawBytes    = static_cast<uint32_t>(readLe(header + 8, 4));
+    const uint32_t flags       = static_cast<uint32_t>(readLe(header + 12, 4));
+    const bool     compressed  = (flags & RECORD_FLAG_COMPRESSED) != 0;
+    if (m_frameIndex[index] + RECORD_HEADER_BYTES + storedBytes > m_fileBytes ||
+        rawBytes > (compressed ? storedBytes * LZ4_MAX_RATIO : storedBytes))
+    {
+        return false;
+    }
+
+    data.resize(rawBytes);
+    if (compressed)
+    {
+#ifdef KNOKKE_HAVE_LZ4
+        m_compressed.resize(storedBytes);
+        if (std::fread(m_compressed.data(), 1, storedBytes, m_file) != storedBytes ||
+            LZ4_decompress_safe(reinterpret_cast<const char *>(m_compressed.data()),
+                                reinterpret_cast<char *>(data.data()),
+                                static_cast<int>(storedBytes),
+                                static_cast<int>(rawBytes)) != static_cast<int>(rawBytes))
+        {
+            return false;
+        }
+#else
+        std::cout << "Journal frame is LZ4 compressed but this build has no LZ4" << std::endl;
+        return false;
+#endif
+    }
+    else if (std::fread(data.data(), 1, rawBytes, m_file) != rawBytes)
+    {
+        return false;
+    }
+
+    const auto toTime = [](uint64_t ns)
+    {
+        return FrameInfo::TimePoint(std::chrono::duration_cast<FrameInfo::TimePoint::duration>(
+            std::chrono::nanoseconds(static_cast<int64_t>(ns))));
+    };
+
+    info                      = FrameInfo();
+    info.frameNumber          = readLe(header + 16, 8);
+    info.size                 = rawBytes;
+    info.width                = m_mode.width;
+    info.height               = m_mode.height;
+    info.gapCount             = static_cast<uint32_t>(readLe(header + 60, 4));
+    info.hasDeviceTimestamp   = (flags & RECORD_FLAG_DEVICE_TIMESTAMP) != 0;
+    info.devicePts            = static_cast<uint32_t>(readLe(header + 56, 4));
+    info.deviceTimestamp      = toTime(readLe(header + 32, 8));
+    info.hostTimestamp        = toTime(readLe(header + 24, 8));
+    info.parameterGeneration  = readLe(header + 40, 8);
+    info.generationStartFrame = readLe(header + 48, 8);
+    return true;
+}
+
+bool CaptureJournalReader::parametersFor(uint64_t generation, JournalParameters &parameters) const
+{
+    // Later records of a generation (e.g. a motor speed change) supersede earlier ones
+    for (auto it = m_parameters.rbegin(); it != m_parameters.rend(); ++it)
+    {
+        if (it->generation == generation)
+        {
+            parameters = *it;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CaptureJournalReader::loadIndex(uint64_t indexOffset)
+{
+    uint8_t header[24];
+    if (indexOffset > m_fileBytes || m_fileBytes - indexOffset < sizeof(header) ||
+        !seekTo(m_file, indexOffset) ||
+        std::fread(header, 1, sizeof(header), m_file) != sizeof(header) ||
+        readLe(header, 4) != RECORD_INDEX)
+    {
+        // A damaged index is no worse than a missing one
+        return rebuildIndex();
+    }
+
+    // Counts that do not fit in the rest of the file would overflow or exhaust the allocation
+    const uint64_t frames     = readLe(header + 8, 8);
+    const uint64_t parameters = readLe(header + 16, 8);
+    const uint64_t available  = (m_fileBytes - indexOffset - sizeof(header)) / 8;
+    if (frames > available || parameters > available - frames)
+    {
+        return rebuildIndex();
+    }
+
+    std::vector<uint8_t> entries((frames + parameters) * 8);
+    if (std::fread(entries.data(), 1, entries.size(), m_file) != entries.size())
+    {
+        return rebuildIndex();
+    }
+
+    m_frameIndex.resize(frames);
+    for (uint64_t i = 0; i < frames; ++i)
+    {
+        m_frameIndex[i] = readLe(&entries[i * 8], 8);
+    }
+
+    // Parameter records are few; load them all up front
+    for (uint64_t i = 0; i < parameters; ++i)
+    {
+        uint8_t record[RECORD_HEADER_BYTES + PARAMETER_BYTES];
+        if (!seekTo(m_file, readLe(&entries[(frames + i) * 8], 8)) ||
+            std::fread(record, 1, sizeof(record), m_file) != sizeof(record) ||
+            readLe(record, 4) != RECORD_PARAMETERS)
+        {
+            continue;
+        }
+
+        JournalParameters state;
+        decodeParameters(record + RECORD_HEADER_BYTES, state);
+        m_parameters.push_back(state);
+    }
+    return true;
+}
+
+bool CaptureJournalReader::rebuildIndex()
+{
+    m_frameIndex.clear();
+    m_parameters.clear();
+
+    // Walk the records up to the first one that is incomplete, e.g. cut off by a crash
+    const uint64_t size   = m_fileBytes;
+    uint64_t       offset = FILE_HEADER_BYTES;
+    while (offset + RECORD_HEADER_BYTES <= size)
+    {
+        uint8_t header[RECORD_HEADER_BYTES];
+        if (!seekTo(m_file, offset) ||
+            std::fread(header, 1, sizeof(header), m_file) != sizeof(header))
+        {
+            break;
+        }
+
+        const uint32_t type        = static_cast<uint32_t>(readLe(header, 4));
+        const uint64_t storedBytes = readLe(header + 4, 4);
+        const uint64_t end         = offset + RECORD_HEADER_BYTES + storedBytes;
+        if ((type != RECORD_FRAME && type != RECORD_PARAMETERS) || end > size)
+        {
+            break;
+        }
+
+        if (type == RECORD_FRAME)
+        {
+            m_frameIndex.push_back(offset);
+        }
+        else if (storedBytes == PARAMETER_BYTES)
+        {
+            uint8_t payload[PARAMETER_BYTES];
+            if (std::fread(payload, 1, sizeof(payload), m_file) == sizeof(payload))
+            {
+                JournalParameters state;
+                decodeParameters(payload, state);
+                m_parameters.push_back(state);
+            }
+        }
+        offset = end;
+    }
+
+    std::cout << "Journal was not closed cleanly, recovered " << m_frameIndex.size() << " frames"
+              << std::endl;
+    return true;
+}
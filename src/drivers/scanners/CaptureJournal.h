@@ -0,0 +1,222 @@
+#ifndef CAPTUREJOURNAL_H
+#define CAPTUREJOURNAL_H
+
+#include "FramePool.h"
+#include "UvcDescriptors.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Scanner parameters as recorded in a journal
+ */
+struct JournalParameters
+{
+    uint64_t generation     = 0; // Parameter generation this state belongs to
+    uint32_t validMask      = 0; // Bit per control (Knokke ControlKey) known to hold its value
+    uint32_t exposureTime   = 0; // microseconds
+    uint16_t gain           = 0; // 0.01 dB units
+    uint16_t backlightRed   = 0;
+    uint16_t backlightGreen = 0;
+    uint16_t backlightBlue  = 0;
+    int32_t  motorSpeed     = 0; // steps/s
+};
+
+/**
+ * @brief Append-only recording of complete frames to a single file
+ *
+ * appendFrame() copies the frame and its metadata into a preallocated ring and returns; a
+ * writer thread drains the ring, optionally LZ4-compresses each frame and writes in large
+ * sequential chunks, so a slow disk only ever costs ring space. If the ring fills up the frame
+ * is dropped and counted rather than blocking the caller. Parameter changes are recorded as
+ * their own records and frames refer to them by parameter generation.
+ *
+ * File layout (little endian): a 64-byte file header, then frame and parameter records each
+ * made of a 64-byte record header and its payload, then an index written by close() holding
+ * the file offset of every record. The header points at the index, so any frame is one seek
+ * away. A journal that was never closed has no index; CaptureJournalReader rebuilds it by
+ * walking the records.
+ */
+class CaptureJournal
+{
+  public:
+    static constexpr size_t DEFAULT_BUFFER_BYTES = 128 * 1024 * 1024; // ~3.5 s at 400 fps
+    static constexpr size_t WRITE_CHUNK_BYTES    = 4 * 1024 * 1024;   // Bytes per fwrite
+
+    struct Options
+    {
+        bool      compress    = false; // LZ4 per frame; needs KNOKKE_HAVE_LZ4
+        size_t    bufferBytes = DEFAULT_BUFFER_BYTES;
+        FrameMode mode;                // Stored in the file header
+    };
+
+    struct Stats
+    {
+        uint64_t framesWritten   = 0;
+        uint64_t framesDropped   = 0; // Ring was full when the frame arrived
+        uint64_t bytesWritten    = 0; // File bytes, after compression
+        uint64_t rawBytes        = 0; // Frame bytes before compression
+        size_t   bufferHighWater = 0; // Most ring bytes ever waiting for the disk
+        bool     writeFailed     = false;
+    };
+
+    /**
+     * @brief Whether this build can compress journals
+     */
+    static bool compressionAvailable();
+
+    CaptureJournal();
+    ~CaptureJournal();
+
+    CaptureJournal(const CaptureJournal &)            = delete;
+    CaptureJournal &operator=(const CaptureJournal &) = delete;
+
+    /**
+     * @brief Create the file and start the writer thread
+     * @param path Journal file, truncated if it exists
+     * @param options Recording options
+     * @return true on success; false if already open, the file could not be created, the ring
+     * could not be allocated or compression was asked for but is not available
+     */
+    bool open(const std::string &path, const Options &options);
+
+    /**
+     * @brief Write everything still queued, then the index, and close the file
+     */
+    void close();
+
+    bool isOpen() const;
+
+    /**
+     * @brief Queue a complete frame; never waits for the disk
+     * @return false if the journal is closed or the frame was dropped because the ring is full
+     */
+    bool appendFrame(const uint8_t *data, const FrameInfo &info);
+
+    /**
+     * @brief Queue a parameter state record
+     */
+    bool appendParameters(const JournalParameters &parameters);
+
+    Stats stats() const;
+
+  private:
+    struct PendingRecord; // Record header as queued in the ring
+
+    bool enqueue(const PendingRecord &record, const uint8_t *payload);
+    void writerThreadFunction();
+    bool writeRecord(const PendingRecord &record, const uint8_t *payload);
+    bool flushChunk();
+    bool writeIndex();
+    void ringRead(uint64_t position, uint8_t *destination, size_t bytes) const;
+    void ringWrite(uint64_t position, const uint8_t *source, size_t bytes);
+
+    // Ring shared with the writer: producers advance m_head, the writer advances m_tail
+    std::unique_ptr<uint8_t[]> m_ring;
+    size_t                     m_ringBytes;
+    std::atomic<uint64_t>      m_head;
+    std::atomic<uint64_t>      m_tail;
+    std::mutex                 m_appendMutex; // Frames and parameters arrive on two threads
+    bool                       m_accepting;
+
+    std::thread             m_writer;
+    std::atomic<bool>       m_writerRunning;
+    std::mutex              m_wakeMutex;
+    std::condition_variable m_wake;
+
+    // Writer thread only
+    std::FILE              *m_file;
+    uint64_t                m_fileOffset;
+    bool                    m_compress;
+    std::vector<uint8_t>    m_chunk;   // Output staged for the next sequential write
+    std::vector<uint8_t>    m_scratch; // Frame payload copied out of the ring
+    std::vector<uint64_t>   m_frameIndex;
+    std::vector<uint64_t>   m_parameterIndex;
+
+    std::atomic<uint64_t> m_framesWritten;
+    std::atomic<uint64_t> m_framesDropped;
+    std::atomic<uint64_t> m_bytesWritten;
+    std::atomic<uint64_t> m_rawBytes;
+    std::atomic<size_t>   m_highWater;
+    std::atomic<bool>     m_writeFailed;
+};
+
+/**
+ * @brief Random access to the frames of a journal written by CaptureJournal
+ */
+class CaptureJournalReader
+{
+  public:
+    CaptureJournalReader();
+    ~CaptureJournalReader();
+
+    CaptureJournalReader(const CaptureJournalReader &)            = delete;
+    CaptureJournalReader &operator=(const CaptureJournalReader &) = delete;
+
+    /**
+     * @brief Check whether a file was written by CaptureJournal, whatever its version
+     */
+    static bool isJournal(const std::string &path);
+
+    /**
+     * @brief Open a journal and load its index, rebuilding it if the journal was not closed
+     * @return true if the file is a readable journal of the version this build writes
+     */
+    bool open(const std::string &path);
+
+    void close();
+
+    size_t frameCount() const;
+
+    /**
+     * @brief Frame mode the journal was recorded in
+     */
+    FrameMode frameMode() const;
+
+    /**
+     * @brief When the recording started, as wall-clock time and as the recording host's
+     * steady_clock time that frame timestamps are expressed in
+     */
+    std::chrono::system_clock::time_point startTime() const;
+    FrameInfo::TimePoint                  startSteadyTime() const;
+
+    /**
+     * @brief Read one frame
+     * @param index Position in the journal (0 to frameCount() - 1)
+     * @param data Destination, resized to the frame size
+     * @param info Metadata recorded with the frame
+     * @return false if the index is out of range or the record is damaged
+     */
+    bool readFrame(size_t index, std::vector<uint8_t> &data, FrameInfo &info);
+
+    /**
+     * @brief Recorded parameter state a frame was exposed with
+     * @param generation FrameInfo::parameterGeneration of the frame
+     * @param parameters Latest recorded state of that generation
+     * @return false if no state was recorded for the generation
+     */
+    bool parametersFor(uint64_t generation, JournalParameters &parameters) const;
+
+  private:
+    bool loadIndex(uint64_t indexOffset);
+    bool rebuildIndex();
+
+    std::FILE                            *m_file;
+    uint64_t                              m_fileBytes;
+    FrameMode                             m_mode;
+    int64_t                               m_startSteadyNs;
+    std::chrono::system_clock::time_point m_startTime;
+    std::vector<uint64_t>                 m_frameIndex;
+    std::vector<JournalParameters>        m_parameters;
+    std::vector<uint8_t>                  m_compressed;
+};
+
+#endif // CAPTUREJOURNAL_H
@@ -0,0 +1,175 @@
+#ifndef CONTROLQUEUE_H
+#define CONTROLQUEUE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+/**
+ * @brief Single-worker command queue with latest-value-wins coalescing per key
+ *
+ * Commands run in submission order on a worker thread started on first use. A command
+ * submitted while another with the same key is still waiting replaces that command's work in
+ * place: the queue keeps its position, only the newest value is sent, and every submitter
+ * receives the same future, resolved with the result of the write that actually ran. A
+ * command that has already started is never replaced, so a new value arriving mid-transfer is
+ * queued behind it.
+ */
+template <typename Result> class ControlQueue
+{
+  public:
+    using Task = std::function<Result()>;
+
+    /**
+     * @param cancelled Result given to commands abandoned by stop()
+     */
+    explicit ControlQueue(Result cancelled)
+        : m_cancelled(cancelled), m_stopping(false), m_coalesced(0)
+    {
+    }
+
+    ~ControlQueue() { stop(); }
+
+    ControlQueue(const ControlQueue &)            = delete;
+    ControlQueue &operator=(const ControlQueue &) = delete;
+
+    /**
+     * @brief Queue a command, superseding a waiting command with the same key
+     * @param key Control the command writes; commands with different keys never coalesce
+     * @param task Work to run on the worker thread
+     * @return Future resolved with the result of the command that carries this value
+     */
+    std::shared_future<Result> submit(uint32_t key, Task task)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (m_stopping)
+        {
+            std::promise<Result> promise;
+            promise.set_value(m_cancelled);
+            return promise.get_future().share();
+        }
+
+        for (Command &command : m_commands)
+        {
+            if (command.key == key)
+            {
+                command.task = std::move(task);
+                ++m_coalesced;
+                return command.future;
+            }
+        }
+
+        Command command;
+        command.key    = key;
+        command.task   = std::move(task);
+        command.future = command.promise.get_future().share();
+        std::shared_future<Result> future = command.future;
+        m_commands.push_back(std::move(command));
+
+        if (!m_worker.joinable())
+        {
+            m_worker = std::thread(&ControlQueue::run, this);
+        }
+        m_condition.notify_one();
+
+        return future;
+    }
+
+    /**
+     * @brief Abandon waiting commands and join the worker; later submits are cancelled
+     *
+     * A command already running is allowed to finish.
+     */
+    void stop()
+    {
+        std::deque<Command> abandoned;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+            abandoned.swap(m_commands);
+        }
+        m_condition.notify_all();
+
+        for (Command &command : abandoned)
+        {
+            command.promise.set_value(m_cancelled);
+        }
+
+        if (m_worker.joinable() && m_worker.get_id() != std::this_thread::get_id())
+        {
+            m_worker.join();
+        }
+    }
+
+    /**
+     * @brief Number of commands waiting to run
+     */
+    size_t pending() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_commands.size();
+    }
+
+    /**
+     * @brief Number of submitted commands merged into an earlier waiting one
+     */
+    uint64_t coalescedCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_coalesced;
+    }
+
+  private:
+    struct Command
+    {
+        uint32_t                   key = 0;
+        Task                       task;
+        std::promise<Result>       promise;
+        std::shared_future<Result> future;
+    };
+
+    void run()
+    {
+        for (;;)
+        {
+            Command command;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_condition.wait(lock, [this] { return m_stopping || !m_commands.empty(); });
+                if (m_commands.empty())
+                {
+                    return;
+                }
+                command = std::move(m_commands.front());
+                m_commands.pop_front();
+            }
+
+            // Resolve the future even if the command throws so waiters are never stranded
+            try
+            {
+                command.promise.set_value(command.task());
+            }
+            catch (...)
+            {
+                command.promise.set_exception(std::current_exception());
+            }
+        }
+    }
+
+    const Result            m_cancelled;
+    mutable std::mutex      m_mutex;
+    std::condition_variable m_condition;
+    std::deque<Command>     m_commands;
+    std::thread             m_worker;
+    bool                    m_stopping;
+    uint64_t                m_coalesced;
+};
+
+#endif // CONTROLQUEUE_H
@@ -0,0 +1,137 @@
+#include "DeviceClock.h"
+#include <limits>
+
+namespace
+{
+// Minimum span the window must cover before the fitted rate replaces the nominal one
+constexpr int64_t MIN_FIT_SPAN_NS = 250000000;
+} // namespace
+
+DeviceClock::DeviceClock()
+    : m_nominalHz(0), m_samples(), m_count(0), m_next(0), m_haveLast(false), m_lastStc(0),
+      m_unwrapped(0), m_nsPerTick(0.0), m_offsetNs(0.0)
+{
+}
+
+void DeviceClock::setNominalFrequency(uint32_t frequencyHz)
+{
+    m_nominalHz = frequencyHz;
+    reset();
+}
+
+uint32_t DeviceClock::nominalFrequency() const { return m_nominalHz; }
+
+void DeviceClock::reset()
+{
+    m_count     = 0;
+    m_next      = 0;
+    m_haveLast  = false;
+    m_lastStc   = 0;
+    m_unwrapped = 0;
+    m_nsPerTick = m_nominalHz ? 1e9 / m_nominalHz : 0.0;
+    m_offsetNs  = 0.0;
+}
+
+void DeviceClock::addSample(uint32_t stc, TimePoint hostTime)
+{
+    if (m_nominalHz == 0)
+    {
+        return;
+    }
+
+    // Unwrap the 32-bit counter; modular difference handles the wrap
+    if (m_haveLast)
+    {
+        m_unwrapped += static_cast<uint32_t>(stc - m_lastStc);
+    }
+    else
+    {
+        m_unwrapped = stc;
+        m_haveLast  = true;
+    }
+    m_lastStc = stc;
+
+    const int64_t hostNs =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(hostTime.time_since_epoch()).count();
+
+    m_samples[m_next] = {m_unwrapped, hostNs};
+    m_next            = (m_next + 1) % WINDOW_SIZE;
+    if (m_count < WINDOW_SIZE)
+    {
+        ++m_count;
+    }
+
+    fit();
+}
+
+bool DeviceClock::isValid() const { return m_count > 0 && m_nsPerTick > 0.0; }
+
+DeviceClock::TimePoint DeviceClock::toHost(uint32_t ticks) const
+{
+    if (!isValid())
+    {
+        return TimePoint();
+    }
+
+    // Place ticks relative to the latest sample, assuming it is within half a wrap
+    const int64_t unwrapped = m_unwrapped + static_cast<int32_t>(ticks - m_lastStc);
+    const double  hostNs    = m_offsetNs + m_nsPerTick * static_cast<double>(unwrapped);
+
+    return TimePoint(std::chrono::nanoseconds(static_cast<int64_t>(hostNs)));
+}
+
+double DeviceClock::fittedFrequency() const { return m_nsPerTick > 0.0 ? 1e9 / m_nsPerTick : 0.0; }
+
+void DeviceClock::fit()
+{
+    const size_t  oldestIndex = (m_next + WINDOW_SIZE - m_count) % WINDOW_SIZE;
+    const Sample &oldest      = m_samples[oldestIndex];
+    const Sample &newest      = m_samples[(m_next + WINDOW_SIZE - 1) % WINDOW_SIZE];
+
+    // Rate: least squares over the window once it spans long enough to beat the jitter
+    double nsPerTick = 1e9 / m_nominalHz;
+    if (m_count > 2 && newest.hostNs - oldest.hostNs >= MIN_FIT_SPAN_NS)
+    {
+        double sumX = 0.0, sumY = 0.0, sumXX = 0.0, sumXY = 0.0;
+        for (size_t i = 0; i < m_count; ++i)
+        {
+            const Sample &sample = m_samples[(oldestIndex + i) % WINDOW_SIZE];
+            const double  x      = static_cast<double>(sample.ticks - oldest.ticks);
+            const double  y      = static_cast<double>(sample.hostNs - oldest.hostNs);
+            sumX += x;
+            sumY += y;
+            sumXX += x * x;
+            sumXY += x * y;
+        }
+
+        const double n     = static_cast<double>(m_count);
+        const double denom = n * sumXX - sumX * sumX;
+        if (denom > 0.0)
+        {
+            const double slope = (n * sumXY - sumX * sumY) / denom;
+
+            // Reject fits more than 1% away from nominal, they come from bad samples
+            if (slope > nsPerTick * 0.99 && slope < nsPerTick * 1.01)
+            {
+                nsPerTick = slope;
+            }
+        }
+    }
+
+    // Offset: lower envelope, arrival can only be late relative to the device clock
+    double minOffset = std::numeric_limits<double>::max();
+    for (size_t i = 0; i < m_count; ++i)
+    {
+        const Sample &sample = m_samples[(oldestIndex + i) % WINDOW_SIZE];
+        const double  offset = static_cast<double>(sample.hostNs - oldest.hostNs) -
+                              nsPerTick * static_cast<double>(sample.ticks - oldest.ticks);
+        if (offset < minOffset)
+        {
+            minOffset = offset;
+        }
+    }
+
+    m_nsPerTick = nsPerTick;
+    m_offsetNs  = static_cast<double>(oldest.hostNs) + minOffset -
+                 nsPerTick * static_cast<double>(oldest.ticks);
+}
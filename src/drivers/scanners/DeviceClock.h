@@ -0,0 +1,85 @@
+#ifndef DEVICECLOCK_H
+#define DEVICECLOCK_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Maps the device's UVC source clock onto the host steady_clock
+ *
+ * Each sample pairs an SCR source time clock value with the host time its payload arrived.
+ * The 32-bit device counter is unwrapped to 64 bits, the clock rate is fitted by least squares
+ * over a sliding window (falling back to the nominal dwClockFrequency until the window spans
+ * long enough), and the offset follows the lower envelope of the samples so USB scheduling
+ * latency does not bias the mapping. Samples live in a fixed ring; nothing allocates after
+ * construction.
+ */
+class DeviceClock
+{
+  public:
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    static constexpr size_t WINDOW_SIZE = 512; // Samples kept for the fit
+
+    DeviceClock();
+
+    /**
+     * @brief Set the nominal device clock frequency
+     * @param frequencyHz dwClockFrequency from the video probe/commit data
+     */
+    void setNominalFrequency(uint32_t frequencyHz);
+
+    uint32_t nominalFrequency() const;
+
+    /**
+     * @brief Drop every sample, e.g. when streaming restarts
+     */
+    void reset();
+
+    /**
+     * @brief Add one SCR observation
+     * @param stc Source time clock value from the payload header
+     * @param hostTime Host time at which the payload arrived
+     */
+    void addSample(uint32_t stc, TimePoint hostTime);
+
+    /**
+     * @brief Check whether enough samples exist to map device times
+     */
+    bool isValid() const;
+
+    /**
+     * @brief Convert a device timestamp (PTS or STC) to host time
+     * @param ticks Device clock value; must lie within half a wrap of the latest sample
+     * @return Estimated host time at which the device clock read ticks
+     */
+    TimePoint toHost(uint32_t ticks) const;
+
+    /**
+     * @brief Fitted device clock rate
+     * @return Ticks per second, or the nominal frequency while the window is too short
+     */
+    double fittedFrequency() const;
+
+  private:
+    struct Sample
+    {
+        int64_t ticks;  // Unwrapped device ticks
+        int64_t hostNs; // Host steady_clock nanoseconds
+    };
+
+    void fit();
+
+    uint32_t m_nominalHz;
+    Sample   m_samples[WINDOW_SIZE];
+    size_t   m_count;
+    size_t   m_next;
+    bool     m_haveLast;
+    uint32_t m_lastStc;
+    int64_t  m_unwrapped;
+    double   m_nsPerTick;
+    double   m_offsetNs; // hostNs = m_offsetNs + m_nsPerTick * ticks
+};
+
+#endif // DEVICECLOCK_H
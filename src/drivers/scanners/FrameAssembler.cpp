@@ -0,0 +1,203 @@
+#include "FrameAssembler.h"
+#include <cstring>
+
+bool UvcPayloadHeader::parse(const uint8_t *payload, int length, UvcPayloadHeader &header)
+{
+    if (!payload || length < 2)
+    {
+        return false;
+    }
+
+    header.length = payload[0];
+    header.flags  = payload[1];
+
+    if (header.length < 2 || header.length > length)
+    {
+        return false;
+    }
+
+    // Optional fields follow bmHeaderInfo in order: PTS (4 bytes), then SCR (4 + 2 bytes)
+    const uint8_t *field     = payload + 2;
+    const uint8_t  fieldsLen = (header.hasPts() ? 4 : 0) + (header.hasScr() ? 6 : 0);
+    if (2 + fieldsLen > header.length)
+    {
+        // Truncated header: keep the data but ignore the timing fields
+        header.flags &= ~(UVC_HEADER_PTS | UVC_HEADER_SCR);
+        return true;
+    }
+
+    if (header.hasPts())
+    {
+        header.pts = field[0] | (field[1] << 8) | (field[2] << 16) | (uint32_t(field[3]) << 24);
+        field += 4;
+    }
+
+    if (header.hasScr())
+    {
+        header.scrStc = field[0] | (field[1] << 8) | (field[2] << 16) | (uint32_t(field[3]) << 24);
+        header.scrSof = (field[4] | (field[5] << 8)) & 0x07FF;
+    }
+
+    return true;
+}
+
+FrameAssembler::FrameAssembler(size_t frameBytes)
+    : m_frameBytes(frameBytes), m_slot(nullptr), m_offset(0), m_received(0), m_bad(false),
+      m_finished(false), m_inFrame(false), m_hasPts(false), m_pts(0), m_synced(false),
+      m_haveLastFid(false), m_fid(0), m_lastFid(0), m_lostFrames(0), m_resyncs(0)
+{
+}
+
+void FrameAssembler::setSlot(uint8_t *slot) { m_slot = slot; }
+
+uint8_t *FrameAssembler::slot() const { return m_slot; }
+
+FrameAssembler::Result FrameAssembler::feed(const uint8_t *payload, int length)
+{
+    UvcPayloadHeader &header = m_lastHeader;
+    header                   = UvcPayloadHeader();
+    if (!UvcPayloadHeader::parse(payload, length, header))
+    {
+        return Result::INCOMPLETE;
+    }
+
+    const uint8_t fid = header.flags & UvcPayloadHeader::UVC_HEADER_FID;
+
+    // The previous call finished a frame, this payload starts the next one
+    if (m_finished)
+    {
+        reset();
+    }
+    else if (m_inFrame && fid != m_fid)
+    {
+        // FID toggled before EOF: the frame in progress lost its tail, restart on this one
+        ++m_resyncs;
+        loseFrame();
+        m_lastFid     = m_fid;
+        m_haveLastFid = true;
+        m_synced      = true;
+        reset();
+    }
+
+    if (!m_inFrame)
+    {
+        beginFrame(fid);
+    }
+
+    // PTS is constant across the payloads of a frame, keep the first one seen
+    if (header.hasPts() && !m_hasPts)
+    {
+        m_pts    = header.pts;
+        m_hasPts = true;
+    }
+
+    const size_t imgBytes = static_cast<size_t>(length - header.length);
+    m_received += imgBytes;
+
+    if (header.flags & UvcPayloadHeader::UVC_HEADER_ERR)
+    {
+        m_bad = true;
+    }
+
+    if (imgBytes > 0 && !m_bad && m_slot)
+    {
+        const size_t spaceLeft = m_frameBytes - m_offset;
+        if (imgBytes > spaceLeft)
+        {
+            // Overflowing frame: keep what we have but never deliver it
+            m_bad = true;
+        }
+        else
+        {
+            std::memcpy(m_slot + m_offset, payload + header.length, imgBytes);
+            m_offset += imgBytes;
+        }
+    }
+
+    if (!(header.flags & UvcPayloadHeader::UVC_HEADER_EOF))
+    {
+        return Result::INCOMPLETE;
+    }
+
+    m_finished    = true;
+    m_lastFid     = m_fid;
+    m_haveLastFid = true;
+
+    if (!m_bad && m_slot && m_offset == m_frameBytes)
+    {
+        m_synced = true;
+        return Result::FRAME_COMPLETE;
+    }
+
+    loseFrame();
+    m_synced = true;
+    return Result::FRAME_DISCARDED;
+}
+
+void FrameAssembler::reset()
+{
+    m_offset   = 0;
+    m_received = 0;
+    m_bad      = false;
+    m_finished = false;
+    m_inFrame  = false;
+    m_hasPts   = false;
+}
+
+void FrameAssembler::resync()
+{
+    reset();
+    m_synced      = false;
+    m_haveLastFid = false;
+    m_lostFrames  = 0;
+}
+
+uint32_t FrameAssembler::takeLostFrames()
+{
+    const uint32_t lost = m_lostFrames;
+    m_lostFrames        = 0;
+    return lost;
+}
+
+uint64_t FrameAssembler::resyncCount() const { return m_resyncs; }
+
+void FrameAssembler::beginFrame(uint8_t fid)
+{
+    // Consecutive frames alternate FID, so a repeat means an odd number of frames never arrived
+    if (m_synced && m_haveLastFid && fid == m_lastFid)
+    {
+        ++m_lostFrames;
+    }
+
+    m_fid     = fid;
+    m_inFrame = true;
+}
+
+void FrameAssembler::loseFrame()
+{
+    // Partial frames before the first sync point are just us joining mid-stream
+    if (m_synced)
+    {
+        ++m_lostFrames;
+    }
+}
+
+size_t FrameAssembler::bytesWritten() const { return m_offset; }
+
+size_t FrameAssembler::bytesReceived() const { return m_received; }
+
+size_t FrameAssembler::frameBytes() const { return m_frameBytes; }
+
+void FrameAssembler::setFrameBytes(size_t frameBytes)
+{
+    m_frameBytes = frameBytes;
+    reset();
+}
+
+const UvcPayloadHeader &FrameAssembler::lastHeader() const { return m_lastHeader; }
+
+bool FrameAssembler::framePts(uint32_t &pts) const
+{
+    pts = m_pts;
+    return m_hasPts;
+}
@@ -0,0 +1,162 @@
+#ifndef FRAMEASSEMBLER_H
+#define FRAMEASSEMBLER_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief UVC payload header, parsed in place from the start of a bulk payload
+ */
+struct UvcPayloadHeader
+{
+    // bmHeaderInfo bits (UVC 1.1, section 2.4.3.3)
+    static constexpr uint8_t UVC_HEADER_FID = 1u << 0; // Frame ID, toggles on every new frame
+    static constexpr uint8_t UVC_HEADER_EOF = 1u << 1; // End of Frame
+    static constexpr uint8_t UVC_HEADER_PTS = 1u << 2; // dwPresentationTime field present
+    static constexpr uint8_t UVC_HEADER_SCR = 1u << 3; // scrSourceClock field present
+    static constexpr uint8_t UVC_HEADER_ERR = 1u << 6; // Error in this payload
+    static constexpr uint8_t UVC_HEADER_EOH = 1u << 7; // End of Header
+
+    uint8_t  length = 0; // bHeaderLength, including the two fixed bytes
+    uint8_t  flags  = 0; // bmHeaderInfo
+    uint32_t pts    = 0; // dwPresentationTime in device clock ticks (valid if hasPts())
+    uint32_t scrStc = 0; // Source time clock in device clock ticks (valid if hasScr())
+    uint16_t scrSof = 0; // 11-bit USB SOF counter sampled with scrStc (valid if hasScr())
+
+    bool hasPts() const { return flags & UVC_HEADER_PTS; }
+    bool hasScr() const { return flags & UVC_HEADER_SCR; }
+
+    /**
+     * @brief Parse the header at the start of a payload
+     * @param payload Payload bytes as received from the bulk endpoint
+     * @param length Number of valid bytes in the payload
+     * @param header Output header
+     * @return true if the payload carries a well-formed header
+     */
+    static bool parse(const uint8_t *payload, int length, UvcPayloadHeader &header);
+};
+
+/**
+ * @brief Reassembles UVC bulk payloads into fixed-size frames
+ *
+ * Image bytes are copied exactly once, straight from the transfer buffer to their final offset in
+ * a caller-provided slot of frameBytes. A frame that would overflow the slot is marked bad and its
+ * remaining payloads are skipped until EOF; a frame that ends short is reported as discarded. The
+ * slot is never reallocated.
+ *
+ * The FID bit is tracked across payloads: a FID toggle without a preceding EOF means the previous
+ * frame lost its tail, so it is dropped and assembly restarts on the new frame rather than
+ * stitching the two together. A new frame carrying the same FID as the last one means at least
+ * one whole frame was skipped. Every frame known to be lost is counted so the caller can report
+ * the gap on the next delivered frame.
+ */
+class FrameAssembler
+{
+  public:
+    enum class Result
+    {
+        INCOMPLETE,     // Payload consumed, frame still in progress
+        FRAME_COMPLETE, // EOF seen and exactly frameBytes written to the slot
+        FRAME_DISCARDED // EOF seen but the frame was short, overflowed or flagged in error
+    };
+
+    explicit FrameAssembler(size_t frameBytes);
+
+    /**
+     * @brief Set the slot the next frame is written into
+     * @param slot Destination buffer of at least frameBytes bytes
+     */
+    void setSlot(uint8_t *slot);
+
+    /**
+     * @brief Get the slot frames are currently written into
+     * @return Destination buffer
+     */
+    uint8_t *slot() const;
+
+    /**
+     * @brief Consume one bulk payload
+     * @param payload Payload bytes including the UVC header
+     * @param length Number of valid bytes in the payload
+     * @return Whether this payload completed, discarded or continued the current frame
+     */
+    Result feed(const uint8_t *payload, int length);
+
+    /**
+     * @brief Drop any partially assembled frame
+     */
+    void reset();
+
+    /**
+     * @brief Forget FID history, e.g. when streaming restarts
+     */
+    void resync();
+
+    /**
+     * @brief Frames lost since the last call, then reset the count
+     *
+     * Includes frames discarded at EOF, frames abandoned on a FID toggle and whole frames
+     * inferred from a repeated FID. Partial frames seen before the stream is first synchronised
+     * are not counted.
+     */
+    uint32_t takeLostFrames();
+
+    /**
+     * @brief Total number of FID toggles that arrived before the expected EOF
+     */
+    uint64_t resyncCount() const;
+
+    /**
+     * @brief Bytes written to the slot for the frame in progress (or the frame just finished)
+     */
+    size_t bytesWritten() const;
+
+    /**
+     * @brief Bytes the frame in progress (or the frame just finished) carried in total,
+     * including any that did not fit in the slot
+     */
+    size_t bytesReceived() const;
+
+    size_t frameBytes() const;
+
+    /**
+     * @brief Change the expected frame size, dropping any partially assembled frame
+     * @param frameBytes Image bytes per frame; the slot must hold at least this many
+     */
+    void setFrameBytes(size_t frameBytes);
+
+    /**
+     * @brief Header of the payload passed to the last feed() call
+     */
+    const UvcPayloadHeader &lastHeader() const;
+
+    /**
+     * @brief Presentation time of the frame in progress (or the frame just finished)
+     * @param pts Output PTS in device clock ticks
+     * @return true if any payload of the frame carried a PTS
+     */
+    bool framePts(uint32_t &pts) const;
+
+  private:
+    void beginFrame(uint8_t fid);
+    void loseFrame();
+
+    size_t           m_frameBytes;
+    uint8_t         *m_slot;
+    size_t           m_offset;
+    size_t           m_received;
+    bool             m_bad;
+    bool             m_finished;
+    bool             m_inFrame;
+    bool             m_hasPts;
+    uint32_t         m_pts;
+    bool             m_synced;
+    bool             m_haveLastFid;
+    uint8_t          m_fid;
+    uint8_t          m_lastFid;
+    uint32_t         m_lostFrames;
+    uint64_t         m_resyncs;
+    UvcPayloadHeader m_lastHeader;
+};
+
+#endif // FRAMEASSEMBLER_H
@@ -0,0 +1,199 @@
+#include "FrameBus.h"
+#include <algorithm>
+#include <chrono>
+
+FrameSubscription::FrameSubscription(const Options &options)
+    : m_options(options), m_ring(options.capacity), m_readCursor(0), m_writeCursor(0),
+      m_decimationCounter(0), m_closed(false)
+{
+}
+
+bool FrameSubscription::waitNext(FrameLease &frame, int timeoutMs)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    auto ready = [this]() { return m_closed || m_readCursor != m_writeCursor; };
+    if (timeoutMs < 0)
+    {
+        m_readable.wait(lock, ready);
+    }
+    else if (!m_readable.wait_for(lock, std::chrono::milliseconds(timeoutMs), ready))
+    {
+        return false;
+    }
+
+    return popLocked(frame);
+}
+
+bool FrameSubscription::tryNext(FrameLease &frame)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return popLocked(frame);
+}
+
+void FrameSubscription::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        for (FrameLease &slot : m_ring)
+        {
+            slot.reset();
+        }
+        m_readCursor = m_writeCursor;
+    }
+
+    m_readable.notify_all();
+    m_writable.notify_all();
+}
+
+bool FrameSubscription::isClosed() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_closed;
+}
+
+FrameSubscription::Stats FrameSubscription::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats stats = m_stats;
+    stats.lag   = static_cast<size_t>(m_writeCursor - m_readCursor);
+    return stats;
+}
+
+const FrameSubscription::Options &FrameSubscription::options() const { return m_options; }
+
+void FrameSubscription::offer(const FrameLease &frame)
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_closed)
+        {
+            return;
+        }
+
+        // Decimation: keep the first of every N frames
+        if (m_decimationCounter++ % m_options.decimation != 0)
+        {
+            return;
+        }
+        ++m_stats.published;
+
+        const size_t capacity = m_ring.size();
+        if (m_writeCursor - m_readCursor >= capacity)
+        {
+            switch (m_options.overflow)
+            {
+            case OverflowPolicy::BLOCK:
+                m_writable.wait(lock,
+                                [this, capacity]()
+                                { return m_closed || m_writeCursor - m_readCursor < capacity; });
+                if (m_closed)
+                {
+                    return;
+                }
+                break;
+            case OverflowPolicy::DROP_OLDEST:
+                m_ring[m_readCursor % capacity].reset();
+                ++m_readCursor;
+                ++m_stats.dropped;
+                break;
+            case OverflowPolicy::DROP_NEWEST:
+                ++m_stats.dropped;
+                return;
+            }
+        }
+
+        m_ring[m_writeCursor % capacity] = frame;
+        ++m_writeCursor;
+    }
+
+    m_readable.notify_one();
+}
+
+bool FrameSubscription::popLocked(FrameLease &frame)
+{
+    if (m_readCursor == m_writeCursor)
+    {
+        return false;
+    }
+
+    frame = std::move(m_ring[m_readCursor % m_ring.size()]);
+    ++m_readCursor;
+    ++m_stats.delivered;
+
+    m_writable.notify_one();
+    return true;
+}
+
+FrameBus::~FrameBus()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto &subscriber : m_subscribers)
+    {
+        subscriber->close();
+    }
+    m_subscribers.clear();
+}
+
+std::shared_ptr<FrameSubscription> FrameBus::subscribe(const FrameSubscription::Options &options)
+{
+    if (options.decimation == 0 || options.capacity == 0)
+    {
+        return nullptr;
+    }
+
+    std::shared_ptr<FrameSubscription> subscription(new FrameSubscription(options));
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_subscribers.push_back(subscription);
+    return subscription;
+}
+
+void FrameBus::unsubscribe(const std::shared_ptr<FrameSubscription> &subscription)
+{
+    if (!subscription)
+    {
+        return;
+    }
+
+    // Close first so a producer blocked on this subscriber is released before we take m_mutex
+    subscription->close();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_subscribers.erase(std::remove(m_subscribers.begin(), m_subscribers.end(), subscription),
+                        m_subscribers.end());
+}
+
+void FrameBus::publish(const FrameLease &frame)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // Closed subscriptions, and ones whose consumer dropped its handle, are pruned here
+        m_subscribers.erase(std::remove_if(m_subscribers.begin(),
+                                           m_subscribers.end(),
+                                           [](const std::shared_ptr<FrameSubscription> &subscriber)
+                                           {
+                                               return subscriber.use_count() == 1 ||
+                                                      subscriber->isClosed();
+                                           }),
+                            m_subscribers.end());
+        m_publishing.assign(m_subscribers.begin(), m_subscribers.end());
+    }
+
+    // A BLOCK subscriber may wait in offer(); subscribe() and unsubscribe() must not wait with it
+    for (auto &subscriber : m_publishing)
+    {
+        subscriber->offer(frame);
+    }
+
+    // Holding on to the handles would keep dropped subscriptions from being pruned
+    m_publishing.clear();
+}
+
+size_t FrameBus::subscriberCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_subscribers.size();
+}
@@ -0,0 +1,141 @@
+#ifndef FRAMEBUS_H
+#define FRAMEBUS_H
+
+#include "FramePool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class FrameBus;
+
+/**
+ * @brief One consumer's view of a FrameBus
+ *
+ * Each subscription owns a fixed ring of frame leases with its own read and write cursors.
+ * Publishing hands the same pooled buffer to every subscriber (a reference count bump, never a
+ * copy); the subscriber's options decide which frames it keeps and what happens when it falls
+ * behind.
+ */
+class FrameSubscription
+{
+  public:
+    // What to do when a frame arrives and the subscriber's ring is full
+    enum class OverflowPolicy
+    {
+        BLOCK,       // Producer waits until the subscriber makes room (close() when done!)
+        DROP_OLDEST, // Oldest unread frame is discarded to make room
+        DROP_NEWEST  // Incoming frame is discarded
+    };
+
+    struct Options
+    {
+        std::string    name;                                // Label for diagnostics
+        unsigned       decimation = 1;                      // Keep 1 in N published frames
+        size_t         capacity   = 4;                      // Frames buffered before overflow
+        OverflowPolicy overflow   = OverflowPolicy::DROP_OLDEST;
+    };
+
+    struct Stats
+    {
+        uint64_t published = 0; // Frames offered to this subscriber after decimation
+        uint64_t delivered = 0; // Frames handed to the consumer
+        uint64_t dropped   = 0; // Frames lost to the overflow policy
+        size_t   lag       = 0; // Frames currently waiting to be read
+    };
+
+    /**
+     * @brief Wait for the next frame
+     * @param frame Output lease on the frame
+     * @param timeoutMs Maximum time to wait in milliseconds (negative waits forever)
+     * @return true if a frame was returned, false on timeout or when the subscription is closed
+     */
+    bool waitNext(FrameLease &frame, int timeoutMs);
+
+    /**
+     * @brief Take the next frame if one is waiting
+     * @param frame Output lease on the frame
+     * @return true if a frame was returned
+     */
+    bool tryNext(FrameLease &frame);
+
+    /**
+     * @brief Stop receiving frames, release any buffered ones and wake waiting readers
+     */
+    void close();
+
+    bool           isClosed() const;
+    Stats          stats() const;
+    const Options &options() const;
+
+  private:
+    friend class FrameBus;
+    explicit FrameSubscription(const Options &options);
+
+    void offer(const FrameLease &frame);
+    bool popLocked(FrameLease &frame);
+
+    Options                 m_options;
+    std::vector<FrameLease> m_ring;
+    uint64_t                m_readCursor;
+    uint64_t                m_writeCursor;
+    uint64_t                m_decimationCounter;
+    Stats                   m_stats;
+    bool                    m_closed;
+    mutable std::mutex      m_mutex;
+    std::condition_variable m_readable;
+    std::condition_variable m_writable;
+};
+
+/**
+ * @brief Broadcasts completed frames to any number of subscribers
+ *
+ * publish() runs on the capture path. It takes no allocation: subscriber rings are sized when the
+ * subscription is created, and each delivery only copies a FrameLease.
+ */
+class FrameBus
+{
+  public:
+    FrameBus() = default;
+    ~FrameBus();
+
+    FrameBus(const FrameBus &)            = delete;
+    FrameBus &operator=(const FrameBus &) = delete;
+
+    /**
+     * @brief Add a subscriber
+     * @param options Decimation, ring capacity and overflow policy
+     * @return Subscription handle, or nullptr if the options are invalid
+     */
+    std::shared_ptr<FrameSubscription> subscribe(const FrameSubscription::Options &options);
+
+    /**
+     * @brief Remove a subscriber (equivalent to closing it)
+     */
+    void unsubscribe(const std::shared_ptr<FrameSubscription> &subscription);
+
+    /**
+     * @brief Offer a frame to every subscriber
+     *
+     * Called from one producer thread at a time.
+     * @param frame Completed frame
+     */
+    void publish(const FrameLease &frame);
+
+    /**
+     * @brief Number of open subscriptions
+     */
+    size_t subscriberCount() const;
+
+  private:
+    std::vector<std::shared_ptr<FrameSubscription>> m_subscribers;
+    std::vector<std::shared_ptr<FrameSubscription>> m_publishing; // publish()'s copy, kept to reuse
+    mutable std::mutex                              m_mutex;
+};
+
+#endif // FRAMEBUS_H
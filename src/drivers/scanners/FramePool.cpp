@@ -0,0 +1,191 @@
+#include "FramePool.h"
+#include <cstring>
+#include <new>
+
+FrameLease::FrameLease(std::shared_ptr<FramePool> pool, size_t index)
+    : m_pool(std::move(pool)), m_index(index)
+{
+}
+
+FrameLease::FrameLease(const FrameLease &other) : m_pool(other.m_pool), m_index(other.m_index)
+{
+    if (m_pool)
+    {
+        m_pool->addRef(m_index);
+    }
+}
+
+FrameLease::FrameLease(FrameLease &&other) noexcept
+    : m_pool(std::move(other.m_pool)), m_index(other.m_index)
+{
+    other.m_pool.reset();
+}
+
+FrameLease &FrameLease::operator=(const FrameLease &other)
+{
+    if (this != &other)
+    {
+        if (other.m_pool)
+        {
+            other.m_pool->addRef(other.m_index);
+        }
+        reset();
+        m_pool  = other.m_pool;
+        m_index = other.m_index;
+    }
+    return *this;
+}
+
+FrameLease &FrameLease::operator=(FrameLease &&other) noexcept
+{
+    if (this != &other)
+    {
+        reset();
+        m_pool  = std::move(other.m_pool);
+        m_index = other.m_index;
+        other.m_pool.reset();
+    }
+    return *this;
+}
+
+FrameLease::~FrameLease() { reset(); }
+
+bool FrameLease::valid() const { return m_pool != nullptr; }
+
+const uint8_t *FrameLease::data() const
+{
+    return m_pool ? m_pool->m_buffers[m_index].data : nullptr;
+}
+
+uint8_t *FrameLease::data() { return m_pool ? m_pool->m_buffers[m_index].data : nullptr; }
+
+size_t FrameLease::size() const { return m_pool ? m_pool->m_buffers[m_index].info.size : 0; }
+
+size_t FrameLease::capacity() const { return m_pool ? m_pool->m_bufferBytes : 0; }
+
+const FrameInfo &FrameLease::info() const
+{
+    static const FrameInfo empty;
+    return m_pool ? m_pool->m_buffers[m_index].info : empty;
+}
+
+FrameInfo &FrameLease::info()
+{
+    if (m_pool)
+    {
+        return m_pool->m_buffers[m_index].info;
+    }
+
+    // Owned by this lease so writes never reach another thread, and cleared so they never
+    // reach a later read either
+    m_emptyInfo = FrameInfo();
+    return m_emptyInfo;
+}
+
+void FrameLease::reset()
+{
+    if (m_pool)
+    {
+        m_pool->release(m_index);
+        m_pool.reset();
+    }
+}
+
+std::shared_ptr<FramePool> FramePool::create(size_t bufferCount, size_t bufferBytes)
+{
+    if (bufferCount == 0 || bufferBytes == 0)
+    {
+        return nullptr;
+    }
+
+    std::shared_ptr<FramePool> pool(new (std::nothrow) FramePool(bufferCount, bufferBytes));
+    if (!pool || !pool->m_memory)
+    {
+        return nullptr;
+    }
+
+    return pool;
+}
+
+FramePool::FramePool(size_t bufferCount, size_t bufferBytes)
+    : m_bufferCount(bufferCount), m_bufferBytes(bufferBytes),
+      m_stride((bufferBytes + BUFFER_ALIGNMENT - 1) / BUFFER_ALIGNMENT * BUFFER_ALIGNMENT),
+      m_memory(nullptr), m_buffers(new Buffer[bufferCount]), m_nextHint(0), m_exhausted(0)
+{
+    m_memory = static_cast<uint8_t *>(
+        ::operator new(m_stride * m_bufferCount, std::align_val_t(BUFFER_ALIGNMENT), std::nothrow));
+    if (!m_memory)
+    {
+        return;
+    }
+
+    // Touch every page now so streaming never takes a first-use page fault on a buffer
+    std::memset(m_memory, 0, m_stride * m_bufferCount);
+
+    for (size_t i = 0; i < m_bufferCount; ++i)
+    {
+        m_buffers[i].data = m_memory + i * m_stride;
+    }
+}
+
+FramePool::~FramePool()
+{
+    if (m_memory)
+    {
+        ::operator delete(m_memory, std::align_val_t(BUFFER_ALIGNMENT));
+    }
+}
+
+FrameLease FramePool::acquire()
+{
+    // Scan from a rotating hint so buffers are reused round-robin
+    const size_t start = m_nextHint.fetch_add(1, std::memory_order_relaxed);
+    for (size_t n = 0; n < m_bufferCount; ++n)
+    {
+        const size_t index    = (start + n) % m_bufferCount;
+        uint32_t     expected = 0;
+        if (m_buffers[index].refs.compare_exchange_strong(
+                expected, 1, std::memory_order_acquire, std::memory_order_relaxed))
+        {
+            m_buffers[index].info = FrameInfo();
+            return FrameLease(shared_from_this(), index);
+        }
+    }
+
+    m_exhausted.fetch_add(1, std::memory_order_relaxed);
+    return FrameLease();
+}
+
+size_t FramePool::bufferCount() const { return m_bufferCount; }
+
+size_t FramePool::bufferBytes() const { return m_bufferBytes; }
+
+size_t FramePool::available() const
+{
+    size_t count = 0;
+    for (size_t i = 0; i < m_bufferCount; ++i)
+    {
+        if (m_buffers[i].refs.load(std::memory_order_relaxed) == 0)
+        {
+            ++count;
+        }
+    }
+    return count;
+}
+
+uint64_t FramePool::exhaustedCount() const { return m_exhausted.load(std::memory_order_relaxed); }
+
+uint8_t *FramePool::memory() const { return m_memory; }
+
+size_t FramePool::memoryBytes() const { return m_stride * m_bufferCount; }
+
+void FramePool::addRef(size_t index)
+{
+    m_buffers[index].refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void FramePool::release(size_t index)
+{
+    // Dropping the last reference makes the buffer visible to acquire() again
+    m_buffers[index].refs.fetch_sub(1, std::memory_order_release);
+}
@@ -0,0 +1,166 @@
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/**
+ * @brief Metadata stored alongside every pooled frame buffer
+ */
+struct FrameInfo
+{
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    uint64_t  frameNumber          = 0;     // Position in the device stream, lost frames included
+    size_t    size                 = 0;     // Valid bytes in the buffer
+    uint16_t  width                = 0;     // Pixels per line of the frame mode
+    uint16_t  height               = 0;     // Lines per frame of the frame mode
+    uint32_t  gapCount             = 0;     // Frames lost since the previous delivered frame
+    bool      hasDeviceTimestamp   = false; // devicePts and deviceTimestamp are valid
+    uint32_t  devicePts            = 0;     // Raw UVC presentation time in device clock ticks
+    TimePoint deviceTimestamp;              // devicePts mapped onto the host steady_clock
+    TimePoint hostTimestamp;                // Host time the last payload of the frame arrived
+    uint64_t  parameterGeneration  = 0;     // Parameter generation the frame was exposed with
+    uint64_t  generationStartFrame = 0;     // First frame number exposed with that generation
+};
+
+class FramePool;
+
+/**
+ * @brief RAII handle on one buffer of a FramePool
+ *
+ * A lease keeps its buffer out of the pool's free set for as long as it (or any copy of it)
+ * exists. Copying a lease only bumps a reference count; the buffer returns to the pool when the
+ * last copy is destroyed or reset. Consumers receiving a filled frame must treat the data as
+ * read-only.
+ */
+class FrameLease
+{
+  public:
+    FrameLease() = default;
+    FrameLease(const FrameLease &other);
+    FrameLease(FrameLease &&other) noexcept;
+    FrameLease &operator=(const FrameLease &other);
+    FrameLease &operator=(FrameLease &&other) noexcept;
+    ~FrameLease();
+
+    /**
+     * @brief Check whether the lease refers to a buffer
+     */
+    bool     valid() const;
+    explicit operator bool() const { return valid(); }
+
+    /**
+     * @brief Frame bytes (capacity() bytes are addressable)
+     */
+    const uint8_t *data() const;
+    uint8_t       *data();
+
+    /**
+     * @brief Number of valid frame bytes, as recorded in info().size
+     */
+    size_t size() const;
+
+    /**
+     * @brief Size of the underlying buffer
+     */
+    size_t capacity() const;
+
+    /**
+     * @brief Frame metadata; an empty lease reads as a default FrameInfo and drops writes
+     */
+    const FrameInfo &info() const;
+    FrameInfo       &info();
+
+    /**
+     * @brief Return the buffer to the pool early
+     */
+    void reset();
+
+  private:
+    friend class FramePool;
+    FrameLease(std::shared_ptr<FramePool> pool, size_t index);
+
+    std::shared_ptr<FramePool> m_pool;
+    size_t                     m_index = 0;
+    FrameInfo                  m_emptyInfo; // Returned by info() without a buffer
+};
+
+/**
+ * @brief Fixed set of aligned frame buffers handed out as FrameLease objects
+ *
+ * All buffers are allocated once, contiguously, when the pool is created. Acquiring and releasing
+ * a buffer is lock-free and never touches the heap, so steady-state streaming performs no
+ * allocation. When every buffer is leased, acquire() returns an invalid lease and the event is
+ * counted instead of blocking.
+ */
+class FramePool : public std::enable_shared_from_this<FramePool>
+{
+  public:
+    static constexpr size_t BUFFER_ALIGNMENT = 4096; // Page aligned for DMA and mlock
+
+    /**
+     * @brief Create a pool
+     * @param bufferCount Number of buffers
+     * @param bufferBytes Size of each buffer in bytes
+     * @return Shared pool, or nullptr if the memory could not be allocated
+     */
+    static std::shared_ptr<FramePool> create(size_t bufferCount, size_t bufferBytes);
+
+    ~FramePool();
+
+    FramePool(const FramePool &)            = delete;
+    FramePool &operator=(const FramePool &) = delete;
+
+    /**
+     * @brief Take a free buffer out of the pool
+     * @return Lease on the buffer, or an invalid lease if the pool is exhausted
+     */
+    FrameLease acquire();
+
+    size_t bufferCount() const;
+    size_t bufferBytes() const;
+
+    /**
+     * @brief Number of buffers currently free
+     */
+    size_t available() const;
+
+    /**
+     * @brief Number of acquire() calls that found the pool exhausted
+     */
+    uint64_t exhaustedCount() const;
+
+    /**
+     * @brief Start and length of the single allocation backing every buffer
+     */
+    uint8_t *memory() const;
+    size_t   memoryBytes() const;
+
+  private:
+    friend class FrameLease;
+
+    struct Buffer
+    {
+        uint8_t              *data = nullptr;
+        FrameInfo             info;
+        std::atomic<uint32_t> refs{0};
+    };
+
+    FramePool(size_t bufferCount, size_t bufferBytes);
+    void addRef(size_t index);
+    void release(size_t index);
+
+    size_t                    m_bufferCount;
+    size_t                    m_bufferBytes;
+    size_t                    m_stride;
+    uint8_t                  *m_memory;
+    std::unique_ptr<Buffer[]> m_buffers;
+    std::atomic<size_t>       m_nextHint;
+    std::atomic<uint64_t>     m_exhausted;
+};
+
+#endif // FRAMEPOOL_H
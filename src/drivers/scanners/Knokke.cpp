@@ -1,39 +1,75 @@
 #include "Knokke.h"
+#include "BinaryIo.h"
+#include "Realtime.h"
+#include "UsbTransport.h"
+#include <algorithm>
 #include <chrono>
 #include <cstring>
-#include <iomanip>
 #include <iostream>
-#include <sstream>
+#include <new>
+#include <system_error>
 
 Knokke::Knokke()
-    : m_context(nullptr), m_deviceHandle(nullptr), m_connected(false), m_streaming(false),
-      m_threadRunning(false), m_frameNumber(0)
+    : m_context(nullptr), m_fixedTransport(false), m_connected(false), m_streaming(false),
+      m_paused(false), m_threadRunning(false), m_engineActive(false), m_engineWake(false),
+      m_engineParked(false), m_engineReconfigure(false), m_engineConfigured(false),
+      m_captureMode(CaptureMode::ASYNCHRONOUS),
+      m_transferQueueDepth(DEFAULT_TRANSFER_QUEUE_DEPTH), m_transferBytes(STREAM_TRANSFER_BYTES),
+      m_autoTransferBytes(true), m_transferMultiple(1), m_autoQueueDepth(true),
+      m_maxVideoFrameSize(0), m_maxPayloadTransferSize(0), m_transfersInFlight(0),
+      m_zeroCopyRequested(true),
+      m_zeroCopyActive(false), m_frameModes(1, defaultFrameMode()), m_frameMode(defaultFrameMode()),
+      m_streamFrame(m_frameMode.frameBytes()), m_streamAssembler(m_frameMode.frameBytes()),
+      m_frameNumber(0), m_lostFrameCount(0), m_pendingGap(0),
+      m_framePool(FramePool::create(FRAME_POOL_SIZE, m_frameMode.frameBytes())),
+      m_poolExhausted(false), m_statsActiveNs(0), m_statsStartNs(0), m_statsBytes(0),
+      m_statsComplete(0), m_statsIncomplete(0), m_statsDropped(0), m_statsBulkTimeouts(0),
+      m_statsBulkErrors(0), m_recoveryTimeoutMs(DEFAULT_RECOVERY_TIMEOUT_MS),
+      m_recoveryPending(false), m_recoveryError(LIBUSB_SUCCESS), m_statsRecoveries(0),
+      m_statsRecoveryFailures(0),
+      m_batchActive(false), m_recording(false),
+      m_shadowValid(0), m_controlTransferCount(0), m_parameterGeneration(0),
+      m_parameterChangeNext(0), m_frameStartPending(true), m_frameGeneration(0),
+      m_generationStartFrame(0), m_hotplugRunning(false), m_hotplugRegistered(false),
+      m_hotplugHandle(), m_hotplugPollMs(DEFAULT_HOTPLUG_POLL_MS),
+      m_controlQueue(Error::DEVICE_NOT_CONNECTED), m_latestFrameNumber(0), m_frameWaiters(0),
+      m_streamStops(0)
 {
-    m_frameBuffer.reserve(FRAME_BYTES);
+    m_frameBuffer.reserve(m_frameMode.frameBytes());
+    m_streamAssembler.setSlot(m_streamFrame.data());
+}
+
+Knokke::Knokke(std::unique_ptr<KnokkeTransport> transport) : Knokke()
+{
+    m_transport      = std::move(transport);
+    m_fixedTransport = true;
 }
 
 Knokke::~Knokke()
 {
+    // Queued writes reference this object, finish with them before tearing anything down
+    m_controlQueue.stop();
+    stopHotplugMonitor();
     disconnect();
-    if (m_context)
-    {
-        libusb_exit(m_context);
-    }
+    stopRecording();
 }
 
 Knokke::Error Knokke::initialize()
 {
-    int result = libusb_init(&m_context);
-    if (result < 0)
+    if (m_context)
     {
-        handleError(Error::USB_ERROR,
-                    "Failed to initialize libusb: " + std::string(libusb_error_name(result)));
-        return Error::USB_ERROR;
+        return Error::SUCCESS;
     }
 
-    // Set debug level to reduce verbosity
-    libusb_set_option(m_context, LIBUSB_OPTION_LOG_LEVEL, LIBUSB_LOG_LEVEL_WARNING);
+    // Every instance shares one context so they can tell which scanners are already taken
+    m_usb = UsbContext::shared();
+    if (!m_usb)
+    {
+        handleError(Error::USB_ERROR, "Failed to initialize libusb");
+        return Error::USB_ERROR;
+    }
 
+    m_context = m_usb->get();
     return Error::SUCCESS;
 }
 
@@ -44,62 +80,252 @@ Knokke::Error Knokke::connect()
         return Error::SUCCESS;
     }
 
-    if (!m_context)
+    if (!m_fixedTransport)
     {
         Error result = initialize();
         if (result != Error::SUCCESS)
         {
             return result;
         }
+
+        m_transport = findDevice();
+        if (!m_transport)
+        {
+            return Error::DEVICE_NOT_FOUND;
+        }
     }
 
-    if (!findDevice())
+    int result = m_transport->open();
+    if (result < 0)
     {
-        return Error::DEVICE_NOT_FOUND;
+        handleError(Error::DEVICE_OPEN_FAILED,
+                    "Failed to open device: " + std::string(libusb_error_name(result)));
+        if (!m_fixedTransport)
+        {
+            m_transport.reset();
+        }
+        return Error::DEVICE_OPEN_FAILED;
     }
 
-    std::cout << "Calling claimInterfaces()..." << std::endl;
-    Error result = claimInterfaces();
-    if (result != Error::SUCCESS)
     {
-        std::cout << "claimInterfaces() failed with error: " << (int)result << std::endl;
-        libusb_close(m_deviceHandle);
-        m_deviceHandle = nullptr;
-        return result;
+        std::lock_guard<std::mutex> lock(m_hotplugMutex);
+        m_deviceLocation = m_transport->location();
     }
 
+    loadFrameModes();
+
+    // A freshly opened device may hold anything, read it again before trusting the shadow
+    invalidateParameterCache();
+
     std::cout << "Setting m_connected = true" << std::endl;
     m_connected = true;
     std::cout << "connect() completed successfully!" << std::endl;
     return Error::SUCCESS;
 }
 
+Knokke::Error Knokke::connect(const DeviceInfo &device)
+{
+    if (m_connected)
+    {
+        return Error::SUCCESS;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_hotplugMutex);
+        m_selectedDevice = device;
+    }
+    return connect();
+}
+
 void Knokke::disconnect()
 {
+    // Let queued parameter writes finish before the handle they use goes away
+    m_controlQueue.submit(CONTROL_BARRIER, [] { return Error::SUCCESS; }).wait();
+
     if (m_streaming)
     {
         stopStreaming();
     }
 
-    if (m_deviceHandle)
+    // The engine and its buffers belong to this connection
+    stopEngine();
+
+    if (m_transport)
+    {
+        m_transport->close();
+    }
+    if (!m_fixedTransport)
+    {
+        m_transport.reset();
+    }
     {
-        releaseInterfaces();
-        libusb_close(m_deviceHandle);
-        m_deviceHandle = nullptr;
+        std::lock_guard<std::mutex> lock(m_hotplugMutex);
+        m_deviceLocation.clear();
     }
 
     m_connected = false;
+    invalidateParameterCache();
 }
 
 bool Knokke::isConnected() const { return m_connected; }
 
-Knokke::Error Knokke::getExposureTime(uint32_t &exposureTime)
+Knokke::Error Knokke::startHotplugMonitor(HotplugCallback callback, int pollIntervalMs)
+{
+    if (!callback || pollIntervalMs <= 0)
+    {
+        return Error::INVALID_PARAMETER;
+    }
+
+    stopHotplugMonitor();
+
+    // A transport given at construction is always there; there is no bus to watch
+    if (m_fixedTransport)
+    {
+        callback(HotplugEvent::DEVICE_ARRIVED);
+        return Error::SUCCESS;
+    }
+
+    Error result = initialize();
+    if (result != Error::SUCCESS)
+    {
+        return result;
+    }
+
+    m_hotplugCallback   = std::move(callback);
+    m_hotplugPollMs     = pollIntervalMs;
+    m_hotplugRegistered = false;
+    m_hotplugRunning    = true;
+
+    // Notifications arrive on the context's event thread, which has to run before any can
+    if (libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG) && m_usb->startEvents())
+    {
+        // ENUMERATE reports a scanner that is already plugged in as an arrival
+        int registerResult = libusb_hotplug_register_callback(
+            m_context,
+            LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT,
+            LIBUSB_HOTPLUG_ENUMERATE,
+            VENDOR_ID,
+            PRODUCT_ID,
+            LIBUSB_HOTPLUG_MATCH_ANY,
+            &Knokke::hotplugCallback,
+            this,
+            &m_hotplugHandle);
+        if (registerResult == LIBUSB_SUCCESS)
+        {
+            m_hotplugRegistered = true;
+        }
+        else
+        {
+            std::cout << "Hotplug registration failed (" << libusb_error_name(registerResult)
+                      << "), polling for the scanner instead" << std::endl;
+        }
+    }
+
+    if (m_hotplugRegistered)
+    {
+        return Error::SUCCESS;
+    }
+
+    try
+    {
+        m_hotplugThread = std::make_unique<std::thread>(&Knokke::hotplugThreadFunction, this);
+    }
+    catch (const std::system_error &)
+    {
+        m_hotplugRunning = false;
+        return Error::THREAD_CREATION_FAILED;
+    }
+
+    return Error::SUCCESS;
+}
+
+void Knokke::stopHotplugMonitor()
+{
+    if (!m_hotplugRunning)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_hotplugMutex);
+        m_hotplugRunning = false;
+    }
+    m_hotplugCondition.notify_all();
+
+    if (m_hotplugRegistered)
+    {
+        libusb_hotplug_deregister_callback(m_context, m_hotplugHandle);
+        m_hotplugRegistered = false;
+    }
+
+    if (m_hotplugThread)
+    {
+        if (m_hotplugThread->joinable())
+        {
+            m_hotplugThread->join();
+        }
+        m_hotplugThread.reset();
+    }
+
+    // A notification already running on the event thread finishes before the callback goes
+    std::lock_guard<std::mutex> lock(m_hotplugDispatchMutex);
+    m_hotplugCallback = nullptr;
+}
+
+bool Knokke::isHotplugActive() const { return m_hotplugRunning && m_hotplugRegistered; }
+
+bool Knokke::isDevicePresent()
+{
+    if (m_fixedTransport)
+    {
+        return true;
+    }
+
+    if (initialize() != Error::SUCCESS)
+    {
+        return false;
+    }
+
+    libusb_device **devices;
+    ssize_t         deviceCount = libusb_get_device_list(m_context, &devices);
+    if (deviceCount < 0)
+    {
+        return false;
+    }
+
+    bool present = false;
+    for (ssize_t i = 0; i < deviceCount && !present; ++i)
+    {
+        libusb_device_descriptor desc;
+        if (libusb_get_device_descriptor(devices[i], &desc) == LIBUSB_SUCCESS &&
+            desc.idVendor == VENDOR_ID && desc.idProduct == PRODUCT_ID)
+        {
+            present = isOwnDevice(UsbContext::locationKey(devices[i]));
+        }
+    }
+
+    libusb_free_device_list(devices, 1);
+    return present;
+}
+
+Knokke::Error Knokke::getExposureTime(uint32_t &exposureTime, bool refresh)
 {
     if (!m_connected)
     {
         return Error::DEVICE_NOT_CONNECTED;
     }
 
+    {
+        std::lock_guard<std::recursive_mutex> lock(m_shadowMutex);
+        if (!refresh && isShadowValid(CONTROL_EXPOSURE))
+        {
+            exposureTime = m_shadow.exposure_time;
+            return Error::SUCCESS;
+        }
+    }
+
+    std::lock_guard<std::recursive_mutex> deviceLock(m_controlMutex);
+
     uint8_t data[4];
     Error   result = performControlTransfer(UVC_REQUEST_TYPE_CLASS,
                                           UVC_GET_CUR,
@@ -111,6 +337,10 @@ Knokke::Error Knokke::getExposureTime(uint32_t &exposureTime)
     if (result == Error::SUCCESS)
     {
         exposureTime = data[0] | (data[1] << 8) | (data[2] << 16) | (data[3] << 24);
+
+        std::lock_guard<std::recursive_mutex> lock(m_shadowMutex);
+        m_shadow.exposure_time = exposureTime;
+        markShadowValid(CONTROL_EXPOSURE);
     }
 
     return result;
@@ -123,27 +353,46 @@ Knokke::Error Knokke::setExposureTime(uint32_t exposureTime)
         return Error::DEVICE_NOT_CONNECTED;
     }
 
-    uint8_t data[4];
-    data[0] = exposureTime & 0xFF;
-    data[1] = (exposureTime >> 8) & 0xFF;
-    data[2] = (exposureTime >> 16) & 0xFF;
-    data[3] = (exposureTime >> 24) & 0xFF;
+    // Held through the transfer so the device and the shadow copy agree on the last write
+    std::lock_guard<std::recursive_mutex> deviceLock(m_controlMutex);
+    {
+        std::lock_guard<std::recursive_mutex> lock(m_shadowMutex);
+        if (isShadowValid(CONTROL_EXPOSURE) && m_shadow.exposure_time == exposureTime)
+        {
+            return Error::SUCCESS;
+        }
+    }
 
-    return performControlTransfer(UVC_REQUEST_TYPE_CLASS_OUT,
-                                  UVC_SET_CUR,
-                                  UVC_EXPOSURE_CONTROL,
-                                  UVC_CAMERA_TERMINAL,
-                                  data,
-                                  sizeof(data));
+    Error result = writeExposureTime(exposureTime);
+
+    std::lock_guard<std::recursive_mutex> lock(m_shadowMutex);
+    if (result == Error::SUCCESS)
+    {
+        m_shadow.exposure_time = exposureTime;
+    }
+    updateShadow(CONTROL_EXPOSURE, result);
+
+    return result;
 }
 
-Knokke::Error Knokke::getGain(uint16_t &gain)
+Knokke::Error Knokke::getGain(uint16_t &gain, bool refresh)
 {
     if (!m_connected)
     {
         return Error::DEVICE_NOT_CONNECTED;
     }
 
+    {
+        std::lock_guard<std::recursive_mutex> lock(m_shadowMutex);
+        if (!refresh && isShadowValid(CONTROL_GAIN))
+        {
+            gain = m_shadow.gain;
+            return Error::SUCCESS;
+        }
+    }
+
+    std::lock_guard<std::recursive_mutex> deviceLock(m_controlMutex);
+
     uint8_t data[2];
     Error   result = performControlTransfer(UVC_REQUEST_TYPE_CLASS,
                                           UVC_GET_CUR,
@@ -155,6 +404,10 @@ Knokke::Error Knokke::getGain(uint16_t &gain)
     if (result == Error::SUCCESS)
     {
         gain = data[0] | (data[1] << 8);
+
+        std::lock_guard<std::recursive_mutex> lock(m_shadowMutex);
+        m_shadow.gain = gain;
+        markShadowValid(CONTROL_GAIN);
     }
 
     return result;
@@ -167,25 +420,45 @@ Knokke::Error Knokke::setGain(uint16_t gain)
         return Error::DEVICE_NOT_CONNECTED;
     }
 
-    uint8_t data[2];
-    data[0] = gain & 0xFF;
-    data[1] = (gain >> 8) & 0xFF;
+    std::lock_guard<std::recursive_mutex> deviceLock(m_controlMutex);
+    {
+        std::lock_guard<std::recursive_mutex> lock(m_shadowMutex);
+        if (isShadowValid(CONTROL_GAIN) && m_shadow.gain == gain)
+        {
+            return Error::SUCCESS;
+        }
+    }
 
-    return performControlTransfer(UVC_REQUEST_TYPE_CLASS_OUT,
-                                  UVC_SET_CUR,
-                                  UVC_GAIN_CONTROL,
-                                  UVC_CAMERA_TERMINAL,
-                                  data,
-                                  sizeof(data));
+    Error result = writeGain(gain);
+
+    std::lock_guard<std::recursive_mutex> lock(m_shadowMutex);
+    if (result == Error::SUCCESS)
+    {
+        m_shadow.gain = gain;
+    }
+    updateShadow(CONTROL_GAIN, result);
+
+    return result;
 }
 
-Knokke::Error Knokke::getBacklight(BacklightParams &backlight)
+Knokke::Error Knokke::getBacklight(BacklightParams &backlight, bool refresh)
 {
     if (!m_connected)
     {
         return Error::DEVICE_NOT_CONNECTED;
     }
 
+    {
+        std::lock_guard<std::recursive_mutex> lock(m_shadowMutex);
+        if (!refresh && isShadowValid(CONTROL_BACKLIGHT))
+        {
+            backlight = m_shadow.backlight;
+            return Error::SUCCESS;
+        }
+    }
+
+    std::lock_guard<std::recursive_mutex> deviceLock(m_controlMutex);
+
     uint8_t data[6];
     Error   result = performControlTransfer(UVC_REQUEST_TYPE_CLASS,
                                           UVC_GET_CUR,
@@ -199,6 +472,10 @@ Knokke::Error Knokke::getBacklight(BacklightParams &backlight)
         backlight.red   = data[0] | (data[1] << 8);
         backlight.green = data[2] | (data[3] << 8);
         backlight.blue  = data[4] | (data[5] << 8);
+
+        std::lock_guard<std::recursive_mutex> lock(m_shadowMutex);
+        m_shadow.backlight = backlight;
+        markShadowValid(CONTROL_BACKLIGHT);
     }
 
     return result;
@@ -211,20 +488,27 @@ Knokke::Error Knokke::setBacklight(const BacklightParams &backlight)
         return Error::DEVICE_NOT_CONNECTED;
     }
 
-    uint8_t data[6];
-    data[0] = backlight.red & 0xFF;
-    data[1] = (backlight.red >> 8) & 0xFF;
-    data[2] = backlight.green & 0xFF;
-    data[3] = (backlight.green >> 8) & 0xFF;
-    data[4] = backlight.blue & 0xFF;
-    data[5] = (backlight.blue >> 8) & 0xFF;
+    std::lock_guard<std::recursive_mutex> deviceLock(m_controlMutex);
+    {
+        std::lock_guard<std::recursive_mutex> lock(m_shadowMutex);
+        if (isShadowValid(CONTROL_BACKLIGHT) && m_shadow.backlight.red == backlight.red &&
+            m_shadow.backlight.green == backlight.green &&
+            m_shadow.backlight.blue == backlight.blue)
+        {
+            return Error::SUCCESS;
+        }
+    }
 
-    return performControlTransfer(UVC_REQUEST_TYPE_CLASS_OUT,
-                                  UVC_SET_CUR,
-                                  UVC_BACKLIGHT_CONTROL,
-                                  UVC_EXTENSION_UNIT,
-                                  data,
-                                  sizeof(data));
+    Error result = writeBacklight(backlight);
+
+    std::lock_guard<std::recursive_mutex> lock(m_shadowMutex);
+    if (result == Error::SUCCESS)
+    {
+        m_shadow.backlight = backlight;
+    }
+    updateShadow(CONTROL_BACKLIGHT, result);
+
+    return result;
 }
 
 Knokke::Error Knokke::setBacklightChannel(char channel, uint16_t value)
@@ -234,9 +518,11 @@ Knokke::Error Knokke::setBacklightChannel(char channel, uint16_t value)
         return Error::DEVICE_NOT_CONNECTED;
     }
 
-    // Get current backlight values first
-    BacklightParams current;
-    Error           result = getBacklight(current);
+    // Start from the shadow copy; the device is only read if it has not been seen yet. No
+    // other write may come between the read and the write back.
+    std::lock_guard<std::recursive_mutex> deviceLock(m_controlMutex);
+    BacklightParams                       current;
+    Error                                 result = getBacklight(current);
     if (result != Error::SUCCESS)
     {
         return result;
@@ -264,13 +550,24 @@ Knokke::Error Knokke::setBacklightChannel(char channel, uint16_t value)
     return setBacklight(current);
 }
 
-Knokke::Error Knokke::getMotorSpeed(int32_t &speed)
+Knokke::Error Knokke::getMotorSpeed(int32_t &speed, bool refresh)
 {
     if (!m_connected)
     {
         return Error::DEVICE_NOT_CONNECTED;
     }
 
+    {
+        std::lock_guard<std::recursive_mutex> lock(m_shadowMutex);
+        if (!refresh && isShadowValid(CONTROL_MOTOR_SPEED))
+        {
+            speed = m_shadow.motor_speed;
+            return Error::SUCCESS;
+        }
+    }
+
+    std::lock_guard<std::recursive_mutex> deviceLock(m_controlMutex);
+
     uint8_t data[4];
     Error   result = performControlTransfer(UVC_REQUEST_TYPE_CLASS,
                                           UVC_GET_CUR,
@@ -282,6 +579,10 @@ Knokke::Error Knokke::getMotorSpeed(int32_t &speed)
     if (result == Error::SUCCESS)
     {
         speed = data[0] | (data[1] << 8) | (data[2] << 16) | (data[3] << 24);
+
+        std::lock_guard<std::recursive_mutex> lock(m_shadowMutex);
+        m_shadow.motor_speed = speed;
+        markShadowValid(CONTROL_MOTOR_SPEED);
     }
 
     return result;
@@ -294,43 +595,115 @@ Knokke::Error Knokke::setMotorSpeed(int32_t speed)
         return Error::DEVICE_NOT_CONNECTED;
     }
 
+    std::lock_guard<std::recursive_mutex> deviceLock(m_controlMutex);
+    {
+        std::lock_guard<std::recursive_mutex> lock(m_shadowMutex);
+        if (isShadowValid(CONTROL_MOTOR_SPEED) && m_shadow.motor_speed == speed)
+        {
+            return Error::SUCCESS;
+        }
+    }
+
+    Error result = writeMotorSpeed(speed);
+
+    std::lock_guard<std::recursive_mutex> lock(m_shadowMutex);
+    if (result == Error::SUCCESS)
+    {
+        m_shadow.motor_speed = speed;
+    }
+    updateShadow(CONTROL_MOTOR_SPEED, result);
+
+    return result;
+}
+
+Knokke::Error Knokke::writeExposureTime(uint32_t exposureTime)
+{
     uint8_t data[4];
-    data[0] = speed & 0xFF;
-    data[1] = (speed >> 8) & 0xFF;
-    data[2] = (speed >> 16) & 0xFF;
-    data[3] = (speed >> 24) & 0xFF;
+    data[0] = exposureTime & 0xFF;
+    data[1] = (exposureTime >> 8) & 0xFF;
+    data[2] = (exposureTime >> 16) & 0xFF;
+    data[3] = (exposureTime >> 24) & 0xFF;
 
     return performControlTransfer(UVC_REQUEST_TYPE_CLASS_OUT,
                                   UVC_SET_CUR,
-                                  UVC_MOTOR_SPEED_CONTROL,
-                                  UVC_EXTENSION_UNIT,
+                                  UVC_EXPOSURE_CONTROL,
+                                  UVC_CAMERA_TERMINAL,
                                   data,
                                   sizeof(data));
 }
 
-Knokke::Error Knokke::getParameters(ScannerParams &params)
+Knokke::Error Knokke::writeGain(uint16_t gain)
 {
-    Error result = getExposureTime(params.exposure_time);
-    if (result != Error::SUCCESS)
-        return result;
-
-    result = getGain(params.gain);
-    if (result != Error::SUCCESS)
-        return result;
-
-    result = getBacklight(params.backlight);
-    if (result != Error::SUCCESS)
-        return result;
-
-    result = getMotorSpeed(params.motor_speed);
-    if (result != Error::SUCCESS)
-        return result;
+    uint8_t data[2];
+    data[0] = gain & 0xFF;
+    data[1] = (gain >> 8) & 0xFF;
 
-    return Error::SUCCESS;
+    return performControlTransfer(UVC_REQUEST_TYPE_CLASS_OUT,
+                                  UVC_SET_CUR,
+                                  UVC_GAIN_CONTROL,
+                                  UVC_CAMERA_TERMINAL,
+                                  data,
+                                  sizeof(data));
 }
 
-Knokke::Error Knokke::setParameters(const ScannerParams &params)
+Knokke::Error Knokke::writeBacklight(const BacklightParams &backlight)
 {
+    uint8_t data[6];
+    data[0] = backlight.red & 0xFF;
+    data[1] = (backlight.red >> 8) & 0xFF;
+    data[2] = backlight.green & 0xFF;
+    data[3] = (backlight.green >> 8) & 0xFF;
+    data[4] = backlight.blue & 0xFF;
+    data[5] = (backlight.blue >> 8) & 0xFF;
+
+    return performControlTransfer(UVC_REQUEST_TYPE_CLASS_OUT,
+                                  UVC_SET_CUR,
+                                  UVC_BACKLIGHT_CONTROL,
+                                  UVC_EXTENSION_UNIT,
+                                  data,
+                                  sizeof(data));
+}
+
+Knokke::Error Knokke::writeMotorSpeed(int32_t speed)
+{
+    uint8_t data[4];
+    data[0] = speed & 0xFF;
+    data[1] = (speed >> 8) & 0xFF;
+    data[2] = (speed >> 16) & 0xFF;
+    data[3] = (speed >> 24) & 0xFF;
+
+    return performControlTransfer(UVC_REQUEST_TYPE_CLASS_OUT,
+                                  UVC_SET_CUR,
+                                  UVC_MOTOR_SPEED_CONTROL,
+                                  UVC_EXTENSION_UNIT,
+                                  data,
+                                  sizeof(data));
+}
+
+Knokke::Error Knokke::getParameters(ScannerParams &params, bool refresh)
+{
+    Error result = getExposureTime(params.exposure_time, refresh);
+    if (result != Error::SUCCESS)
+        return result;
+
+    result = getGain(params.gain, refresh);
+    if (result != Error::SUCCESS)
+        return result;
+
+    result = getBacklight(params.backlight, refresh);
+    if (result != Error::SUCCESS)
+        return result;
+
+    result = getMotorSpeed(params.motor_speed, refresh);
+    if (result != Error::SUCCESS)
+        return result;
+
+    return Error::SUCCESS;
+}
+
+Knokke::Error Knokke::setParameters(const ScannerParams &params)
+{
+    // Each setter compares against the shadow copy, so only changed controls are written
     Error result = setExposureTime(params.exposure_time);
     if (result != Error::SUCCESS)
         return result;
@@ -350,416 +723,2059 @@ Knokke::Error Knokke::setParameters(const ScannerParams &params)
     return Error::SUCCESS;
 }
 
-Knokke::Error Knokke::startStreaming()
+void Knokke::invalidateParameterCache()
 {
-    if (!m_connected)
+    std::lock_guard<std::recursive_mutex> lock(m_shadowMutex);
+    m_shadowValid = 0;
+}
+
+uint64_t Knokke::getControlTransferCount() const { return m_controlTransferCount; }
+
+bool Knokke::isShadowValid(ControlKey key) const { return m_shadowValid & (1u << key); }
+
+void Knokke::markShadowValid(ControlKey key) { m_shadowValid |= 1u << key; }
+
+void Knokke::updateShadow(ControlKey key, Error result)
+{
+    // A failed write leaves the device state unknown, so the next access goes to the device
+    if (result == Error::SUCCESS)
     {
-        return Error::DEVICE_NOT_CONNECTED;
-    }
+        markShadowValid(key);
 
-    if (m_streaming)
+        // Motor speed moves the film but does not change how frames are exposed
+        if (key != CONTROL_MOTOR_SPEED)
+        {
+            recordParameterChange();
+        }
+        journalParameters();
+    }
+    else
     {
-        return Error::STREAMING_ALREADY_STARTED;
+        m_shadowValid &= ~(1u << key);
     }
+}
 
-    Error result = sendProbeCommit();
-    if (result != Error::SUCCESS)
+void Knokke::journalParameters()
+{
+    if (!m_recording)
     {
-        return result;
+        return;
     }
 
-    m_streaming     = true;
-    m_threadRunning = true;
+    // Written after the change opened its generation, which frames exposed from now on carry
+    std::lock_guard<std::recursive_mutex> lock(m_shadowMutex);
+    JournalParameters parameters;
+    parameters.generation     = m_parameterGeneration;
+    parameters.validMask      = m_shadowValid;
+    parameters.exposureTime   = m_shadow.exposure_time;
+    parameters.gain           = m_shadow.gain;
+    parameters.backlightRed   = m_shadow.backlight.red;
+    parameters.backlightGreen = m_shadow.backlight.green;
+    parameters.backlightBlue  = m_shadow.backlight.blue;
+    parameters.motorSpeed     = m_shadow.motor_speed;
+    m_journal.appendParameters(parameters);
+}
 
-    // Start capture thread
-    m_captureThread = std::make_unique<std::thread>(&Knokke::captureThreadFunction, this);
+uint64_t Knokke::getParameterGeneration() const { return m_parameterGeneration; }
 
-    return Error::SUCCESS;
+void Knokke::recordParameterChange()
+{
+    // The write has completed, so frames exposed from now on see the new value
+    std::lock_guard<std::mutex> lock(m_parameterChangeMutex);
+    ParameterChange &change = m_parameterChanges[m_parameterChangeNext];
+    change.generation       = ++m_parameterGeneration;
+    change.time             = std::chrono::steady_clock::now();
+    m_parameterChangeNext   = (m_parameterChangeNext + 1) % PARAMETER_HISTORY;
 }
 
-Knokke::Error Knokke::stopStreaming()
+void Knokke::stampGeneration(FrameInfo           &info,
+                             uint64_t             frameNumber,
+                             FrameInfo::TimePoint exposureStart)
 {
-    if (!m_streaming)
+    // The frame saw every change that completed before its exposure started; changes are
+    // numbered in time order, so it belongs just below the oldest change that came later
+    uint64_t generation;
     {
-        return Error::SUCCESS;
+        std::lock_guard<std::mutex> lock(m_parameterChangeMutex);
+        generation = m_parameterGeneration;
+        for (const ParameterChange &change : m_parameterChanges)
+        {
+            if (change.generation != 0 && change.time > exposureStart &&
+                change.generation - 1 < generation)
+            {
+                generation = change.generation - 1;
+            }
+        }
     }
 
-    m_streaming     = false;
-    m_threadRunning = false;
-
-    // Wait for thread to finish
-    if (m_captureThread && m_captureThread->joinable())
+    // Timestamp jitter must never move the stream back to an older generation
+    if (generation > m_frameGeneration)
     {
-        m_captureThread->join();
+        m_frameGeneration      = generation;
+        m_generationStartFrame = frameNumber;
     }
 
-    m_captureThread.reset();
+    info.parameterGeneration  = m_frameGeneration;
+    info.generationStartFrame = m_generationStartFrame;
+}
 
-    return Error::SUCCESS;
+Knokke::ControlFuture Knokke::setExposureTimeAsync(uint32_t exposureTime)
+{
+    return m_controlQueue.submit(CONTROL_EXPOSURE,
+                                 [this, exposureTime] { return setExposureTime(exposureTime); });
 }
 
-bool Knokke::isStreaming() const { return m_streaming; }
+Knokke::ControlFuture Knokke::setGainAsync(uint16_t gain)
+{
+    return m_controlQueue.submit(CONTROL_GAIN, [this, gain] { return setGain(gain); });
+}
 
-void Knokke::setFrameCallback(FrameCallback callback)
+Knokke::ControlFuture Knokke::setBacklightAsync(const BacklightParams &backlight)
 {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    m_frameCallback = callback;
+    return m_controlQueue.submit(CONTROL_BACKLIGHT,
+                                 [this, backlight] { return setBacklight(backlight); });
 }
 
-void Knokke::setErrorCallback(ErrorCallback callback)
+Knokke::ControlFuture Knokke::setMotorSpeedAsync(int32_t speed)
 {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    m_errorCallback = callback;
+    return m_controlQueue.submit(CONTROL_MOTOR_SPEED,
+                                 [this, speed] { return setMotorSpeed(speed); });
 }
 
-Knokke::Error Knokke::captureFrame(uint8_t *frameData, size_t frameSize, int timeoutMs)
+size_t Knokke::getPendingControlCount() const { return m_controlQueue.pending(); }
+
+Knokke::Error Knokke::startStreaming()
 {
     if (!m_connected)
     {
         return Error::DEVICE_NOT_CONNECTED;
     }
 
-    if (frameSize < FRAME_BYTES)
+    if (m_streaming)
     {
-        return Error::INVALID_PARAMETER;
+        return Error::STREAMING_ALREADY_STARTED;
     }
 
-    const int            payload_len = 32768;
-    std::vector<uint8_t> payload(payload_len);
-    std::vector<uint8_t> frame;
-    frame.reserve(FRAME_BYTES);
-
-    const uint8_t UVC_HEADER_SOF = 1u << 0; // Start of Frame
-    const uint8_t UVC_HEADER_EOF = 1u << 1; // End of Frame
-    bool          gotEof         = false;
-    auto          startTime      = std::chrono::steady_clock::now();
-    int           safetyIter     = 0;
+    // A stream that stopped by itself may still be on its way to parking the engine
+    {
+        std::unique_lock<std::mutex> lock(m_engineMutex);
+        m_engineCondition.wait(
+            lock, [this] { return !m_captureThread || (m_engineParked && !m_engineWake); });
+    }
 
-    while (!gotEof && frame.size() < FRAME_BYTES && safetyIter < 1000)
+    Error result = sendProbeCommit();
+    if (result != Error::SUCCESS)
     {
-        ++safetyIter;
-        auto currentTime = std::chrono::steady_clock::now();
-        auto elapsed =
-            std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - startTime);
-        if (elapsed.count() > timeoutMs)
+        return result;
+    }
+    configureTransfers();
+
+    m_streamAssembler.resync();
+    m_pendingGap           = 0;
+    m_lostFrameCount       = 0;
+    m_frameStartPending    = true;
+    m_frameGeneration      = m_parameterGeneration;
+    m_generationStartFrame = m_frameNumber;
+    m_recoveryPending      = false;
+    resetStreamStats();
+    prepareStreamSlot();
+
+    // Nothing counts as applied until it was, reused buffers and threads included
+    {
+        std::lock_guard<std::mutex> lock(m_realtimeMutex);
+        m_realtimeStatus = RealtimeStatus();
+    }
+    unlockStreamMemory();
+    const bool lockMemory = m_realtime.enabled && m_realtime.lockMemory;
+    bool       locked     = lockMemory;
+    if (lockMemory)
+    {
+        if (m_framePool)
         {
-            return Error::CONTROL_TRANSFER_FAILED;
+            locked = lockStreamMemory(m_framePool->memory(), m_framePool->memoryBytes()) && locked;
         }
+        locked = lockStreamMemory(m_streamFrame.data(), m_streamFrame.size()) && locked;
+    }
 
-        int transferred = 0;
-        int result      = libusb_bulk_transfer(
-            m_deviceHandle, BULK_EP_IN, payload.data(), payload_len, &transferred, 200);
+    // Buffers and the engine thread are only created on the first start or when sizes change
+    result = prepareTransfers();
+    if (result == Error::SUCCESS && lockMemory)
+    {
+        locked = lockTransferBuffers() && locked;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_realtimeMutex);
+        m_realtimeStatus.memoryLocked = locked;
+    }
+    if (result == Error::SUCCESS)
+    {
+        result = startEngine();
+    }
+    if (result == Error::SUCCESS)
+    {
+        m_streaming = true;
+        m_paused    = false;
+        result      = resumeEngine(true);
+    }
+    if (result == Error::SUCCESS)
+    {
+        // The engine applies the thread options as it wakes, the status is only complete after
+        std::unique_lock<std::mutex> lock(m_engineMutex);
+        m_engineCondition.wait(lock, [this] { return m_engineConfigured; });
+    }
+    if (result != Error::SUCCESS)
+    {
+        m_streaming = false;
+        setStatsRunning(false);
+        unlockStreamMemory();
+    }
+    return result;
+}
 
-        if (result == LIBUSB_ERROR_TIMEOUT)
-        {
-            continue;
-        }
-        if (result < 0)
-        {
-            handleError(Error::USB_ERROR,
-                        "Bulk transfer error: " + std::string(libusb_error_name(result)));
-            return Error::USB_ERROR;
-        }
-        if (transferred <= 0)
-        {
-            continue;
-        }
+Knokke::Error Knokke::stopStreaming()
+{
+    if (!m_streaming)
+    {
+        return Error::SUCCESS;
+    }
 
-        // Parse UVC payload header
-        if (transferred < 2)
-            continue;
+    // The engine parks and keeps its thread and buffers for the next start
+    if (!m_paused)
+    {
+        pauseEngine();
+    }
+    m_streaming = false;
+    m_paused    = false;
+    setStatsRunning(false);
 
-        const uint8_t *p         = payload.data();
-        const uint8_t  headerLen = p[0];
-        const uint8_t  headerBfh = p[1];
+    // A batch or a waitForFrame() caller waiting for frames will not get any more
+    endBatch();
+    {
+        std::lock_guard<std::mutex> lock(m_frameWaitMutex);
+        ++m_streamStops;
+    }
+    m_frameWaitCondition.notify_all();
 
-        if (headerLen > transferred)
-            continue;
+    // Return the partially assembled buffer to the pool
+    m_streamLease.reset();
+    unlockStreamMemory();
 
-        const uint8_t *img      = p + headerLen;
-        const int      imgBytes = transferred - headerLen;
+    return Error::SUCCESS;
+}
 
-        // NOTE: SOF signals are unreliable - ignore them and only use EOF for frame completion
+bool Knokke::isStreaming() const { return m_streaming; }
 
-        if (imgBytes > 0)
-        {
-            size_t spaceLeft = FRAME_BYTES - frame.size();
-            size_t toCopy    = std::min(static_cast<size_t>(imgBytes), spaceLeft);
+Knokke::Error Knokke::pauseStreaming()
+{
+    if (!m_streaming)
+    {
+        return Error::STREAMING_NOT_STARTED;
+    }
+
+    if (!m_paused.exchange(true))
+    {
+        pauseEngine();
+        setStatsRunning(false);
+    }
+    return Error::SUCCESS;
+}
 
-            // Simple frame concatenation - just append data until EOF
+Knokke::Error Knokke::resumeStreaming()
+{
+    if (!m_streaming)
+    {
+        return Error::STREAMING_NOT_STARTED;
+    }
 
-            frame.insert(frame.end(), img, img + toCopy);
+    if (!m_paused)
+    {
+        return Error::SUCCESS;
+    }
 
-            // Only print debug info for corrupted/incomplete frames
-            if (frame.size() > 0 && frame.size() < FRAME_BYTES && (headerBfh & UVC_HEADER_EOF))
-            {
-                std::cout << "WARNING: Incomplete frame detected! Size: " << frame.size() << " / "
-                          << FRAME_BYTES << " bytes" << std::endl;
-            }
-        }
+    // The frame the pause cut off is dropped; frames sent while paused were not wanted, so
+    // they are not reported as lost
+    m_streamAssembler.resync();
+    m_frameStartPending = true;
 
-        if (headerBfh & UVC_HEADER_EOF)
-        {
-            gotEof = true;
-            // Only print debug info for incomplete frames
-            if (frame.size() < FRAME_BYTES)
-            {
-                std::cout << "ERROR: Frame incomplete at EOF! Size: " << frame.size() << " / "
-                          << FRAME_BYTES << " bytes" << std::endl;
-            }
-        }
+    Error result = resumeEngine(false);
+    if (result == Error::SUCCESS)
+    {
+        m_paused = false;
+        setStatsRunning(true);
     }
+    return result;
+}
+
+bool Knokke::isPaused() const { return m_paused; }
 
-    if (frame.size() != FRAME_BYTES)
+Knokke::Error Knokke::setRecoveryTimeout(int timeoutMs)
+{
+    if (timeoutMs < 0)
     {
-        std::cout << "ERROR: Frame capture incomplete! Size: " << frame.size() << " / "
-                  << FRAME_BYTES << " bytes" << std::endl;
-        return Error::CONTROL_TRANSFER_FAILED;
+        return Error::INVALID_PARAMETER;
     }
 
-    std::memcpy(frameData, frame.data(), FRAME_BYTES);
+    m_recoveryTimeoutMs = timeoutMs;
     return Error::SUCCESS;
 }
 
-Knokke::Error Knokke::captureFrames(int numFrames, FrameCallback frameCallback)
+std::vector<FrameMode> Knokke::getFrameModes() const
 {
-    if (!m_connected)
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_frameModes;
+}
+
+FrameMode Knokke::getFrameMode() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_frameMode;
+}
+
+Knokke::Error Knokke::setFrameMode(const FrameMode &mode)
+{
+    if (m_streaming)
     {
-        return Error::DEVICE_NOT_CONNECTED;
+        return Error::STREAMING_ALREADY_STARTED;
     }
 
-    for (int i = 0; i < numFrames; ++i)
+    FrameMode selected;
+    bool      found = false;
     {
-        std::vector<uint8_t> frame(FRAME_BYTES);
-        Error                result = captureFrame(frame.data(), FRAME_BYTES);
-        if (result != Error::SUCCESS)
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const FrameMode &available : m_frameModes)
         {
-            return result;
+            if (available == mode)
+            {
+                selected = available;
+                found    = true;
+                break;
+            }
         }
+    }
 
-        frameCallback(frame.data(), FRAME_BYTES, i);
+    if (!found)
+    {
+        return Error::INVALID_PARAMETER;
     }
 
+    applyFrameMode(selected);
     return Error::SUCCESS;
 }
 
-std::string Knokke::getErrorMessage(Error error)
+FrameMode Knokke::defaultFrameMode()
 {
-    switch (error)
-    {
-    case Error::SUCCESS:
-        return "Success";
-    case Error::DEVICE_NOT_FOUND:
-        return "Device not found";
-    case Error::DEVICE_OPEN_FAILED:
-        return "Failed to open device";
-    case Error::DEVICE_NOT_CONNECTED:
-        return "Device not connected";
-    case Error::CONTROL_TRANSFER_FAILED:
-        return "Control transfer failed";
-    case Error::STREAMING_NOT_STARTED:
-        return "Streaming not started";
-    case Error::STREAMING_ALREADY_STARTED:
-        return "Streaming already started";
-    case Error::THREAD_CREATION_FAILED:
-        return "Thread creation failed";
-    case Error::INVALID_PARAMETER:
-        return "Invalid parameter";
-    case Error::USB_ERROR:
-        return "USB error";
-    case Error::UNKNOWN_ERROR:
-    default:
-        return "Unknown error";
-    }
+    FrameMode mode;
+    mode.formatIndex   = DEFAULT_FORMAT_INDEX;
+    mode.frameIndex    = DEFAULT_FRAME_INDEX;
+    mode.width         = DEFAULT_FRAME_WIDTH;
+    mode.height        = DEFAULT_FRAME_HEIGHT;
+    mode.bitsPerPixel  = DEFAULT_BITS_PER_PIXEL;
+    mode.frameInterval = DEFAULT_FRAME_INTERVAL;
+    return mode;
 }
 
-std::string Knokke::getDeviceInfo() const
+void Knokke::applyFrameMode(const FrameMode &mode)
 {
-    if (!m_connected)
     {
-        return "Device not connected";
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_frameMode = mode;
     }
 
-    // Get actual device descriptor
-    libusb_device           *device = libusb_get_device(m_deviceHandle);
-    libusb_device_descriptor desc;
-
-    if (libusb_get_device_descriptor(device, &desc) == 0)
+    // Buffers only change size with the frame; a new rate or format index reuses them
+    const size_t frameBytes = mode.frameBytes();
+    if (m_streamAssembler.frameBytes() == frameBytes)
     {
-        std::ostringstream oss;
-        oss << "Knokke Film Scanner (VID: 0x" << std::hex << std::uppercase << std::setfill('0')
-            << std::setw(4) << desc.idVendor << ", PID: 0x" << std::setw(4) << desc.idProduct
-            << ")";
-        return oss.str();
+        return;
     }
-    else
-    {
-        std::ostringstream oss;
-        oss << "Knokke Film Scanner (VID: 0x" << std::hex << std::uppercase << std::setfill('0')
-            << std::setw(4) << VENDOR_ID << ", PID: 0x" << std::setw(4) << PRODUCT_ID << ")";
-        return oss.str();
+
+    // Leases still held by consumers keep the old pool alive until they are released
+    m_streamFrame.assign(frameBytes, 0);
+    m_streamAssembler.setFrameBytes(frameBytes);
+    m_streamAssembler.setSlot(m_streamFrame.data());
+    m_framePool = FramePool::create(FRAME_POOL_SIZE, frameBytes);
+}
+
+Knokke::Error Knokke::setCaptureMode(CaptureMode mode)
+{
+    if (m_streaming)
+    {
+        return Error::STREAMING_ALREADY_STARTED;
+    }
+
+    // The engine and its buffers are set up for one mode
+    if (mode != m_captureMode)
+    {
+        stopEngine();
+    }
+    m_captureMode = mode;
+    return Error::SUCCESS;
+}
+
+Knokke::CaptureMode Knokke::getCaptureMode() const { return m_captureMode; }
+
+Knokke::Error Knokke::setTransferQueueDepth(int depth)
+{
+    if (depth < 1 || depth > MAX_TRANSFER_QUEUE_DEPTH)
+    {
+        return Error::INVALID_PARAMETER;
+    }
+
+    if (m_streaming)
+    {
+        return Error::STREAMING_ALREADY_STARTED;
+    }
+
+    m_transferQueueDepth = depth;
+    m_autoQueueDepth     = false;
+    return Error::SUCCESS;
+}
+
+int Knokke::getTransferQueueDepth() const { return m_transferQueueDepth; }
+
+Knokke::Error Knokke::setTransferSize(int bytes)
+{
+    if (bytes != 0 && (bytes < DEFAULT_BULK_PACKET_BYTES || bytes > MAX_TRANSFER_BYTES))
+    {
+        return Error::INVALID_PARAMETER;
+    }
+
+    if (m_streaming)
+    {
+        return Error::STREAMING_ALREADY_STARTED;
+    }
+
+    m_autoTransferBytes = bytes == 0;
+    m_transferMultiple  = 1;
+    if (!m_autoTransferBytes)
+    {
+        m_transferBytes = bytes;
+    }
+    return Error::SUCCESS;
+}
+
+int Knokke::getTransferSize() const { return m_transferBytes; }
+
+uint32_t Knokke::getMaxVideoFrameSize() const { return m_maxVideoFrameSize; }
+
+uint32_t Knokke::getMaxPayloadTransferSize() const { return m_maxPayloadTransferSize; }
+
+Knokke::Error Knokke::autotuneTransferSize(int measureMs)
+{
+    if (!m_connected)
+    {
+        return Error::DEVICE_NOT_CONNECTED;
+    }
+
+    if (m_streaming)
+    {
+        return Error::STREAMING_ALREADY_STARTED;
+    }
+
+    if (measureMs <= 0)
+    {
+        return Error::INVALID_PARAMETER;
+    }
+
+    // Start from the size derived from the negotiated payload, then try multiples of it.
+    // Sizes are set directly while measuring; the caller's sizing mode is restored after.
+    const bool autoTransferBytes = m_autoTransferBytes;
+    m_autoTransferBytes          = true;
+    m_transferMultiple           = 1;
+    Error result                 = sendProbeCommit();
+    if (result != Error::SUCCESS)
+    {
+        m_autoTransferBytes = autoTransferBytes;
+        return result;
+    }
+    configureTransfers();
+
+    const int baseBytes = m_transferBytes;
+    int       bestBytes = baseBytes;
+    double    bestRate  = -1.0;
+
+    m_autoTransferBytes = false;
+    for (int bytes = baseBytes; bytes <= MAX_TRANSFER_BYTES; bytes *= 2)
+    {
+        m_transferBytes = bytes;
+        result          = startStreaming();
+        if (result != Error::SUCCESS)
+        {
+            break;
+        }
+
+        const uint64_t startFrame = m_frameNumber;
+        std::this_thread::sleep_for(std::chrono::milliseconds(measureMs));
+        const uint64_t frames = m_frameNumber - startFrame;
+        const uint64_t lost   = std::min<uint64_t>(getLostFrameCount(), frames);
+        stopStreaming();
+
+        // Frames actually delivered per second; ties keep the smaller transfer size
+        const double rate = (frames - lost) * 1000.0 / measureMs;
+        std::cout << "Autotune: " << bytes << " byte transfers delivered " << rate << " fps ("
+                  << lost << " lost)" << std::endl;
+        if (rate > bestRate)
+        {
+            bestRate  = rate;
+            bestBytes = bytes;
+        }
+    }
+
+    m_transferBytes     = bestBytes;
+    m_autoTransferBytes = autoTransferBytes;
+    if (m_autoTransferBytes)
+    {
+        m_transferMultiple = bestBytes / baseBytes;
+    }
+    std::cout << "Autotune: keeping " << m_transferBytes << " byte transfers" << std::endl;
+    return result;
+}
+
+Knokke::Error Knokke::setZeroCopyBuffers(bool enable)
+{
+    if (m_streaming)
+    {
+        return Error::STREAMING_ALREADY_STARTED;
+    }
+
+    if (enable != m_zeroCopyRequested)
+    {
+        stopEngine();
+    }
+    m_zeroCopyRequested = enable;
+    return Error::SUCCESS;
+}
+
+bool Knokke::isUsingZeroCopyBuffers() const { return m_zeroCopyActive; }
+
+Knokke::Error Knokke::setRealtimeOptions(const RealtimeOptions &options)
+{
+    if (m_streaming)
+    {
+        return Error::STREAMING_ALREADY_STARTED;
+    }
+    if (options.priority < 1 || options.priority > 99)
+    {
+        return Error::INVALID_PARAMETER;
+    }
+
+    // Options turned off are never undone on a running engine: its threads keep their scheduling
+    // and its buffers their locks. Start over with a fresh engine instead.
+    stopEngine();
+
+    std::lock_guard<std::mutex> lock(m_realtimeMutex);
+    m_realtime = options;
+    return Error::SUCCESS;
+}
+
+Knokke::RealtimeOptions Knokke::getRealtimeOptions() const
+{
+    std::lock_guard<std::mutex> lock(m_realtimeMutex);
+    return m_realtime;
+}
+
+Knokke::RealtimeStatus Knokke::getRealtimeStatus() const
+{
+    std::lock_guard<std::mutex> lock(m_realtimeMutex);
+    return m_realtimeStatus;
+}
+
+void Knokke::setFrameCallback(FrameCallback callback)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_frameCallback = callback;
+}
+
+void Knokke::setFrameInfoCallback(FrameInfoCallback callback)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_frameInfoCallback = callback;
+}
+
+uint64_t Knokke::getLostFrameCount() const { return m_lostFrameCount; }
+
+Knokke::StreamStats Knokke::getStreamStats() const
+{
+    StreamStats stats;
+    stats.bytesReceived    = m_statsBytes.load(std::memory_order_relaxed);
+    stats.completeFrames   = m_statsComplete.load(std::memory_order_relaxed);
+    stats.incompleteFrames = m_statsIncomplete.load(std::memory_order_relaxed);
+    stats.droppedFrames    = m_statsDropped.load(std::memory_order_relaxed);
+    stats.lostFrames       = m_lostFrameCount.load(std::memory_order_relaxed);
+    stats.bulkTimeouts     = m_statsBulkTimeouts.load(std::memory_order_relaxed);
+    stats.bulkErrors       = m_statsBulkErrors.load(std::memory_order_relaxed);
+    stats.recoveries       = m_statsRecoveries.load(std::memory_order_relaxed);
+    stats.recoveryFailures = m_statsRecoveryFailures.load(std::memory_order_relaxed);
+    stats.controlLatency   = m_controlLatency.snapshot();
+    stats.callbackTime     = m_callbackTime.snapshot();
+    stats.recoveryTime     = m_recoveryTime.snapshot();
+
+    const int64_t nowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              std::chrono::steady_clock::now().time_since_epoch())
+                              .count();
+    {
+        std::lock_guard<std::mutex> lock(m_statsTimeMutex);
+        const int64_t activeNs = m_statsActiveNs + (m_statsStartNs ? nowNs - m_statsStartNs : 0);
+        stats.elapsedSeconds   = activeNs / 1e9;
+    }
+    if (stats.elapsedSeconds > 0)
+    {
+        stats.framesPerSecond = stats.completeFrames / stats.elapsedSeconds;
+        stats.bytesPerSecond  = stats.bytesReceived / stats.elapsedSeconds;
+    }
+    return stats;
+}
+
+void Knokke::resetStreamStats()
+{
+    m_statsBytes.store(0, std::memory_order_relaxed);
+    m_statsComplete.store(0, std::memory_order_relaxed);
+    m_statsIncomplete.store(0, std::memory_order_relaxed);
+    m_statsDropped.store(0, std::memory_order_relaxed);
+    m_statsBulkTimeouts.store(0, std::memory_order_relaxed);
+    m_statsBulkErrors.store(0, std::memory_order_relaxed);
+    m_statsRecoveries.store(0, std::memory_order_relaxed);
+    m_statsRecoveryFailures.store(0, std::memory_order_relaxed);
+    m_controlLatency.reset();
+    m_callbackTime.reset();
+    m_recoveryTime.reset();
+    {
+        std::lock_guard<std::mutex> lock(m_statsTimeMutex);
+        m_statsActiveNs = 0;
+        m_statsStartNs  = 0;
+    }
+    setStatsRunning(true);
+}
+
+void Knokke::setStatsRunning(bool running)
+{
+    const int64_t nowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              std::chrono::steady_clock::now().time_since_epoch())
+                              .count();
+
+    // Close the stretch that is running, if any, and open a new one if streaming goes on
+    std::lock_guard<std::mutex> lock(m_statsTimeMutex);
+    if (m_statsStartNs != 0)
+    {
+        m_statsActiveNs += nowNs - m_statsStartNs;
+    }
+    m_statsStartNs = running ? nowNs : 0;
+}
+
+uint32_t Knokke::getDeviceClockFrequency() const { return m_deviceClock.nominalFrequency(); }
+
+std::shared_ptr<FrameSubscription> Knokke::subscribe(const FrameSubscription::Options &options)
+{
+    return m_frameBus.subscribe(options);
+}
+
+void Knokke::unsubscribe(const std::shared_ptr<FrameSubscription> &subscription)
+{
+    m_frameBus.unsubscribe(subscription);
+}
+
+Knokke::Error Knokke::startRecording(const std::string &path, bool compress, size_t bufferBytes)
+{
+    std::lock_guard<std::mutex> lock(m_recordingMutex);
+    if (m_recording)
+    {
+        return Error::INVALID_PARAMETER;
+    }
+
+    if (compress && !CaptureJournal::compressionAvailable())
+    {
+        handleError(Error::INVALID_PARAMETER, "Journal compression is not available");
+        return Error::INVALID_PARAMETER;
+    }
+
+    CaptureJournal::Options options;
+    options.compress    = compress;
+    options.bufferBytes = bufferBytes;
+    options.mode        = getFrameMode();
+    if (!m_journal.open(path, options))
+    {
+        handleError(Error::FILE_ERROR, "Failed to open journal " + path);
+        return Error::FILE_ERROR;
+    }
+
+    // Start with the current state so frames before the next change can be interpreted
+    m_recording = true;
+    journalParameters();
+    return Error::SUCCESS;
+}
+
+void Knokke::stopRecording()
+{
+    std::lock_guard<std::mutex> lock(m_recordingMutex);
+    if (!m_recording)
+    {
+        return;
+    }
+
+    m_recording = false;
+    m_journal.close();
+
+    const CaptureJournal::Stats stats = m_journal.stats();
+    std::cout << "Recording stopped: " << stats.framesWritten << " frames written, "
+              << stats.framesDropped << " dropped" << std::endl;
+}
+
+bool Knokke::isRecording() const { return m_recording; }
+
+CaptureJournal::Stats Knokke::getRecordingStats() const { return m_journal.stats(); }
+
+void Knokke::setErrorCallback(ErrorCallback callback)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_errorCallback = callback;
+}
+
+Knokke::Error Knokke::captureFrame(uint8_t *frameData, size_t frameSize, int timeoutMs)
+{
+    if (!m_connected)
+    {
+        return Error::DEVICE_NOT_CONNECTED;
+    }
+
+    const size_t frameBytes = m_frameMode.frameBytes();
+    if (frameSize < frameBytes)
+    {
+        return Error::INVALID_PARAMETER;
+    }
+
+    const int            payload_len = m_transferBytes;
+    std::vector<uint8_t> payload(payload_len);
+
+    // Payload image bytes land directly in the caller's buffer
+    FrameAssembler assembler(frameBytes);
+    assembler.setSlot(frameData);
+
+    auto startTime  = std::chrono::steady_clock::now();
+    int  safetyIter = 0;
+
+    while (safetyIter < 1000)
+    {
+        ++safetyIter;
+        auto currentTime = std::chrono::steady_clock::now();
+        auto elapsed =
+            std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - startTime);
+        if (elapsed.count() > timeoutMs)
+        {
+            return Error::CONTROL_TRANSFER_FAILED;
+        }
+
+        int transferred = 0;
+        int result      = m_transport->bulkRead(payload.data(), payload_len, &transferred, 200);
+
+        if (result == LIBUSB_ERROR_TIMEOUT)
+        {
+            continue;
+        }
+        if (result < 0)
+        {
+            handleError(Error::USB_ERROR,
+                        "Bulk transfer error: " + std::string(libusb_error_name(result)));
+            return Error::USB_ERROR;
+        }
+
+        // NOTE: SOF signals are unreliable - ignore them and only use EOF for frame completion
+        FrameAssembler::Result frameResult = assembler.feed(payload.data(), transferred);
+        if (frameResult == FrameAssembler::Result::FRAME_COMPLETE)
+        {
+            return Error::SUCCESS;
+        }
+
+        if (frameResult == FrameAssembler::Result::FRAME_DISCARDED)
+        {
+            // Short or overflowing frame (e.g. we joined mid-frame), wait for the next one
+            std::cout << "ERROR: Frame incomplete at EOF! Size: " << assembler.bytesReceived()
+                      << " / " << frameBytes << " bytes" << std::endl;
+        }
+    }
+
+    std::cout << "ERROR: Frame capture incomplete! Size: " << assembler.bytesWritten() << " / "
+              << frameBytes << " bytes" << std::endl;
+    return Error::CONTROL_TRANSFER_FAILED;
+}
+
+Knokke::Error Knokke::captureFrames(int numFrames, FrameCallback frameCallback)
+{
+    if (!m_connected)
+    {
+        return Error::DEVICE_NOT_CONNECTED;
+    }
+
+    // One pooled buffer is reused for every frame in the batch
+    FrameLease frame = m_framePool ? m_framePool->acquire() : FrameLease();
+    if (!frame)
+    {
+        return Error::BUFFER_POOL_EXHAUSTED;
+    }
+
+    for (int i = 0; i < numFrames; ++i)
+    {
+        Error result = captureFrame(frame.data(), frame.capacity());
+        if (result != Error::SUCCESS)
+        {
+            return result;
+        }
+
+        frameCallback(frame.data(), m_frameMode.frameBytes(), i);
+    }
+
+    return Error::SUCCESS;
+}
+
+Knokke::Error Knokke::captureBatch(uint8_t          *buffer,
+                                   size_t            bufferSize,
+                                   size_t            numFrames,
+                                   BatchFrameStatus *statuses,
+                                   int               timeoutMs)
+{
+    if (!m_streaming)
+    {
+        return Error::STREAMING_NOT_STARTED;
+    }
+
+    const size_t frameBytes = m_frameMode.frameBytes();
+    if (!buffer || !statuses || numFrames == 0 || bufferSize / frameBytes < numFrames)
+    {
+        return Error::INVALID_PARAMETER;
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+    // One batch at a time, the capture thread fills a single destination
+    std::unique_lock<std::mutex> lock(m_batchMutex);
+    if (!m_batchCondition.wait_until(lock, deadline, [this] { return !m_batch.claimed; }))
+    {
+        return Error::TIMEOUT;
+    }
+
+    // stopStreaming() clears m_streaming before endBatch() takes this lock, so checked here a
+    // stop either comes first or finds the batch and ends it
+    if (!m_streaming)
+    {
+        return Error::STREAMING_NOT_STARTED;
+    }
+
+    m_batch.buffer   = buffer;
+    m_batch.bytes    = bufferSize;
+    m_batch.statuses = statuses;
+    m_batch.count    = numFrames;
+    m_batch.filled   = 0;
+    m_batch.claimed  = true;
+    m_batch.active   = true;
+    m_batchActive.store(true, std::memory_order_release);
+
+    // Also wakes on stopStreaming(), which ends the batch early
+    m_batchCondition.wait_until(lock, deadline, [this] { return !m_batch.active; });
+
+    const size_t filled = m_batch.filled;
+    m_batch             = BatchCapture();
+    m_batchActive.store(false, std::memory_order_release);
+    m_batchCondition.notify_all();
+    lock.unlock();
+
+    if (filled == numFrames)
+    {
+        return Error::SUCCESS;
+    }
+
+    const Error missing = m_streaming ? Error::TIMEOUT : Error::STREAMING_NOT_STARTED;
+    for (size_t i = filled; i < numFrames; ++i)
+    {
+        statuses[i]        = BatchFrameStatus();
+        statuses[i].status = missing;
+    }
+    return missing;
+}
+
+std::string Knokke::getErrorMessage(Error error)
+{
+    switch (error)
+    {
+    case Error::SUCCESS:
+        return "Success";
+    case Error::DEVICE_NOT_FOUND:
+        return "Device not found";
+    case Error::DEVICE_OPEN_FAILED:
+        return "Failed to open device";
+    case Error::DEVICE_NOT_CONNECTED:
+        return "Device not connected";
+    case Error::CONTROL_TRANSFER_FAILED:
+        return "Control transfer failed";
+    case Error::STREAMING_NOT_STARTED:
+        return "Streaming not started";
+    case Error::STREAMING_ALREADY_STARTED:
+        return "Streaming already started";
+    case Error::THREAD_CREATION_FAILED:
+        return "Thread creation failed";
+    case Error::INVALID_PARAMETER:
+        return "Invalid parameter";
+    case Error::USB_ERROR:
+        return "USB error";
+    case Error::BUFFER_POOL_EXHAUSTED:
+        return "Frame buffer pool exhausted";
+    case Error::FILE_ERROR:
+        return "File error";
+    case Error::TIMEOUT:
+        return "Timed out";
+    case Error::NEGOTIATION_FAILED:
+        return "Stream negotiation failed";
+    case Error::STREAM_LOST:
+        return "Stream lost";
+    case Error::UNKNOWN_ERROR:
+    default:
+        return "Unknown error";
+    }
+}
+
+std::string Knokke::getDeviceInfo() const
+{
+    if (!m_connected)
+    {
+        return "Device not connected";
+    }
+
+    return m_transport->description();
+}
+
+Knokke::Error Knokke::enterBootloader()
+{
+    if (!m_connected)
+    {
+        return Error::DEVICE_NOT_CONNECTED;
+    }
+
+    uint8_t data[1] = {0x01}; // Enter bootloader mode
+    return performControlTransfer(UVC_REQUEST_TYPE_CLASS_OUT,
+                                  UVC_SET_CUR,
+                                  UVC_UPDATE_CONTROL,
+                                  UVC_EXTENSION_UNIT,
+                                  data,
+                                  sizeof(data));
+}
+
+Knokke::Error Knokke::performControlTransfer(uint8_t  requestType,
+                                             uint8_t  request,
+                                             uint16_t value,
+                                             uint16_t index,
+                                             uint8_t *data,
+                                             uint16_t length,
+                                             int      timeout)
+{
+    ++m_controlTransferCount;
+    const auto start = std::chrono::steady_clock::now();
+    int        result =
+        m_transport->controlTransfer(requestType, request, value, index, data, length, timeout);
+    m_controlLatency.record(std::chrono::steady_clock::now() - start);
+
+    if (result < 0)
+    {
+        handleError(Error::CONTROL_TRANSFER_FAILED,
+                    "Control transfer failed: " + std::string(libusb_error_name(result)));
+        return Error::CONTROL_TRANSFER_FAILED;
+    }
+
+    return Error::SUCCESS;
+}
+
+Knokke::Error Knokke::sendProbeCommit()
+{
+    // UVC probe control data (34 bytes as per UVC 1.1 spec)
+    unsigned char probeData[34] = {
+        0x00, 0x00, // bmHint: No fixed parameters
+        0x00,       // bFormatIndex: Set from the selected frame mode below
+        0x00,       // bFrameIndex: Set from the selected frame mode below
+        0x00, 0x00,
+        0x00, 0x00, // dwFrameInterval: Set from the selected frame mode below, in 100ns units
+        0x00, 0x00, // wKeyFrameRate: Key frame rate in key frame/video frame units
+        0x00, 0x00, // wPFrameRate: PFrame rate in PFrame / key frame units
+        0x00, 0x00, // wCompQuality: Compression quality control
+        0x00, 0x00, // wCompWindowSize: Window size for average bit rate
+        0x00, 0x00, // wDelay: Internal video streaming i/f latency in ms
+        0x00, 0x00,
+        0x00, 0x00, // dwMaxVideoFrameSize: Set from the selected frame mode below
+        0x00, 0x90,
+        0x00, 0x00, // dwMaxPayloadTransferSize: No. of bytes device can rx in single payload: 36KB
+        0x00, 0x60,
+        0xE3, 0x16, // dwClockFrequency: Device Clock
+        0x00,       // bmFramingInfo: Framing Information - Ignored for uncompressed format
+        0x00,       // bPreferedVersion: Preferred payload format version
+        0x00,       // bMinVersion: Minimum payload format version
+        0x00        // bMaxVersion: Maximum payload format version
+    };
+
+    const FrameMode mode = m_frameMode;
+    probeData[2]         = mode.formatIndex;
+    probeData[3]         = mode.frameIndex;
+    writeLe(&probeData[4], mode.frameInterval, 4);
+    writeLe(&probeData[18], static_cast<uint32_t>(mode.frameBytes()), 4);
+
+    // Send probe control
+    Error result = performControlTransfer(UVC_REQUEST_TYPE_CLASS_OUT,
+                                          UVC_SET_CUR,
+                                          UVC_VS_PROBE_CONTROL,
+                                          UVC_STREAMING_INTERFACE,
+                                          probeData,
+                                          sizeof(probeData));
+    if (result != Error::SUCCESS)
+    {
+        return result;
+    }
+
+    // Read back what the device accepted; it may have adjusted any field of the probe
+    unsigned char negotiated[sizeof(probeData)];
+    result = performControlTransfer(UVC_REQUEST_TYPE_CLASS,
+                                    UVC_GET_CUR,
+                                    UVC_VS_PROBE_CONTROL,
+                                    UVC_STREAMING_INTERFACE,
+                                    negotiated,
+                                    sizeof(negotiated));
+    if (result == Error::SUCCESS && readLe(&negotiated[18], 4) != 0 &&
+        readLe(&negotiated[22], 4) != 0)
+    {
+        std::memcpy(probeData, negotiated, sizeof(probeData));
+    }
+    else
+    {
+        std::cout << "Probe GET_CUR failed, committing the requested stream parameters"
+                  << std::endl;
+    }
+
+    // dwMaxVideoFrameSize and dwMaxPayloadTransferSize
+    m_maxVideoFrameSize      = static_cast<uint32_t>(readLe(&probeData[18], 4));
+    m_maxPayloadTransferSize = static_cast<uint32_t>(readLe(&probeData[22], 4));
+
+    // dwClockFrequency sets the tick rate of PTS and SCR
+    m_deviceClock.setNominalFrequency(static_cast<uint32_t>(readLe(&probeData[26], 4)));
+
+    // Frames are assembled into buffers of the mode's size, a device sending another size
+    // would fill them with torn frames
+    if (m_maxVideoFrameSize != mode.frameBytes())
+    {
+        handleError(Error::NEGOTIATION_FAILED,
+                    "Device frame size " + std::to_string(m_maxVideoFrameSize) +
+                        " differs from the mode's " + std::to_string(mode.frameBytes()) +
+                        " bytes");
+        return Error::NEGOTIATION_FAILED;
+    }
+
+    // Send commit control with the negotiated values
+    return performControlTransfer(UVC_REQUEST_TYPE_CLASS_OUT,
+                                  UVC_SET_CUR,
+                                  UVC_VS_COMMIT_CONTROL,
+                                  UVC_STREAMING_INTERFACE,
+                                  probeData,
+                                  sizeof(probeData));
+}
+
+void Knokke::configureTransfers()
+{
+    // Each bulk transfer must hold a whole payload, since only its first bytes carry a header;
+    // round up to the endpoint packet size so the short packet ends the transfer
+    if (m_autoTransferBytes && m_maxPayloadTransferSize > 0)
+    {
+        int packetSize = m_transport->maxPacketSize();
+        if (packetSize <= 0)
+        {
+            packetSize = DEFAULT_BULK_PACKET_BYTES;
+        }
+
+        const int payloadBytes = static_cast<int>(
+            std::min<uint32_t>(m_maxPayloadTransferSize, MAX_TRANSFER_BYTES - packetSize));
+        const int baseBytes    = (payloadBytes + packetSize - 1) / packetSize * packetSize;
+        m_transferBytes        = std::min(baseBytes * m_transferMultiple, MAX_TRANSFER_BYTES);
+    }
+
+    // Keep enough transfers queued for two frames, and never fewer than the default
+    if (m_autoQueueDepth && m_maxVideoFrameSize > 0 && m_maxPayloadTransferSize > 0)
+    {
+        const uint32_t payloadsPerFrame =
+            (m_maxVideoFrameSize + m_maxPayloadTransferSize - 1) / m_maxPayloadTransferSize;
+        m_transferQueueDepth =
+            std::max(DEFAULT_TRANSFER_QUEUE_DEPTH,
+                     static_cast<int>(std::min<uint32_t>(2 * payloadsPerFrame,
+                                                         MAX_TRANSFER_QUEUE_DEPTH)));
+    }
+}
+
+void Knokke::captureThreadFunction()
+{
+    std::unique_lock<std::mutex> lock(m_engineMutex);
+    while (true)
+    {
+        m_engineParked = true;
+        m_engineCondition.notify_all();
+        m_engineCondition.wait(lock, [this] { return m_engineWake || !m_threadRunning; });
+        if (!m_threadRunning)
+        {
+            break;
+        }
+
+        m_engineWake           = false;
+        m_engineParked         = false;
+        const bool reconfigure = m_engineReconfigure;
+        m_engineReconfigure    = false;
+        lock.unlock();
+
+        const bool asynchronous = asynchronousCapture();
+        if (reconfigure)
+        {
+            applyRealtimeThread(asynchronous);
+
+            lock.lock();
+            m_engineConfigured = true;
+            m_engineCondition.notify_all();
+            lock.unlock();
+        }
+
+        if (asynchronous)
+        {
+            runAsynchronousCapture();
+        }
+        else
+        {
+            runSynchronousCapture();
+        }
+
+        lock.lock();
+    }
+}
+
+void Knokke::runSynchronousCapture()
+{
+    const int length    = static_cast<int>(m_readBuffer.size);
+    int       lastError = LIBUSB_SUCCESS;
+    while (m_engineActive)
+    {
+        /* read in from the USB */
+        int transferred = 0;
+        int result      = m_transport->bulkRead(m_readBuffer.data, length, &transferred, 200);
+
+        if (result == LIBUSB_ERROR_TIMEOUT)
+        {
+            m_statsBulkTimeouts.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // A halted endpoint or a vanished device fails every read at once. Recover in place if
+        // possible, otherwise report it once and back off instead of spinning.
+        if (result < 0 && result != LIBUSB_ERROR_TIMEOUT && transferred == 0)
+        {
+            m_statsBulkErrors.fetch_add(1, std::memory_order_relaxed);
+            if (result != lastError && recoverStream(result))
+            {
+                lastError = LIBUSB_SUCCESS;
+                continue;
+            }
+
+            // A recovery that gave up has stopped the stream, without one reading goes on
+            lastError = result;
+            if (m_engineActive)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            continue;
+        }
+        lastError = LIBUSB_SUCCESS;
+
+        processPayload(m_readBuffer.data, transferred);
+    }
+}
+
+void Knokke::runAsynchronousCapture()
+{
+    while (true)
+    {
+        // Wait until every queued transfer has completed or been cancelled
+        drainAsyncTransfers();
+        if (!m_engineActive || !m_recoveryPending)
+        {
+            break;
+        }
+
+        // A failed transfer lets the queue drain; bring the device back and refill it. With
+        // nothing left queued, a stream that cannot come back is over.
+        if (!recoverStream(m_recoveryError) || submitAsyncTransfers() != Error::SUCCESS)
+        {
+            cancelAsyncTransfers();
+            drainAsyncTransfers();
+            streamLost();
+            break;
+        }
+    }
+}
+
+Knokke::Error Knokke::startEngine()
+{
+    if (m_captureThread)
+    {
+        return Error::SUCCESS;
+    }
+
+    m_threadRunning = true;
+    m_engineWake    = false;
+    m_engineParked  = false;
+    try
+    {
+        m_captureThread = std::make_unique<std::thread>(&Knokke::captureThreadFunction, this);
+    }
+    catch (const std::system_error &)
+    {
+        m_threadRunning = false;
+        return Error::THREAD_CREATION_FAILED;
+    }
+    return Error::SUCCESS;
+}
+
+void Knokke::stopEngine()
+{
+    if (m_captureThread)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_engineMutex);
+            m_threadRunning = false;
+        }
+        m_engineCondition.notify_all();
+        if (m_captureThread->joinable())
+        {
+            m_captureThread->join();
+        }
+        m_captureThread.reset();
+    }
+
+    freeTransfers();
+}
+
+Knokke::Error Knokke::resumeEngine(bool reconfigure)
+{
+    m_engineActive = true;
+
+    // Completions are handled on the shared USB event thread from the first submission on
+    if (asynchronousCapture())
+    {
+        // A transport given at construction may be a libusb one without this object having
+        // joined the shared context yet
+        if (initialize() != Error::SUCCESS || !m_usb->startEvents())
+        {
+            m_engineActive = false;
+            return Error::THREAD_CREATION_FAILED;
+        }
+
+        Error result = submitAsyncTransfers();
+        if (result != Error::SUCCESS)
+        {
+            // The engine is parked, unwind whatever was already queued here
+            m_engineActive = false;
+            cancelAsyncTransfers();
+            drainAsyncTransfers();
+            return result;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_engineMutex);
+        m_engineWake        = true;
+        m_engineReconfigure = m_engineReconfigure || reconfigure;
+        m_engineConfigured  = m_engineConfigured && !reconfigure;
+    }
+    m_engineCondition.notify_all();
+    return Error::SUCCESS;
+}
+
+void Knokke::pauseEngine()
+{
+    // Completions arriving after this point are not resubmitted, the rest are cancelled. A
+    // synchronous read returns within its timeout.
+    m_engineActive = false;
+    cancelAsyncTransfers();
+
+    std::unique_lock<std::mutex> lock(m_engineMutex);
+    m_engineCondition.wait(lock, [this] { return m_engineParked && !m_engineWake; });
+}
+
+bool Knokke::asynchronousCapture() const
+{
+    // Transports without a libusb handle can only be read with blocking calls
+    return m_captureMode == CaptureMode::ASYNCHRONOUS && m_transport->nativeHandle();
+}
+
+void Knokke::processPayload(const uint8_t *payload, int length)
+{
+    const auto arrival = std::chrono::steady_clock::now();
+    m_statsBytes.fetch_add(static_cast<uint64_t>(length), std::memory_order_relaxed);
+    if (m_frameStartPending)
+    {
+        m_frameStartTime    = arrival;
+        m_frameStartPending = false;
+    }
+
+    /* Header is parsed in place and image bytes are written straight into the frame slot */
+    const uint64_t               resyncs = m_streamAssembler.resyncCount();
+    const FrameAssembler::Result result  = m_streamAssembler.feed(payload, length);
+
+    // A frame cut off by the next one's FID toggle is dropped without FRAME_DISCARDED. This
+    // payload already opened the next frame, so that frame started now rather than when the
+    // one it replaced did.
+    if (m_streamAssembler.resyncCount() != resyncs)
+    {
+        m_statsIncomplete.fetch_add(1, std::memory_order_relaxed);
+        m_frameStartTime = arrival;
+    }
+
+    // One SCR sample per frame is plenty to track the device clock and keeps the fit cheap
+    const UvcPayloadHeader &header = m_streamAssembler.lastHeader();
+    if (header.hasScr() && (header.flags & UvcPayloadHeader::UVC_HEADER_EOF))
+    {
+        m_deviceClock.addSample(header.scrStc, arrival);
+    }
+
+    switch (result)
+    {
+    case FrameAssembler::Result::FRAME_COMPLETE:
+    {
+        // Frame numbers advance over lost frames so they track position in the device stream
+        const uint32_t lost        = m_streamAssembler.takeLostFrames();
+        const uint64_t frameNumber = m_frameNumber.fetch_add(lost + 1) + lost;
+        m_lostFrameCount += lost;
+        m_statsComplete.fetch_add(1, std::memory_order_relaxed);
+
+        m_frameStartPending = true;
+
+        // Exposure starts at the PTS when the device sends one, otherwise assume it started a
+        // frame period before the first payload arrived
+        FrameInfo info;
+        info.frameNumber        = frameNumber;
+        info.size               = m_streamAssembler.frameBytes();
+        info.width              = m_frameMode.width;
+        info.height             = m_frameMode.height;
+        info.hostTimestamp      = arrival;
+        info.hasDeviceTimestamp = m_streamAssembler.framePts(info.devicePts) &&
+                                  m_deviceClock.isValid();
+        info.deviceTimestamp    = info.hasDeviceTimestamp ? m_deviceClock.toHost(info.devicePts)
+                                                          : FrameInfo::TimePoint();
+        stampGeneration(info,
+                        frameNumber,
+                        info.hasDeviceTimestamp
+                            ? info.deviceTimestamp
+                            : m_frameStartTime -
+                                  std::chrono::microseconds(m_frameMode.frameInterval / 10));
+
+        // A batch takes every frame, including one the pool had no buffer for
+        if (m_batchActive.load(std::memory_order_acquire))
+        {
+            deliverBatchFrame(m_streamLease ? m_streamLease.data() : m_streamFrame.data(),
+                              info,
+                              lost);
+        }
+
+        // A frame assembled into the scratch slot had no pool buffer and is dropped
+        if (!m_streamLease)
+        {
+            m_pendingGap += lost + 1;
+            ++m_lostFrameCount;
+            m_statsDropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            info.gapCount        = m_pendingGap + lost;
+            m_pendingGap         = 0;
+            m_streamLease.info() = info;
+
+            // Publish the latest frame for getLatestFrame() without waiting on readers
+            m_latestFrame.publish(m_streamLease);
+            m_latestFrameNumber = frameNumber + 1;
+            if (m_frameWaiters > 0)
+            {
+                // Taking the mutex orders this with a waiter between its check and its sleep
+                {
+                    std::lock_guard<std::mutex> lock(m_frameWaitMutex);
+                }
+                m_frameWaitCondition.notify_all();
+            }
+
+            // Hand the same buffer to every subscriber
+            m_frameBus.publish(m_streamLease);
+
+            // The journal copies the frame into its own ring, the lease is not held
+            if (m_recording)
+            {
+                m_journal.appendFrame(m_streamLease.data(), info);
+            }
+
+            // Call frame callbacks if set
+            if (m_frameCallback || m_frameInfoCallback)
+            {
+                const auto callbackStart = std::chrono::steady_clock::now();
+                if (m_frameCallback)
+                {
+                    m_frameCallback(m_streamLease.data(), info.size, frameNumber);
+                }
+                if (m_frameInfoCallback)
+                {
+                    m_frameInfoCallback(m_streamLease.data(), info);
+                }
+                m_callbackTime.record(std::chrono::steady_clock::now() - callbackStart);
+            }
+        }
+
+        prepareStreamSlot();
+        break;
+    }
+    case FrameAssembler::Result::FRAME_DISCARDED:
+        m_frameStartPending = true;
+
+        // Log incomplete frames but don't process them
+        if (m_streamAssembler.bytesReceived() > 0)
+        {
+            m_statsIncomplete.fetch_add(1, std::memory_order_relaxed);
+            std::cout << "STREAM WARNING: Discarding incomplete frame! Size: "
+                      << m_streamAssembler.bytesReceived() << " / "
+                      << m_streamAssembler.frameBytes() << " bytes"
+                      << std::endl;
+        }
+
+        // The slot is reused for the next frame unless we are still on the scratch slot
+        if (!m_streamLease)
+        {
+            prepareStreamSlot();
+        }
+        break;
+    case FrameAssembler::Result::INCOMPLETE:
+        break;
+    }
+}
+
+void Knokke::deliverBatchFrame(const uint8_t *data, const FrameInfo &info, uint32_t lost)
+{
+    std::lock_guard<std::mutex> lock(m_batchMutex);
+    if (!m_batch.active)
+    {
+        return;
+    }
+
+    // The frame mode can only have changed if streaming restarted while the caller waited
+    if ((m_batch.filled + 1) * info.size > m_batch.bytes)
+    {
+        m_batch.active = false;
+        m_batchActive.store(false, std::memory_order_release);
+        m_batchCondition.notify_all();
+        return;
+    }
+
+    // The batch starts at its first frame, so only losses after that one count as gaps
+    BatchFrameStatus &entry = m_batch.statuses[m_batch.filled];
+    std::memcpy(m_batch.buffer + m_batch.filled * info.size, data, info.size);
+    entry.status        = Error::SUCCESS;
+    entry.info          = info;
+    entry.info.gapCount = m_batch.filled == 0 ? 0 : lost;
+
+    if (++m_batch.filled == m_batch.count)
+    {
+        m_batch.active = false;
+        m_batchActive.store(false, std::memory_order_release);
+        m_batchCondition.notify_all();
+    }
+}
+
+void Knokke::endBatch()
+{
+    std::lock_guard<std::mutex> lock(m_batchMutex);
+    m_batch.active = false;
+    m_batchActive.store(false, std::memory_order_release);
+    m_batchCondition.notify_all();
+}
+
+void Knokke::prepareStreamSlot()
+{
+    m_streamLease = m_framePool ? m_framePool->acquire() : FrameLease();
+    if (m_streamLease)
+    {
+        m_streamAssembler.setSlot(m_streamLease.data());
+        m_poolExhausted = false;
+        return;
+    }
+
+    // Every buffer is leased by consumers: keep the stream in sync but drop the next frame
+    m_streamAssembler.setSlot(m_streamFrame.data());
+    if (!m_poolExhausted)
+    {
+        m_poolExhausted = true;
+        handleError(Error::BUFFER_POOL_EXHAUSTED,
+                    "Frame buffer pool exhausted, dropping frames until a lease is released");
+    }
+}
+
+Knokke::Error Knokke::prepareTransfers()
+{
+    const size_t bytes = static_cast<size_t>(m_transferBytes);
+
+    if (!asynchronousCapture())
+    {
+        if (m_readBuffer.data && m_readBuffer.size == bytes)
+        {
+            return Error::SUCCESS;
+        }
+
+        freeTransfers();
+        if (allocateTransferBuffer(m_readBuffer, bytes) != Error::SUCCESS)
+        {
+            return Error::USB_ERROR;
+        }
+        m_zeroCopyActive = m_readBuffer.deviceMemory;
+        return Error::SUCCESS;
+    }
+
+    if (m_transfers.size() == static_cast<size_t>(m_transferQueueDepth) &&
+        m_transferBuffers.front().size == bytes)
+    {
+        return Error::SUCCESS;
+    }
+
+    freeTransfers();
+    m_transfers.assign(m_transferQueueDepth, nullptr);
+    m_transferBuffers.assign(m_transferQueueDepth, TransferBuffer());
+
+    bool allDeviceMemory = true;
+    for (int i = 0; i < m_transferQueueDepth; ++i)
+    {
+        if (allocateTransferBuffer(m_transferBuffers[i], bytes) != Error::SUCCESS)
+        {
+            freeTransfers();
+            return Error::USB_ERROR;
+        }
+        allDeviceMemory = allDeviceMemory && m_transferBuffers[i].deviceMemory;
+
+        m_transfers[i] = libusb_alloc_transfer(0);
+        if (!m_transfers[i])
+        {
+            freeTransfers();
+            handleError(Error::USB_ERROR, "Failed to allocate bulk transfer");
+            return Error::USB_ERROR;
+        }
+
+        libusb_fill_bulk_transfer(m_transfers[i],
+                                  m_transport->nativeHandle(),
+                                  BULK_EP_IN,
+                                  m_transferBuffers[i].data,
+                                  m_transferBytes,
+                                  &Knokke::transferCallback,
+                                  this,
+                                  1000);
+    }
+    m_zeroCopyActive = allDeviceMemory;
+    return Error::SUCCESS;
+}
+
+Knokke::Error Knokke::submitAsyncTransfers()
+{
+    m_recoveryPending = false;
+    for (libusb_transfer *transfer : m_transfers)
+    {
+        // Counted first, the event thread may complete the transfer before the call returns
+        ++m_transfersInFlight;
+        int result = libusb_submit_transfer(transfer);
+        if (result < 0)
+        {
+            transferFinished();
+            handleError(Error::USB_ERROR,
+                        "Failed to submit bulk transfer: " +
+                            std::string(libusb_error_name(result)));
+            return Error::USB_ERROR;
+        }
+    }
+    return Error::SUCCESS;
+}
+
+void Knokke::cancelAsyncTransfers()
+{
+    // Transfers that are not queued just report LIBUSB_ERROR_NOT_FOUND. A completion being
+    // resubmitted right now is queued before the loop runs; later ones see the engine stopped.
+    std::lock_guard<std::mutex> lock(m_resubmitMutex);
+    for (libusb_transfer *transfer : m_transfers)
+    {
+        libusb_cancel_transfer(transfer);
+    }
+}
+
+void Knokke::drainAsyncTransfers()
+{
+    // Completions run on the shared USB event thread, this only waits for the last of them
+    std::unique_lock<std::mutex> lock(m_transferMutex);
+    m_transferCondition.wait(lock, [this] { return m_transfersInFlight == 0; });
+}
+
+void Knokke::transferFinished()
+{
+    // Counted down under the lock: a drain that sees the last one finished may free the
+    // transfers and this object, so nothing may touch them once the lock is released
+    std::lock_guard<std::mutex> lock(m_transferMutex);
+    if (--m_transfersInFlight == 0)
+    {
+        m_transferCondition.notify_all();
+    }
+}
+
+void Knokke::freeTransfers()
+{
+    for (libusb_transfer *transfer : m_transfers)
+    {
+        if (transfer)
+        {
+            libusb_free_transfer(transfer);
+        }
+    }
+
+    for (TransferBuffer &buffer : m_transferBuffers)
+    {
+        freeTransferBuffer(buffer);
+    }
+    freeTransferBuffer(m_readBuffer);
+
+    m_transfers.clear();
+    m_transferBuffers.clear();
+    m_zeroCopyActive = false;
+}
+
+Knokke::Error Knokke::allocateTransferBuffer(TransferBuffer &buffer, size_t size)
+{
+    buffer.size         = size;
+    buffer.deviceMemory = false;
+    buffer.data         = nullptr;
+
+#if defined(KNOKKE_USE_DEV_MEM) && defined(LIBUSB_API_VERSION) && (LIBUSB_API_VERSION >= 0x01000105)
+    // Kernel-mapped memory lets usbfs DMA into the buffer without a bounce copy. Platforms
+    // without support return NULL and we fall back to the heap.
+    if (m_zeroCopyRequested && m_transport->nativeHandle())
+    {
+        buffer.data = libusb_dev_mem_alloc(m_transport->nativeHandle(), size);
+        if (buffer.data)
+        {
+            buffer.deviceMemory = true;
+            return Error::SUCCESS;
+        }
+    }
+#endif
+
+    // Zero-filled so every page is faulted in before the first transfer
+    buffer.data = new (std::nothrow) uint8_t[size]();
+    if (!buffer.data)
+    {
+        handleError(Error::USB_ERROR, "Failed to allocate transfer buffer");
+        return Error::USB_ERROR;
+    }
+
+    return Error::SUCCESS;
+}
+
+void Knokke::freeTransferBuffer(TransferBuffer &buffer)
+{
+    if (!buffer.data)
+    {
+        return;
+    }
+
+#if defined(KNOKKE_USE_DEV_MEM) && defined(LIBUSB_API_VERSION) && (LIBUSB_API_VERSION >= 0x01000105)
+    if (buffer.deviceMemory)
+    {
+        libusb_dev_mem_free(m_transport->nativeHandle(), buffer.data, buffer.size);
+        buffer.data = nullptr;
+        return;
+    }
+#endif
+
+    if (buffer.locked)
+    {
+        Realtime::unlockMemory(buffer.data, buffer.size);
+        buffer.locked = false;
+    }
+    delete[] buffer.data;
+    buffer.data = nullptr;
+}
+
+void Knokke::applyRealtimeThread(bool asynchronous)
+{
+    if (!m_realtime.enabled)
+    {
+        return;
+    }
+
+    // Asynchronous completions run on the shared USB event thread, this one only waits for them
+    UsbContext::RealtimeResult result;
+    if (asynchronous)
+    {
+        result = m_usb->setEventRealtime(m_realtime.eventCpu, m_realtime.priority);
+    }
+    else
+    {
+        if (m_realtime.captureCpu >= 0)
+        {
+            result.pinned = Realtime::pinCurrentThread(m_realtime.captureCpu, result.pinError);
+        }
+        result.raised = Realtime::raiseCurrentThread(m_realtime.priority, result.raiseError);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_realtimeMutex);
+        m_realtimeStatus.affinity = result.pinned;
+        m_realtimeStatus.priority = result.raised;
+    }
+    if (!result.pinError.empty())
+    {
+        realtimeFailed(&RealtimeStatus::affinity, result.pinError);
+    }
+    if (!result.raised)
+    {
+        realtimeFailed(&RealtimeStatus::priority, result.raiseError);
+    }
+}
+
+bool Knokke::lockStreamMemory(const void *data, size_t bytes)
+{
+    std::string reason;
+    if (!Realtime::lockMemory(data, bytes, reason))
+    {
+        realtimeFailed(&RealtimeStatus::memoryLocked, "frame buffers: " + reason);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_realtimeMutex);
+    m_lockedMemory.emplace_back(data, bytes);
+    return true;
+}
+
+bool Knokke::lockTransferBuffers()
+{
+    // Buffers kept from an earlier start may have failed to lock then, so each start checks them
+    // all again. Kernel-mapped device memory is pinned already.
+    std::string reason;
+    bool        locked = true;
+    auto        lock   = [&reason, &locked](TransferBuffer &buffer)
+    {
+        if (buffer.data && !buffer.deviceMemory && !buffer.locked)
+        {
+            buffer.locked = Realtime::lockMemory(buffer.data, buffer.size, reason);
+            locked        = locked && buffer.locked;
+        }
+    };
+
+    lock(m_readBuffer);
+    for (TransferBuffer &buffer : m_transferBuffers)
+    {
+        lock(buffer);
+    }
+    if (!locked)
+    {
+        realtimeFailed(&RealtimeStatus::memoryLocked, "transfer buffers: " + reason);
+    }
+    return locked;
+}
+
+void Knokke::unlockStreamMemory()
+{
+    std::lock_guard<std::mutex> lock(m_realtimeMutex);
+    for (const auto &region : m_lockedMemory)
+    {
+        Realtime::unlockMemory(region.first, region.second);
+    }
+    m_lockedMemory.clear();
+}
+
+void Knokke::realtimeFailed(bool RealtimeStatus::*applied, const std::string &reason)
+{
+    std::lock_guard<std::mutex> lock(m_realtimeMutex);
+    m_realtimeStatus.*applied = false;
+    m_realtimeStatus.message += (m_realtimeStatus.message.empty() ? "" : "; ") + reason;
+
+    // Streaming goes on without it, so this is a warning rather than an error callback
+    std::cout << "REALTIME WARNING: " << reason << ", continuing without" << std::endl;
+}
+
+void Knokke::hotplugThreadFunction()
+{
+    // No hotplug support: watch the device list for presence changes
+    bool present = false;
+    while (m_hotplugRunning)
+    {
+        bool nowPresent = isDevicePresent();
+        if (nowPresent != present)
+        {
+            present = nowPresent;
+            m_hotplugCallback(present ? HotplugEvent::DEVICE_ARRIVED : HotplugEvent::DEVICE_LEFT);
+        }
+
+        std::unique_lock<std::mutex> lock(m_hotplugMutex);
+        m_hotplugCondition.wait_for(lock,
+                                    std::chrono::milliseconds(m_hotplugPollMs),
+                                    [this] { return !m_hotplugRunning; });
     }
 }
 
-Knokke::Error Knokke::enterBootloader()
+bool Knokke::isOwnDevice(const std::string &location)
 {
-    if (!m_connected)
+    std::lock_guard<std::mutex> lock(m_hotplugMutex);
+
+    // Connected: only the scanner this instance has open
+    if (!m_deviceLocation.empty())
     {
-        return Error::DEVICE_NOT_CONNECTED;
+        return location == m_deviceLocation;
     }
 
-    uint8_t data[1] = {0x01}; // Enter bootloader mode
-    return performControlTransfer(UVC_REQUEST_TYPE_CLASS_OUT,
-                                  UVC_SET_CUR,
-                                  UVC_UPDATE_CONTROL,
-                                  UVC_EXTENSION_UNIT,
-                                  data,
-                                  sizeof(data));
+    // A departed scanner's serial number cannot be read, so a serial choice is left to connect()
+    if (m_selectedDevice.serialNumber.empty() && !m_selectedDevice.location.empty())
+    {
+        return location == m_selectedDevice.location;
+    }
+    return !m_usb->isDeviceAcquired(location);
 }
 
-Knokke::Error Knokke::performControlTransfer(uint8_t  requestType,
-                                             uint8_t  request,
-                                             uint16_t value,
-                                             uint16_t index,
-                                             uint8_t *data,
-                                             uint16_t length,
-                                             int      timeout)
+int LIBUSB_CALL Knokke::hotplugCallback(libusb_context      *context,
+                                        libusb_device       *device,
+                                        libusb_hotplug_event event,
+                                        void                *userData)
 {
-    int result = libusb_control_transfer(
-        m_deviceHandle, requestType, request, value, index, data, length, timeout);
+    (void)context;
 
-    if (result < 0)
+    // Every instance registers for the same VID/PID, so each sees the others' scanners too
+    Knokke                     *self = static_cast<Knokke *>(userData);
+    std::lock_guard<std::mutex> lock(self->m_hotplugDispatchMutex);
+    if (self->m_hotplugRunning && self->m_hotplugCallback &&
+        self->isOwnDevice(UsbContext::locationKey(device)))
     {
-        handleError(Error::CONTROL_TRANSFER_FAILED,
-                    "Control transfer failed: " + std::string(libusb_error_name(result)));
-        return Error::CONTROL_TRANSFER_FAILED;
+        self->m_hotplugCallback(event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED
+                                    ? HotplugEvent::DEVICE_ARRIVED
+                                    : HotplugEvent::DEVICE_LEFT);
     }
 
-    return Error::SUCCESS;
+    // Stay registered until stopHotplugMonitor()
+    return 0;
 }
 
-Knokke::Error Knokke::sendProbeCommit()
+void LIBUSB_CALL Knokke::transferCallback(libusb_transfer *transfer)
 {
-    // UVC probe control data (34 bytes as per UVC 1.1 spec)
-    unsigned char probeData[34] = {
-        0x00, 0x00, // bmHint: No fixed parameters
-        0x01,       // bFormatIndex: Use 1st Video format index (YUY2)
-        0x02,       // bFrameIndex: Use 2nd Video frame index (3840x12@400fps)
-        0xa7, 0x61,
-        0x00, 0x00, // dwFrameInterval: Desired frame interval in 100ns = (1/400.0)x10^7
-        0x00, 0x00, // wKeyFrameRate: Key frame rate in key frame/video frame units
-        0x00, 0x00, // wPFrameRate: PFrame rate in PFrame / key frame units
-        0x00, 0x00, // wCompQuality: Compression quality control
-        0x00, 0x00, // wCompWindowSize: Window size for average bit rate
-        0x00, 0x00, // wDelay: Internal video streaming i/f latency in ms
-        0x00, 0x68,
-        0x01, 0x00, // dwMaxVideoFrameSize: Max video frame size in bytes = 3840 x 12 x 2
-        0x00, 0x90,
-        0x00, 0x00, // dwMaxPayloadTransferSize: No. of bytes device can rx in single payload: 36KB
-        0x00, 0x60,
-        0xE3, 0x16, // dwClockFrequency: Device Clock
-        0x00,       // bmFramingInfo: Framing Information - Ignored for uncompressed format
-        0x00,       // bPreferedVersion: Preferred payload format version
-        0x00,       // bMinVersion: Minimum payload format version
-        0x00        // bMaxVersion: Maximum payload format version
-    };
+    Knokke *self = static_cast<Knokke *>(transfer->user_data);
 
-    // Send probe control
-    Error result = performControlTransfer(UVC_REQUEST_TYPE_CLASS_OUT,
-                                          UVC_SET_CUR,
-                                          UVC_VS_PROBE_CONTROL,
-                                          UVC_STREAMING_INTERFACE,
-                                          probeData,
-                                          sizeof(probeData));
-    if (result != Error::SUCCESS)
+    switch (transfer->status)
     {
-        return result;
+    case LIBUSB_TRANSFER_TIMED_OUT:
+        self->m_statsBulkTimeouts.fetch_add(1, std::memory_order_relaxed);
+        // A timed out bulk transfer may still carry a partial payload
+        self->processPayload(transfer->buffer, transfer->actual_length);
+        break;
+    case LIBUSB_TRANSFER_COMPLETED:
+        self->processPayload(transfer->buffer, transfer->actual_length);
+        break;
+    case LIBUSB_TRANSFER_CANCELLED:
+        self->transferFinished();
+        return;
+    default:
+        self->m_statsBulkErrors.fetch_add(1, std::memory_order_relaxed);
+        if (!self->m_recoveryPending.exchange(true))
+        {
+            // The capture engine recovers once the rest of the queue has drained
+            self->m_recoveryError = transfer->status == LIBUSB_TRANSFER_STALL ? LIBUSB_ERROR_PIPE
+                                    : transfer->status == LIBUSB_TRANSFER_NO_DEVICE
+                                        ? LIBUSB_ERROR_NO_DEVICE
+                                        : LIBUSB_ERROR_IO;
+        }
+        self->transferFinished();
+        return;
     }
 
-    // Send commit control
-    return performControlTransfer(UVC_REQUEST_TYPE_CLASS_OUT,
-                                  UVC_SET_CUR,
-                                  UVC_VS_COMMIT_CONTROL,
-                                  UVC_STREAMING_INTERFACE,
-                                  probeData,
-                                  sizeof(probeData));
+    // Checked and resubmitted under the lock cancelAsyncTransfers() takes, otherwise a cancel
+    // landing in between would miss the transfer and leave it queued until it times out
+    int  result  = LIBUSB_SUCCESS;
+    bool stopped = false;
+    {
+        std::lock_guard<std::mutex> lock(self->m_resubmitMutex);
+        if (!self->m_engineActive || self->m_recoveryPending)
+        {
+            stopped = true;
+        }
+        else
+        {
+            result = libusb_submit_transfer(transfer);
+        }
+    }
+    if (result < 0)
+    {
+        self->handleError(Error::USB_ERROR,
+                          "Failed to resubmit bulk transfer: " +
+                              std::string(libusb_error_name(result)));
+
+        // The queue would only shrink from here, recover as from a failed transfer
+        if (!self->m_recoveryPending.exchange(true))
+        {
+            self->m_recoveryError = result;
+        }
+    }
+    if (stopped || result < 0)
+    {
+        self->transferFinished();
+    }
 }
 
-void Knokke::captureThreadFunction()
+bool Knokke::recoverStream(int error)
 {
-    const int            payload_len = 100 * 1024;
-    std::vector<uint8_t> payload(payload_len);
-    std::vector<uint8_t> frame;
+    const std::string reason    = "Bulk transfer error: " + std::string(libusb_error_name(error));
+    const int         timeoutMs = m_recoveryTimeoutMs;
+    if (timeoutMs == 0)
+    {
+        handleError(Error::USB_ERROR, reason);
+        return false;
+    }
+    handleError(Error::USB_ERROR, reason + ", recovering stream");
 
-    const uint8_t UVC_HEADER_SOF = 1u << 0; // Start of Frame
-    const uint8_t UVC_HEADER_EOF = 1u << 1; // End of Frame
+    const auto start    = std::chrono::steady_clock::now();
+    const auto deadline = start + std::chrono::milliseconds(timeoutMs);
 
-    while (m_threadRunning == true)
+    // A stall only needs the halt cleared; a device that went away has to be opened again
+    bool reclaim   = error == LIBUSB_ERROR_NO_DEVICE;
+    int  backoffMs = RECOVERY_BACKOFF_MS;
+    for (int attempt = 1; m_engineActive; ++attempt)
     {
-        if (m_streaming == false)
+        if (recoverDevice(reclaim) == Error::SUCCESS)
         {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-            continue;
+            const auto elapsed = std::chrono::steady_clock::now() - start;
+            m_recoveryTime.record(elapsed);
+            m_statsRecoveries.fetch_add(1, std::memory_order_relaxed);
+            std::cout << "Stream recovered in "
+                      << std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()
+                      << " ms (" << (reclaim ? "interface re-claimed" : "halt cleared")
+                      << ", attempt " << attempt << ")" << std::endl;
+            return true;
         }
 
-        while (m_threadRunning == true)
+        // Whatever clearing the halt could not fix, re-claiming the interface might
+        reclaim = true;
+        if (std::chrono::steady_clock::now() + std::chrono::milliseconds(backoffMs) > deadline)
         {
-            /* read in from the USB */
-            int transferred = 0;
-            libusb_bulk_transfer(
-                m_deviceHandle, BULK_EP_IN, payload.data(), payload_len, &transferred, 200);
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(backoffMs));
+        backoffMs = std::min(backoffMs * 2, MAX_RECOVERY_BACKOFF_MS);
+    }
 
-            /* Parse UVC payload header */
-            if (transferred < 2)
-            {
-                continue;
-            }
+    m_statsRecoveryFailures.fetch_add(1, std::memory_order_relaxed);
+    if (m_engineActive)
+    {
+        handleError(Error::USB_ERROR,
+                    "Stream recovery failed after " + std::to_string(timeoutMs) +
+                        " ms, reconnect the scanner");
+        streamLost();
+    }
+    return false;
+}
 
-            const uint8_t  header_len = payload[0];
-            const uint8_t *img        = payload.data() + header_len;
-            const int      img_len    = transferred - header_len;
+void Knokke::streamLost()
+{
+    // A pause or stop that got here first owns the stream
+    if (!m_engineActive.exchange(false))
+    {
+        return;
+    }
 
-            /* Add on the incoming data to the frame */
-            std::vector<uint8_t> incoming(img, img + img_len);
-            frame.insert(frame.end(), incoming.begin(), incoming.end());
+    // startStreaming() waits for the engine to park, so a new stream cannot overlap the rest
+    m_streaming = false;
+    m_paused    = false;
+    setStatsRunning(false);
+    endBatch();
+    m_streamLease.reset();
+    unlockStreamMemory();
+    handleError(Error::STREAM_LOST, "Streaming stopped, the scanner could not be recovered");
 
-            /* Frame is in theory complete here */
-            const uint8_t headerBfh = payload[1];
-            if (headerBfh & UVC_HEADER_EOF)
-            {
-                // Only process complete frames
-                if (frame.size() == FRAME_BYTES)
-                {
-                    // Store the latest frame for getLatestFrame()
-                    {
-                        std::lock_guard<std::mutex> lock(m_latestFrameMutex);
-                        m_latestFrame = frame;
-                    }
-
-                    // Call frame callback if set
-                    if (m_frameCallback)
-                    {
-                        m_frameCallback(frame.data(), frame.size(), m_frameNumber.fetch_add(1));
-                    }
-                }
-                else if (frame.size() > 0)
-                {
-                    // Log incomplete frames but don't process them
-                    std::cout << "STREAM WARNING: Discarding incomplete frame! Size: "
-                              << frame.size() << " / " << FRAME_BYTES << " bytes" << std::endl;
-                }
+    // Waiters wake to a stream that is already reported lost
+    {
+        std::lock_guard<std::mutex> lock(m_frameWaitMutex);
+        ++m_streamStops;
+    }
+    m_frameWaitCondition.notify_all();
+}
 
-                /* Reset the frame for more data */
-                frame.clear();
-            }
+Knokke::Error Knokke::recoverDevice(bool reclaim)
+{
+    // Parameter writes from other threads wait until the device is back; cached reads do not
+    std::lock_guard<std::recursive_mutex> deviceLock(m_controlMutex);
 
-            if (frame.size() > FRAME_BYTES)
-            {
-                /* Reset the frame for more data */
-                frame.clear();
-            }
+    Error result = Error::SUCCESS;
+    if (reclaim)
+    {
+        // Device memory is mapped through the handle being closed. Transfers on the new handle
+        // would fall back to a bounce copy, so every buffer is made again once it is open.
+        {
+            std::lock_guard<std::mutex> lock(m_resubmitMutex);
+            freeTransfers();
+        }
+        m_transport->close();
+        if (m_transport->open() < 0)
+        {
+            return Error::DEVICE_OPEN_FAILED;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_resubmitMutex);
+            result = prepareTransfers();
+        }
+        if (result != Error::SUCCESS)
+        {
+            return result;
+        }
+        if (m_realtime.enabled && m_realtime.lockMemory)
+        {
+            lockTransferBuffers();
         }
     }
+    else if (m_transport->clearHalt() < 0)
+    {
+        return Error::USB_ERROR;
+    }
+
+    result = sendProbeCommit();
+    if (result != Error::SUCCESS)
+    {
+        return result;
+    }
+
+    // Write back every parameter the shadow copy vouches for, the device may have been reset.
+    // The values do not change, so this opens no parameter generation and journals nothing;
+    // if a write fails the shadow still holds them for the next attempt.
+    ScannerParams params;
+    uint32_t      valid;
+    {
+        std::lock_guard<std::recursive_mutex> lock(m_shadowMutex);
+        params = m_shadow;
+        valid  = m_shadowValid;
+    }
+    if (valid & (1u << CONTROL_EXPOSURE))
+    {
+        result = writeExposureTime(params.exposure_time);
+    }
+    if (result == Error::SUCCESS && (valid & (1u << CONTROL_GAIN)))
+    {
+        result = writeGain(params.gain);
+    }
+    if (result == Error::SUCCESS && (valid & (1u << CONTROL_BACKLIGHT)))
+    {
+        result = writeBacklight(params.backlight);
+    }
+    if (result == Error::SUCCESS && (valid & (1u << CONTROL_MOTOR_SPEED)))
+    {
+        result = writeMotorSpeed(params.motor_speed);
+    }
+    if (result != Error::SUCCESS)
+    {
+        return result;
+    }
+
+    // The frame cut off by the error is lost, start over on the next one
+    if (m_streamAssembler.bytesReceived() > 0)
+    {
+        ++m_pendingGap;
+        ++m_lostFrameCount;
+        m_statsIncomplete.fetch_add(1, std::memory_order_relaxed);
+    }
+    m_streamAssembler.resync();
+    m_frameStartPending = true;
+    return Error::SUCCESS;
 }
 
 void Knokke::handleError(Error error, const std::string &message)
@@ -770,7 +2786,7 @@ void Knokke::handleError(Error error, const std::string &message)
     }
 }
 
-bool Knokke::findDevice()
+std::unique_ptr<KnokkeTransport> Knokke::findDevice()
 {
     libusb_device **devices;
     ssize_t         deviceCount = libusb_get_device_list(m_context, &devices);
@@ -779,12 +2795,13 @@ bool Knokke::findDevice()
     {
         handleError(Error::USB_ERROR,
                     "Failed to get device list: " + std::string(libusb_error_name(deviceCount)));
-        return false;
+        return nullptr;
     }
 
     std::cout << "Scanning " << deviceCount << " USB devices for Knokke scanner..." << std::endl;
 
-    for (ssize_t i = 0; i < deviceCount; ++i)
+    std::unique_ptr<KnokkeTransport> transport;
+    for (ssize_t i = 0; i < deviceCount && !transport; ++i)
     {
         libusb_device           *device = devices[i];
         libusb_device_descriptor desc;
@@ -797,230 +2814,211 @@ bool Knokke::findDevice()
             continue;
         }
 
-        std::cout << "Found device: VID=0x" << std::hex << desc.idVendor << " PID=0x"
-                  << desc.idProduct << std::dec << std::endl;
-
-        if (desc.idVendor == VENDOR_ID && desc.idProduct == PRODUCT_ID)
+        if (desc.idVendor != VENDOR_ID || desc.idProduct != PRODUCT_ID)
         {
-            std::cout << "Found Knokke scanner! Attempting to open..." << std::endl;
-
-            // Check if device is already open by another process
-            libusb_device_handle *testHandle = nullptr;
-            int                   openResult = libusb_open(device, &testHandle);
+            continue;
+        }
 
-            if (openResult < 0)
+        // Skip scanners other instances hold, and any but the chosen one if there is a choice
+        const std::string location = UsbContext::locationKey(device);
+        if (m_usb->isDeviceAcquired(location))
+        {
+            continue;
+        }
+        if (!m_selectedDevice.serialNumber.empty())
+        {
+            if (readSerialNumber(device) != m_selectedDevice.serialNumber)
             {
-                std::cout << "Failed to open device: " << libusb_error_name(openResult)
-                          << std::endl;
-                handleError(Error::DEVICE_OPEN_FAILED,
-                            "Failed to open device: " + std::string(libusb_error_name(openResult)));
-                libusb_free_device_list(devices, 1);
-                return false;
+                continue;
             }
-
-            // If we get here, the device opened successfully
-            m_deviceHandle = testHandle;
-            std::cout << "Successfully opened Knokke scanner!" << std::endl;
-            libusb_free_device_list(devices, 1);
-
-            return true;
         }
+        else if (!m_selectedDevice.location.empty() && location != m_selectedDevice.location)
+        {
+            continue;
+        }
+
+        std::cout << "Found Knokke scanner at " << location << std::endl;
+        transport.reset(new UsbTransport(m_usb, device, BULK_EP_IN));
     }
 
     libusb_free_device_list(devices, 1);
-    return false;
+    return transport;
 }
 
-Knokke::Error Knokke::claimInterfaces()
+std::string Knokke::readSerialNumber(libusb_device *device)
 {
-    std::cout << "Claiming interfaces..." << std::endl;
-
-    // Ensure configuration 1 is active
-    int currentCfg = -1;
-    libusb_get_configuration(m_deviceHandle, &currentCfg);
-    std::cout << "Current configuration: " << currentCfg << std::endl;
-
-    if (currentCfg != 1)
+    libusb_device_descriptor desc;
+    if (libusb_get_device_descriptor(device, &desc) != LIBUSB_SUCCESS || desc.iSerialNumber == 0)
     {
-        std::cout << "Setting configuration to 1..." << std::endl;
-        int result = libusb_set_configuration(m_deviceHandle, 1);
-        if (result < 0)
-        {
-            std::cout << "Failed to set configuration: " << libusb_error_name(result) << std::endl;
-            handleError(Error::USB_ERROR,
-                        "Failed to set configuration: " + std::string(libusb_error_name(result)));
-            return Error::USB_ERROR;
-        }
-        std::cout << "Configuration set successfully" << std::endl;
+        return std::string();
     }
 
-    // Find the streaming interface
-    std::cout << "Getting active config descriptor..." << std::endl;
-    libusb_config_descriptor *cfg = nullptr;
-    int cfgResult = libusb_get_active_config_descriptor(libusb_get_device(m_deviceHandle), &cfg);
-    if (cfgResult < 0)
+    libusb_device_handle *handle = nullptr;
+    if (libusb_open(device, &handle) != LIBUSB_SUCCESS)
     {
-        std::cout << "Failed to get config descriptor: " << libusb_error_name(cfgResult)
-                  << std::endl;
-        handleError(Error::USB_ERROR,
-                    "Failed to get config descriptor: " +
-                        std::string(libusb_error_name(cfgResult)));
-        return Error::USB_ERROR;
+        return std::string();
     }
-    std::cout << "Config descriptor retrieved successfully" << std::endl;
 
-    int  streamIfNum = -1;
-    int  streamAlt   = -1;
-    bool epFound     = false;
+    unsigned char serial[256];
+    const int     length =
+        libusb_get_string_descriptor_ascii(handle, desc.iSerialNumber, serial, sizeof(serial));
+    libusb_close(handle);
 
-    std::cout << "Scanning " << (int)cfg->bNumInterfaces << " interfaces..." << std::endl;
+    return length > 0 ? std::string(reinterpret_cast<char *>(serial), length) : std::string();
+}
 
-    for (uint8_t i = 0; i < cfg->bNumInterfaces && !epFound; ++i)
+std::vector<Knokke::DeviceInfo> Knokke::enumerateDevices()
+{
+    std::vector<DeviceInfo>     found;
+    std::shared_ptr<UsbContext> usb = UsbContext::shared();
+    if (!usb)
     {
-        std::cout << "Checking interface " << (int)i << "..." << std::endl;
-        const libusb_interface &iface = cfg->interface[i];
-        std::cout << "Interface " << (int)i << " has " << iface.num_altsetting << " alt settings"
-                  << std::endl;
+        return found;
+    }
+
+    libusb_device **devices;
+    ssize_t         deviceCount = libusb_get_device_list(usb->get(), &devices);
+    if (deviceCount < 0)
+    {
+        return found;
+    }
 
-        for (int a = 0; a < iface.num_altsetting && !epFound; ++a)
+    for (ssize_t i = 0; i < deviceCount; ++i)
+    {
+        libusb_device_descriptor desc;
+        if (libusb_get_device_descriptor(devices[i], &desc) != LIBUSB_SUCCESS ||
+            desc.idVendor != VENDOR_ID || desc.idProduct != PRODUCT_ID)
         {
-            std::cout << "Checking alt setting " << a << "..." << std::endl;
-            const libusb_interface_descriptor &idesc = iface.altsetting[a];
-            std::cout << "Alt setting " << a << " has " << (int)idesc.bNumEndpoints << " endpoints"
-                      << std::endl;
-            std::cout << "Interface descriptor: bInterfaceNumber=" << (int)idesc.bInterfaceNumber
-                      << ", bAlternateSetting=" << (int)idesc.bAlternateSetting << std::endl;
+            continue;
+        }
 
-            for (uint8_t e = 0; e < idesc.bNumEndpoints && !epFound; ++e)
-            {
-                std::cout << "Checking endpoint " << (int)e << "..." << std::endl;
-                const libusb_endpoint_descriptor &ep   = idesc.endpoint[e];
-                uint8_t                           addr = ep.bEndpointAddress;
-                uint8_t                           attr = ep.bmAttributes & 0x3;
-                std::cout << "Endpoint " << (int)e << ": addr=0x" << std::hex << (int)addr
-                          << std::dec << ", attr=" << (int)attr << std::endl;
-
-                if ((addr == BULK_EP_IN) && (attr == LIBUSB_TRANSFER_TYPE_BULK))
-                {
-                    std::cout << "Found matching endpoint! Interface="
-                              << (int)idesc.bInterfaceNumber
-                              << ", Alt=" << (int)idesc.bAlternateSetting << std::endl;
-                    // Use the actual interface number where the endpoint was found
-                    streamIfNum = idesc.bInterfaceNumber;
-                    streamAlt   = idesc.bAlternateSetting;
-                    epFound     = true;
-                    std::cout << "Using actual values: streamIfNum=" << streamIfNum
-                              << ", streamAlt=" << streamAlt << std::endl;
-                }
-            }
+        DeviceInfo info;
+        info.busNumber     = libusb_get_bus_number(devices[i]);
+        info.deviceAddress = libusb_get_device_address(devices[i]);
+        info.location      = UsbContext::locationKey(devices[i]);
+        info.inUse         = usb->isDeviceAcquired(info.location);
+
+        // Opening a scanner another instance is streaming from would only disturb it
+        if (!info.inUse)
+        {
+            info.serialNumber = readSerialNumber(devices[i]);
         }
+        found.push_back(info);
     }
 
-    std::cout << "Interface scanning complete. epFound=" << epFound
-              << ", streamIfNum=" << streamIfNum << ", streamAlt=" << streamAlt << std::endl;
+    libusb_free_device_list(devices, 1);
+    return found;
+}
 
-    if (!epFound)
-    {
-        std::cout << "Could not locate BULK IN endpoint 0x" << std::hex << BULK_EP_IN << std::dec
-                  << std::endl;
-        handleError(Error::USB_ERROR,
-                    "Could not locate BULK IN endpoint 0x" + std::to_string(BULK_EP_IN) +
-                        " in active config");
-        libusb_free_config_descriptor(cfg);
-        return Error::USB_ERROR;
-    }
+void Knokke::loadFrameModes()
+{
+    const std::vector<uint8_t> descriptors = m_transport->streamingDescriptors();
 
-    // Try to claim both interfaces since we don't know which one is correct
-    std::cout << "Trying to claim interface 0..." << std::endl;
-    int result = libusb_claim_interface(m_deviceHandle, 0);
-    if (result < 0)
+    std::vector<FrameMode> modes =
+        parseFrameModes(descriptors.data(), static_cast<int>(descriptors.size()));
+    std::cout << "Found " << modes.size() << " frame modes" << std::endl;
+    for (const FrameMode &mode : modes)
     {
-        std::cout << "Failed to claim interface 0: " << libusb_error_name(result) << std::endl;
+        std::cout << "  format " << (int)mode.formatIndex << " frame " << (int)mode.frameIndex
+                  << ": " << mode.width << "x" << mode.height << " @ " << mode.frameRate()
+                  << " fps, " << (int)mode.bitsPerPixel << " bpp" << std::endl;
     }
-    else
+    if (modes.empty())
     {
-        std::cout << "Successfully claimed interface 0" << std::endl;
+        modes.push_back(defaultFrameMode());
     }
 
-    std::cout << "Trying to claim interface 1..." << std::endl;
-    result = libusb_claim_interface(m_deviceHandle, 1);
-    if (result < 0)
+    // Keep the selected mode across reconnects when the device still offers it, otherwise
+    // prefer the default mode and fall back to the first one listed
+    FrameMode selected = modes.front();
+    for (const FrameMode &mode : modes)
     {
-        std::cout << "Failed to claim interface 1: " << libusb_error_name(result) << std::endl;
+        if (mode == m_frameMode)
+        {
+            selected = mode;
+            break;
+        }
+        if (mode == defaultFrameMode())
+        {
+            selected = mode;
+        }
     }
-    else
     {
-        std::cout << "Successfully claimed interface 1" << std::endl;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_frameModes = modes;
     }
+    applyFrameMode(selected);
+}
 
-    // Also try the corrupted interface numbers
-    std::cout << "Trying to claim interface 16..." << std::endl;
-    result = libusb_claim_interface(m_deviceHandle, 16);
-    if (result < 0)
-    {
-        std::cout << "Failed to claim interface 16: " << libusb_error_name(result) << std::endl;
-    }
-    else
-    {
-        std::cout << "Successfully claimed interface 16" << std::endl;
-    }
+Knokke::Error Knokke::getLatestFrame(uint8_t *frameData, size_t frameSize)
+{
+    FrameLease latest = leaseLatestFrame();
 
-    std::cout << "Trying to claim interface 17..." << std::endl;
-    result = libusb_claim_interface(m_deviceHandle, 17);
-    if (result < 0)
-    {
-        std::cout << "Failed to claim interface 17: " << libusb_error_name(result) << std::endl;
-    }
-    else
+    if (!latest)
     {
-        std::cout << "Successfully claimed interface 17" << std::endl;
+        return Error::CONTROL_TRANSFER_FAILED;
     }
 
-    if (streamAlt > 0)
+    // Only return complete frames
+    if (latest.size() != frameSize)
     {
-        result = libusb_set_interface_alt_setting(m_deviceHandle, streamIfNum, streamAlt);
-        if (result < 0)
-        {
-            handleError(Error::USB_ERROR,
-                        "Failed to set alternate setting: " +
-                            std::string(libusb_error_name(result)));
-            libusb_free_config_descriptor(cfg);
-            return Error::USB_ERROR;
-        }
+        return Error::CONTROL_TRANSFER_FAILED;
     }
 
-    libusb_free_config_descriptor(cfg);
-    std::cout << "claimInterfaces() completed successfully!" << std::endl;
+    std::memcpy(frameData, latest.data(), frameSize);
     return Error::SUCCESS;
 }
 
-void Knokke::releaseInterfaces()
+FrameLease Knokke::leaseLatestFrame()
 {
-    if (m_deviceHandle)
-    {
-        // Release all interfaces
-        for (int i = 0; i < 8; ++i)
-        { // Check first 8 interfaces
-            libusb_release_interface(m_deviceHandle, i);
-        }
-    }
+    std::lock_guard<std::mutex> lock(m_latestReaderMutex);
+
+    // Swap in the newest frame if one was published since the last read
+    m_latestFrame.update();
+    return m_latestFrame.front();
 }
 
-Knokke::Error Knokke::getLatestFrame(uint8_t *frameData, size_t frameSize)
+Knokke::Error Knokke::waitForFrame(uint64_t afterFrameNumber, FrameLease &frame, int timeoutMs)
 {
-    std::lock_guard<std::mutex> lock(m_latestFrameMutex);
-
-    if (m_latestFrame.empty())
+    if (timeoutMs < 0)
     {
-        return Error::CONTROL_TRANSFER_FAILED;
+        return Error::INVALID_PARAMETER;
     }
 
-    // Only return complete frames
-    if (m_latestFrame.size() != frameSize)
+    // Published numbers are offset by one so that 0 means nothing has been published
+    const uint64_t seen = afterFrameNumber == NO_FRAME ? 0 : afterFrameNumber + 1;
+    bool           newer;
     {
-        return Error::CONTROL_TRANSFER_FAILED;
+        std::unique_lock<std::mutex> lock(m_frameWaitMutex);
+        const uint64_t               stops = m_streamStops;
+
+        ++m_frameWaiters;
+        newer = m_frameWaitCondition.wait_for(lock,
+                                              std::chrono::milliseconds(timeoutMs),
+                                              [this, seen, stops] {
+                                                  return m_latestFrameNumber > seen ||
+                                                         m_streamStops != stops;
+                                              }) &&
+                m_latestFrameNumber > seen;
+        --m_frameWaiters;
+
+        if (!newer && m_streamStops != stops)
+        {
+            return Error::STREAMING_NOT_STARTED;
+        }
+    }
+    if (!newer)
+    {
+        return Error::TIMEOUT;
     }
 
-    std::memcpy(frameData, m_latestFrame.data(), frameSize);
-    return Error::SUCCESS;
+    frame = leaseLatestFrame();
+    return frame ? Error::SUCCESS : Error::TIMEOUT;
+}
+
+size_t Knokke::getFramePoolAvailable() const { return m_framePool ? m_framePool->available() : 0; }
+
+uint64_t Knokke::getFramePoolExhaustedCount() const
+{
+    return m_framePool ? m_framePool->exhaustedCount() : 0;
 }
@@ -1,14 +1,28 @@
 #ifndef KNOKKE_H
 #define KNOKKE_H
 
+#include "CaptureJournal.h"
+#include "ControlQueue.h"
+#include "DeviceClock.h"
+#include "FrameAssembler.h"
+#include "FrameBus.h"
+#include "FramePool.h"
+#include "KnokkeTransport.h"
+#include "LatencyHistogram.h"
+#include "TripleBuffer.h"
+#include "UsbContext.h"
+#include "UvcDescriptors.h"
+
 #include <atomic>
 #include <condition_variable>
 #include <functional>
+#include <future>
 #include <libusb-1.0/libusb.h>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 
 /**
@@ -64,11 +78,36 @@ class Knokke
     // USB Endpoints
     static constexpr uint8_t BULK_EP_IN = 0x83; // CX3_EP_BULK_VIDEO
 
-    // Frame parameters
-    static constexpr int FRAME_WIDTH  = 3840;
-    static constexpr int FRAME_HEIGHT = 12;
-    static constexpr int FRAME_BYTES  = FRAME_WIDTH * FRAME_HEIGHT * 2; // RAW16 format
-    static constexpr int FRAME_RATE   = 400;                            // fps
+    // Frame mode used until the device's streaming descriptors have been read, and whenever
+    // they describe nothing usable (3840x12 RAW16 at 400 fps)
+    static constexpr uint8_t  DEFAULT_FORMAT_INDEX   = 1;
+    static constexpr uint8_t  DEFAULT_FRAME_INDEX    = 2;
+    static constexpr uint16_t DEFAULT_FRAME_WIDTH    = 3840;
+    static constexpr uint16_t DEFAULT_FRAME_HEIGHT   = 12;
+    static constexpr uint8_t  DEFAULT_BITS_PER_PIXEL = 16;
+    static constexpr uint32_t DEFAULT_FRAME_INTERVAL = 25000; // 100 ns units
+
+    // Streaming transfer parameters
+    static constexpr int STREAM_TRANSFER_BYTES        = 100 * 1024;  // Until negotiated
+    static constexpr int MAX_TRANSFER_BYTES           = 1024 * 1024; // Largest bulk transfer
+    static constexpr int DEFAULT_BULK_PACKET_BYTES    = 512; // USB 2.0 high-speed bulk packet
+    static constexpr int DEFAULT_TRANSFER_QUEUE_DEPTH = 8;   // Minimum transfers kept in flight
+    static constexpr int MAX_TRANSFER_QUEUE_DEPTH     = 64;
+    static constexpr int DEFAULT_AUTOTUNE_MS          = 500; // Measurement time per setting
+
+    // Device list polling interval used when libusb hotplug is unavailable
+    static constexpr int DEFAULT_HOTPLUG_POLL_MS = 250;
+
+    // Number of frame buffers owned by the driver's frame pool
+    static constexpr int FRAME_POOL_SIZE = 32;
+
+    // In-stream recovery from bulk errors, see setRecoveryTimeout()
+    static constexpr int DEFAULT_RECOVERY_TIMEOUT_MS = 5000;
+    static constexpr int RECOVERY_BACKOFF_MS         = 10;  // First wait between attempts
+    static constexpr int MAX_RECOVERY_BACKOFF_MS     = 500; // Waits double up to this
+
+    // waitForFrame() argument for a caller that has not seen any frame yet
+    static constexpr uint64_t NO_FRAME = UINT64_MAX;
 
     // Error codes
     enum class Error
@@ -83,14 +122,39 @@ class Knokke
         THREAD_CREATION_FAILED,
         INVALID_PARAMETER,
         USB_ERROR,
+        BUFFER_POOL_EXHAUSTED,
+        FILE_ERROR,
+        TIMEOUT,
+        NEGOTIATION_FAILED,
+        STREAM_LOST,
         UNKNOWN_ERROR
     };
 
+    // Streaming capture modes
+    enum class CaptureMode
+    {
+        SYNCHRONOUS,  // One blocking libusb_bulk_transfer at a time on the capture thread
+        ASYNCHRONOUS  // Queue of libusb_submit_transfer requests serviced by an event thread
+    };
+
     // Callback function types
     using FrameCallback =
         std::function<void(const uint8_t *frameData, size_t frameSize, uint64_t frameNumber)>;
+    using FrameInfoCallback =
+        std::function<void(const uint8_t *frameData, const FrameInfo &frameInfo)>;
     using ErrorCallback = std::function<void(Error error, const std::string &message)>;
 
+    // Device arrival and departure notifications
+    enum class HotplugEvent
+    {
+        DEVICE_ARRIVED,
+        DEVICE_LEFT
+    };
+    using HotplugCallback = std::function<void(HotplugEvent event)>;
+
+    // Result of a queued parameter write
+    using ControlFuture = std::shared_future<Error>;
+
     // Parameter structures
     struct BacklightParams
     {
@@ -108,11 +172,78 @@ class Knokke
         bool            enter_bootloader = false;
     };
 
+    // An attached scanner, as reported by enumerateDevices()
+    struct DeviceInfo
+    {
+        uint8_t     busNumber     = 0;
+        uint8_t     deviceAddress = 0;     // Changes every time the scanner is plugged in
+        std::string location;              // Bus and port path, e.g. "1-2.3"
+        std::string serialNumber;          // Empty if the device could not be queried
+        bool        inUse         = false; // Opened by another Knokke in this process
+    };
+
+    // Outcome of one frame of captureBatch()
+    struct BatchFrameStatus
+    {
+        Error     status = Error::UNKNOWN_ERROR; // SUCCESS once the frame is in the buffer
+        FrameInfo info;                          // gapCount: frames lost since the previous one
+    };
+
+    // Opt-in real-time streaming, see setRealtimeOptions()
+    struct RealtimeOptions
+    {
+        bool enabled    = false;
+        int  priority   = 50;   // SCHED_FIFO priority of the streaming threads, 1-99
+        int  captureCpu = -1;   // Core for synchronous reads, -1 leaves it unpinned
+        int  eventCpu   = -1;   // Core for the shared USB event thread, -1 leaves it unpinned
+        bool lockMemory = true; // Lock transfer buffers and the frame pool into RAM
+    };
+
+    // What startStreaming() managed to apply of the real-time options, complete once it returns
+    struct RealtimeStatus
+    {
+        bool        priority     = false; // The capture path's thread runs in the real-time class
+        bool        affinity     = false; // It runs on the core set for the capture mode in use
+        bool        memoryLocked = false; // Transfer buffers and frame pool are locked
+        std::string message;              // What could not be applied and why
+    };
+
+    // Snapshot of the streaming counters, see getStreamStats()
+    struct StreamStats
+    {
+        double   elapsedSeconds   = 0; // Streamed since startStreaming(), pauses excluded
+        double   framesPerSecond  = 0; // Complete frames over elapsedSeconds
+        double   bytesPerSecond   = 0; // Bulk bytes over elapsedSeconds
+        uint64_t bytesReceived    = 0; // Bulk bytes, payload headers included
+        uint64_t completeFrames   = 0; // Assembled in full, whether delivered or dropped
+        uint64_t incompleteFrames = 0; // Discarded as short, overflowing or missing their EOF
+        uint64_t droppedFrames    = 0; // Complete but dropped because the frame pool was empty
+        uint64_t lostFrames       = 0; // As getLostFrameCount()
+        uint64_t bulkTimeouts     = 0; // Bulk reads that timed out
+        uint64_t bulkErrors       = 0; // Bulk reads that failed outright
+        uint64_t recoveries       = 0; // Bulk errors the stream recovered from in place
+        uint64_t recoveryFailures = 0; // Bulk errors it could not recover from
+
+        LatencyHistogram::Snapshot controlLatency; // Round trip of each control transfer
+        LatencyHistogram::Snapshot callbackTime;   // Frame and frame-info callbacks per frame
+        LatencyHistogram::Snapshot recoveryTime;   // From the bulk error to streaming again
+    };
+
     /**
      * @brief Constructor
+     *
+     * The instance talks to a USB scanner: the first free one found by connect(), or the one
+     * passed to connect(const DeviceInfo &). All instances in a process share one libusb
+     * context and each streams on its own threads.
      */
     Knokke();
 
+    /**
+     * @brief Construct an instance bound to a specific transport, e.g. a simulated scanner
+     * @param transport Transport opened by connect() and closed by disconnect()
+     */
+    explicit Knokke(std::unique_ptr<KnokkeTransport> transport);
+
     /**
      * @brief Destructor
      */
@@ -124,12 +255,32 @@ class Knokke
      */
     Error initialize();
 
+    /**
+     * @brief List every attached scanner
+     *
+     * Serial numbers are read by briefly opening each scanner that is not already open in
+     * this process.
+     * @return Attached scanners in bus order
+     */
+    static std::vector<DeviceInfo> enumerateDevices();
+
     /**
      * @brief Connect to the scanner device
+     *
+     * Reconnects to the scanner chosen with connect(const DeviceInfo &) if there was one,
+     * otherwise opens the first scanner not already in use by this process.
      * @return Error code indicating success or failure
      */
     Error connect();
 
+    /**
+     * @brief Connect to a particular scanner
+     * @param device Scanner from enumerateDevices(); matched by serial number when it has one,
+     * otherwise by port, so the choice survives replugging
+     * @return Error code indicating success or failure
+     */
+    Error connect(const DeviceInfo &device);
+
     /**
      * @brief Disconnect from the scanner device
      */
@@ -141,14 +292,56 @@ class Knokke
      */
     bool isConnected() const;
 
+    // Device detection
+
+    /**
+     * @brief Watch for the scanner being plugged in or removed
+     *
+     * Uses libusb hotplug notifications where the platform supports them and otherwise polls
+     * the device list (without opening anything) every pollIntervalMs. A scanner that is
+     * already present is reported as DEVICE_ARRIVED straight away. The callback runs on the
+     * USB event thread every instance shares, or on the polling thread, and must not call back
+     * into this object; post the event to the thread that owns it instead, and return quickly
+     * since streams wait behind it. With a transport given at construction the arrival is
+     * reported once, on the calling thread, and nothing is monitored.
+     * @param callback Function to call on every arrival or departure
+     * @param pollIntervalMs Device list polling interval when hotplug is unsupported
+     * @return Error code indicating success or failure
+     */
+    Error startHotplugMonitor(HotplugCallback callback,
+                              int             pollIntervalMs = DEFAULT_HOTPLUG_POLL_MS);
+
+    /**
+     * @brief Stop watching for device arrival and departure
+     */
+    void stopHotplugMonitor();
+
+    /**
+     * @brief Check whether the monitor is using libusb hotplug notifications
+     * @return true for hotplug notifications, false while polling or not monitoring
+     */
+    bool isHotplugActive() const;
+
+    /**
+     * @brief Check whether a scanner is attached, without opening it
+     * @return true if this instance's scanner is on the bus; while disconnected, a scanner
+     * connect() could open
+     */
+    bool isDevicePresent();
+
     // Parameter control methods
+    //
+    // The driver keeps a shadow copy of every control it has read or written. Getters answer
+    // from it unless refresh is set, and setters skip the transfer when the device already
+    // holds the requested value.
 
     /**
      * @brief Get current exposure time
      * @param exposureTime Output parameter for exposure time in microseconds
+     * @param refresh true to read the device instead of the shadow copy
      * @return Error code indicating success or failure
      */
-    Error getExposureTime(uint32_t &exposureTime);
+    Error getExposureTime(uint32_t &exposureTime, bool refresh = false);
 
     /**
      * @brief Set exposure time
@@ -160,9 +353,10 @@ class Knokke
     /**
      * @brief Get current gain
      * @param gain Output parameter for gain (gain_db * 100)
+     * @param refresh true to read the device instead of the shadow copy
      * @return Error code indicating success or failure
      */
-    Error getGain(uint16_t &gain);
+    Error getGain(uint16_t &gain, bool refresh = false);
 
     /**
      * @brief Set gain
@@ -174,9 +368,10 @@ class Knokke
     /**
      * @brief Get current backlight parameters
      * @param backlight Output parameter for backlight values
+     * @param refresh true to read the device instead of the shadow copy
      * @return Error code indicating success or failure
      */
-    Error getBacklight(BacklightParams &backlight);
+    Error getBacklight(BacklightParams &backlight, bool refresh = false);
 
     /**
      * @brief Set backlight parameters
@@ -196,9 +391,10 @@ class Knokke
     /**
      * @brief Get current motor speed
      * @param speed Output parameter for motor speed in steps/s
+     * @param refresh true to read the device instead of the shadow copy
      * @return Error code indicating success or failure
      */
-    Error getMotorSpeed(int32_t &speed);
+    Error getMotorSpeed(int32_t &speed, bool refresh = false);
 
     /**
      * @brief Set motor speed
@@ -210,21 +406,93 @@ class Knokke
     /**
      * @brief Get all scanner parameters
      * @param params Output parameter for all scanner parameters
+     * @param refresh true to read the device instead of the shadow copy
      * @return Error code indicating success or failure
      */
-    Error getParameters(ScannerParams &params);
+    Error getParameters(ScannerParams &params, bool refresh = false);
 
     /**
      * @brief Set all scanner parameters
+     *
+     * Only controls whose value differs from the shadow copy are written.
      * @param params Scanner parameters to set
      * @return Error code indicating success or failure
      */
     Error setParameters(const ScannerParams &params);
 
+    /**
+     * @brief Forget the shadow copy so the next access to every control goes to the device
+     *
+     * Use after anything outside this driver may have changed the device state.
+     */
+    void invalidateParameterCache();
+
+    /**
+     * @brief Get the number of control transfers issued since construction
+     * @return Control transfer count
+     */
+    uint64_t getControlTransferCount() const;
+
+    /**
+     * @brief Get the current parameter generation
+     *
+     * Every exposure, gain or backlight write that reaches the device starts a new generation.
+     * Streamed frames report the generation they were exposed with in
+     * FrameInfo::parameterGeneration, and the first frame of that generation in
+     * FrameInfo::generationStartFrame, so transitional frames can be dropped exactly.
+     * @return Generation of the most recent parameter write
+     */
+    uint64_t getParameterGeneration() const;
+
+    // Asynchronous parameter control
+    //
+    // These queue the write on the driver's control thread and return immediately. While a
+    // write to a control is still waiting, a newer write to the same control replaces it, so
+    // only the latest value reaches the device and both callers get the same future. Failures
+    // are also reported through the error callback.
+
+    /**
+     * @brief Queue an exposure time write
+     * @param exposureTime Exposure time in microseconds
+     * @return Future resolved once the latest queued exposure time has been written
+     */
+    ControlFuture setExposureTimeAsync(uint32_t exposureTime);
+
+    /**
+     * @brief Queue a gain write
+     * @param gain Gain value (gain_db * 100)
+     * @return Future resolved once the latest queued gain has been written
+     */
+    ControlFuture setGainAsync(uint16_t gain);
+
+    /**
+     * @brief Queue a backlight write
+     * @param backlight Backlight parameters (RGB values 0-65535)
+     * @return Future resolved once the latest queued backlight values have been written
+     */
+    ControlFuture setBacklightAsync(const BacklightParams &backlight);
+
+    /**
+     * @brief Queue a motor speed write
+     * @param speed Motor speed in steps/s (can be negative for reverse)
+     * @return Future resolved once the latest queued motor speed has been written
+     */
+    ControlFuture setMotorSpeedAsync(int32_t speed);
+
+    /**
+     * @brief Get the number of queued parameter writes not yet sent
+     * @return Pending write count
+     */
+    size_t getPendingControlCount() const;
+
     // Video streaming methods
 
     /**
      * @brief Start video streaming
+     *
+     * Probes and commits the stream and wakes the capture engine. The engine thread and its
+     * transfer buffers are created on the first start after connect() and kept until
+     * disconnect(), so later starts only pay for the probe/commit.
      * @return Error code indicating success or failure
      */
     Error startStreaming();
@@ -237,18 +505,289 @@ class Knokke
 
     /**
      * @brief Check if streaming is active
-     * @return true if streaming, false otherwise
+     * @return true if streaming (paused or not), false otherwise
      */
     bool isStreaming() const;
 
+    /**
+     * @brief Stop reading from the device without tearing the stream down
+     *
+     * The capture engine parks with its buffers allocated and the committed stream settings
+     * left in place. Returns once no more frames will be delivered; the frame being assembled
+     * is dropped.
+     * @return Error code indicating success or failure
+     */
+    Error pauseStreaming();
+
+    /**
+     * @brief Continue a paused stream
+     *
+     * Wakes the parked engine without a probe/commit or new threads, so the first frame
+     * arrives within about one frame period. Frames the device sent while paused are not
+     * counted as lost.
+     * @return Error code indicating success or failure
+     */
+    Error resumeStreaming();
+
+    /**
+     * @brief Check if streaming is paused
+     * @return true between pauseStreaming() and resumeStreaming() or stopStreaming()
+     */
+    bool isPaused() const;
+
+    /**
+     * @brief Set how long a running stream tries to recover from a bulk transfer error
+     *
+     * On a stall or pipe error the streaming thread clears the endpoint halt, probes and
+     * commits the stream again and restores the parameters held in the shadow copy; if that
+     * fails, or the device went away, it also releases and re-claims the interface. Attempts
+     * repeat with growing back-off until the timeout. Consumers stay attached throughout:
+     * callbacks, subscriptions, batches and recordings simply continue, and the frame cut off
+     * by the error is counted in the next frame's gapCount. Each recovery and its duration is
+     * logged and counted in getStreamStats(); the error, and a failed recovery, also go to the
+     * error callback.
+     *
+     * A stream that cannot be recovered stops by itself: isStreaming() turns false, waiting
+     * callers return and the error callback gets STREAM_LOST. With the timeout at 0 a
+     * synchronous stream keeps reading after reporting the error; an asynchronous one has no
+     * transfers left queued and stops the same way.
+     * @param timeoutMs Time to keep trying, 0 to only report the error as before
+     * @return Error code indicating success or failure
+     */
+    Error setRecoveryTimeout(int timeoutMs);
+
+    /**
+     * @brief Get the modes the device offers
+     *
+     * Read from the video streaming descriptors on connect; only the default mode is listed
+     * before the first connect or when the device describes none.
+     * @return Available frame modes in descriptor order
+     */
+    std::vector<FrameMode> getFrameModes() const;
+
+    /**
+     * @brief Get the mode streaming and captures use
+     * @return Selected frame mode
+     */
+    FrameMode getFrameMode() const;
+
+    /**
+     * @brief Select the mode for the next stream, e.g. fewer lines at a higher rate for a
+     * prescan; frame buffers are resized to match
+     * @param mode One of the modes returned by getFrameModes()
+     * @return Error code indicating success or failure
+     */
+    Error setFrameMode(const FrameMode &mode);
+
+    /**
+     * @brief Select how the bulk endpoint is read while streaming
+     * @param mode Capture mode (takes effect on the next startStreaming())
+     * @return Error code indicating success or failure
+     */
+    Error setCaptureMode(CaptureMode mode);
+
+    /**
+     * @brief Get the configured capture mode
+     * @return Capture mode used by startStreaming()
+     */
+    CaptureMode getCaptureMode() const;
+
+    /**
+     * @brief Set the number of bulk transfers kept in flight in asynchronous mode
+     *
+     * By default the depth is derived from the negotiated frame and payload sizes when
+     * streaming starts; setting it explicitly turns that off.
+     * @param depth Number of transfers (1 to MAX_TRANSFER_QUEUE_DEPTH)
+     * @return Error code indicating success or failure
+     */
+    Error setTransferQueueDepth(int depth);
+
+    /**
+     * @brief Get the number of bulk transfers kept in flight in asynchronous mode
+     * @return Transfer queue depth
+     */
+    int getTransferQueueDepth() const;
+
+    /**
+     * @brief Set the size of each bulk transfer request
+     * @param bytes Transfer size, or 0 to size transfers from the negotiated
+     * dwMaxPayloadTransferSize when streaming starts (the default)
+     * @return Error code indicating success or failure
+     */
+    Error setTransferSize(int bytes);
+
+    /**
+     * @brief Get the size of each bulk transfer request
+     * @return Transfer size in bytes
+     */
+    int getTransferSize() const;
+
+    /**
+     * @brief Get the maximum frame size the device committed to
+     * @return dwMaxVideoFrameSize in bytes, 0 before streaming has been started
+     */
+    uint32_t getMaxVideoFrameSize() const;
+
+    /**
+     * @brief Get the maximum payload size the device committed to
+     * @return dwMaxPayloadTransferSize in bytes, 0 before streaming has been started
+     */
+    uint32_t getMaxPayloadTransferSize() const;
+
+    /**
+     * @brief Measure streaming throughput across transfer sizes and keep the best one
+     *
+     * Streams for measureMs at each power-of-two multiple of the negotiated transfer size up
+     * to MAX_TRANSFER_BYTES and keeps the size that delivered the most complete frames. With
+     * automatic sizing (setTransferSize(0)) the winning multiple is kept, so it carries over to
+     * other frame modes; a fixed size is replaced by the winning size. Must be called while
+     * connected and not streaming; takes a few seconds.
+     * @param measureMs Measurement time per transfer size
+     * @return Error code indicating success or failure
+     */
+    Error autotuneTransferSize(int measureMs = DEFAULT_AUTOTUNE_MS);
+
+    /**
+     * @brief Allocate streaming transfer buffers from kernel-mapped device memory
+     *
+     * When enabled and supported (Linux usbfs, libusb >= 1.0.21, built with KNOKKE_USE_DEV_MEM)
+     * transfer buffers come from libusb_dev_mem_alloc() so the controller DMAs straight into
+     * them. Otherwise ordinary heap buffers are used.
+     * @param enable true to request device memory buffers (takes effect on the next
+     * startStreaming())
+     * @return Error code indicating success or failure
+     */
+    Error setZeroCopyBuffers(bool enable);
+
+    /**
+     * @brief Check whether the current streaming buffers are kernel-mapped device memory
+     * @return true if every active transfer buffer came from libusb_dev_mem_alloc()
+     */
+    bool isUsingZeroCopyBuffers() const;
+
+    /**
+     * @brief Configure the real-time streaming mode
+     *
+     * When enabled, streaming starts by pinning the thread that runs the capture path to a core
+     * and switching it to SCHED_FIFO: the capture engine on captureCpu in synchronous mode, the
+     * USB event thread on eventCpu in asynchronous mode. That event thread handles the
+     * transfers of every instance in the process and keeps the settings of the last stream that
+     * asked for them. The frame pool and every transfer buffer are faulted in and locked into
+     * RAM for as long as streaming runs. Whatever the process lacks the privileges for is
+     * skipped, logged and reported through getRealtimeStatus(); streaming starts regardless.
+     * @param options Real-time options (take effect on the next startStreaming())
+     * @return Error code indicating success or failure
+     */
+    Error setRealtimeOptions(const RealtimeOptions &options);
+
+    /**
+     * @brief Get the real-time streaming options
+     * @return Options set with setRealtimeOptions()
+     */
+    RealtimeOptions getRealtimeOptions() const;
+
+    /**
+     * @brief Get what the real-time mode achieved for the current or last stream
+     * @return Applied settings and the reasons for anything that was skipped
+     */
+    RealtimeStatus getRealtimeStatus() const;
+
     /**
      * @brief Set frame callback function
      * @param callback Function to call when a new frame is received
      */
     void setFrameCallback(FrameCallback callback);
 
+    /**
+     * @brief Set frame callback function receiving the full frame metadata
+     *
+     * Unlike FrameCallback this reports FrameInfo::gapCount, the number of frames lost since the
+     * previous delivered frame, so consumers can compensate instead of stitching across a hole.
+     * @param callback Function to call when a new frame is received
+     */
+    void setFrameInfoCallback(FrameInfoCallback callback);
+
+    /**
+     * @brief Get the total number of frames lost since the stream started
+     * @return Frames discarded as incomplete, skipped by the device or dropped by the driver
+     */
+    uint64_t getLostFrameCount() const;
+
+    /**
+     * @brief Get a snapshot of how streaming is doing
+     *
+     * Counters and histograms are always collected, with relaxed atomic updates on the capture
+     * path and no locking, and restart with every startStreaming(). Rates are taken over the
+     * time the stream actually ran: paused time does not count, and after stopStreaming() the
+     * snapshot stays as the stream ended. A snapshot taken while streaming may be a few
+     * samples out of step between fields.
+     * @return Rates, frame and transfer counters, and latency histograms since the stream started
+     */
+    StreamStats getStreamStats() const;
+
+    /**
+     * @brief Get the device clock frequency negotiated during probe/commit
+     * @return dwClockFrequency in Hz, 0 before streaming has been started
+     */
+    uint32_t getDeviceClockFrequency() const;
+
+    /**
+     * @brief Subscribe to the stream of completed frames
+     *
+     * Any number of subscribers may consume the stream at once, each on its own thread, with
+     * its own decimation factor, ring capacity and overflow policy. Frames are shared zero-copy
+     * from the driver's frame pool, so the combined capacity of all subscribers should stay well
+     * below FRAME_POOL_SIZE. Close the subscription (or drop the handle) when done.
+     * @param options Subscriber options
+     * @return Subscription handle, or nullptr if the options are invalid
+     */
+    std::shared_ptr<FrameSubscription> subscribe(const FrameSubscription::Options &options);
+
+    /**
+     * @brief Remove a subscriber added with subscribe()
+     * @param subscription Subscription handle
+     */
+    void unsubscribe(const std::shared_ptr<FrameSubscription> &subscription);
+
+    /**
+     * @brief Record every complete frame, with its metadata and the parameters it was exposed
+     * with, to a journal file
+     *
+     * Frames are copied into the journal's ring on the capture thread and written by a writer
+     * thread, so recording never stalls streaming; if the disk falls behind for longer than
+     * the ring covers, frames are dropped from the recording and counted. Read the result back
+     * with CaptureJournalReader.
+     * @param path Journal file, truncated if it exists
+     * @param compress LZ4-compress each frame (see CaptureJournal::compressionAvailable())
+     * @param bufferBytes Ring size, i.e. how much the disk may fall behind
+     * @return Error code indicating success or failure
+     */
+    Error startRecording(const std::string &path,
+                         bool               compress    = false,
+                         size_t             bufferBytes = CaptureJournal::DEFAULT_BUFFER_BYTES);
+
+    /**
+     * @brief Write out the frames still queued and close the journal
+     */
+    void stopRecording();
+
+    /**
+     * @brief Check whether frames are being recorded
+     * @return true between startRecording() and stopRecording()
+     */
+    bool isRecording() const;
+
+    /**
+     * @brief Get the counters of the current or last recording
+     * @return Journal statistics
+     */
+    CaptureJournal::Stats getRecordingStats() const;
+
     /**
      * @brief Set error callback function
+     *
+     * Errors during streaming are reported from the streaming threads. The callback must not
+     * start streaming from there; hand STREAM_LOST to another thread to restart.
      * @param callback Function to call when an error occurs
      */
     void setErrorCallback(ErrorCallback callback);
@@ -270,6 +809,41 @@ class Knokke
      */
     Error getLatestFrame(uint8_t *frameData, size_t frameSize);
 
+    /**
+     * @brief Lease the latest frame from streaming without copying it
+     *
+     * The returned handle keeps the frame buffer out of the driver's pool until it is dropped,
+     * so hold it only as long as the data is needed.
+     * @return Lease on the latest complete frame, or an invalid lease if none has arrived yet
+     */
+    FrameLease leaseLatestFrame();
+
+    /**
+     * @brief Wait for a frame newer than the one the caller already has
+     *
+     * Blocks until a frame numbered above afterFrameNumber is published, then leases the newest
+     * one without copying it; frames published in between are skipped. The capture path only
+     * takes a lock to wake callers that are actually waiting. Waiting may begin before
+     * startStreaming().
+     * @param afterFrameNumber Number of the last frame the caller has, NO_FRAME for none
+     * @param frame Output lease on the newest frame
+     * @param timeoutMs Timeout in milliseconds
+     * @return SUCCESS, TIMEOUT, or STREAMING_NOT_STARTED if streaming stopped while waiting
+     */
+    Error waitForFrame(uint64_t afterFrameNumber, FrameLease &frame, int timeoutMs = 1000);
+
+    /**
+     * @brief Get the number of frame buffers currently free in the driver's pool
+     * @return Free buffer count
+     */
+    size_t getFramePoolAvailable() const;
+
+    /**
+     * @brief Get how many times a frame was dropped because every pool buffer was leased
+     * @return Pool exhaustion count
+     */
+    uint64_t getFramePoolExhaustedCount() const;
+
     /**
      * @brief Capture multiple frames
      * @param numFrames Number of frames to capture
@@ -278,6 +852,28 @@ class Knokke
      */
     Error captureFrames(int numFrames, FrameCallback frameCallback);
 
+    /**
+     * @brief Capture consecutive frames from the running stream into one contiguous buffer
+     *
+     * Frame i is copied to buffer + i * frame size on the capture thread as soon as it is
+     * complete, starting with the first frame completed after the call. Nothing is allocated
+     * per frame and no frame of the stream is skipped on the host side: frames are captured
+     * even while the frame pool is exhausted, and frames lost on the bus show up in the
+     * statuses' gapCount. Only one batch runs at a time, further calls wait their turn.
+     * @param buffer Output buffer, e.g. the backing store of a Strip
+     * @param bufferSize Size of the buffer, at least numFrames frames of the current mode
+     * @param numFrames Number of frames to capture
+     * @param statuses Output array of numFrames entries, one per frame
+     * @param timeoutMs Maximum time for the whole batch in milliseconds
+     * @return SUCCESS if every frame was captured, otherwise the status of the first missing
+     * frame (TIMEOUT, or STREAMING_NOT_STARTED if streaming stopped)
+     */
+    Error captureBatch(uint8_t          *buffer,
+                       size_t            bufferSize,
+                       size_t            numFrames,
+                       BatchFrameStatus *statuses,
+                       int               timeoutMs = 5000);
+
     // Utility methods
 
     /**
@@ -301,28 +897,200 @@ class Knokke
 
   private:
     // Private member variables
-    libusb_context       *m_context;
-    libusb_device_handle *m_deviceHandle;
-    std::atomic<bool>     m_connected;
-    std::atomic<bool>     m_streaming;
-    std::atomic<bool>     m_threadRunning;
+    std::shared_ptr<UsbContext>      m_usb;
+    libusb_context                  *m_context;
+    std::unique_ptr<KnokkeTransport> m_transport;
+    bool                             m_fixedTransport; // Given at construction, never replaced
+    DeviceInfo                       m_selectedDevice; // Empty location: any free scanner
+    std::atomic<bool>                m_connected;
+    std::atomic<bool>                m_streaming;
+    std::atomic<bool>                m_paused;
+    std::atomic<bool>                m_threadRunning; // Engine thread lives until disconnect()
 
     // Threading
+    mutable std::mutex      m_mutex;
+    std::condition_variable m_condition;
+
+    // Capture engine: one thread per connection running the synchronous read loop or the
+    // libusb event loop, parked on m_engineCondition between streams and while paused
     std::unique_ptr<std::thread> m_captureThread;
-    std::mutex                   m_mutex;
-    std::condition_variable      m_condition;
+    std::mutex                   m_engineMutex;
+    std::condition_variable      m_engineCondition;
+    std::atomic<bool>            m_engineActive;      // Keep capturing, cleared to park
+    bool                         m_engineWake;        // Set to resume, taken by the engine
+    bool                         m_engineParked;      // Engine is waiting for m_engineWake
+    bool                         m_engineReconfigure; // Stream (re)started, apply thread options
+    bool                         m_engineConfigured;  // Engine has applied them since
+
+    // Bulk transfer buffer, either heap or kernel-mapped device memory
+    struct TransferBuffer
+    {
+        uint8_t *data         = nullptr;
+        size_t   size         = 0;
+        bool     deviceMemory = false;
+        bool     locked       = false; // Locked into RAM by the real-time mode
+    };
+
+    // Asynchronous transfer queue
+    CaptureMode                    m_captureMode;
+    int                            m_transferQueueDepth;
+    int                            m_transferBytes;     // Bytes per bulk transfer request
+    bool                           m_autoTransferBytes; // Size transfers from the payload size
+    int                            m_transferMultiple;  // Of that size, found by the autotune
+    bool                           m_autoQueueDepth;    // Size the queue from the frame size
+    uint32_t                       m_maxVideoFrameSize;      // Negotiated dwMaxVideoFrameSize
+    uint32_t                       m_maxPayloadTransferSize; // Negotiated dwMaxPayloadTransferSize
+    std::vector<libusb_transfer *> m_transfers;
+    std::vector<TransferBuffer>    m_transferBuffers;
+    TransferBuffer                 m_readBuffer; // Synchronous mode
+    std::atomic<int>               m_transfersInFlight; // Counted down under m_transferMutex
+    std::mutex                     m_transferMutex;
+    std::condition_variable        m_transferCondition; // Signalled when nothing is in flight
+    std::mutex                     m_resubmitMutex;     // Orders resubmits against cancels
+    bool                           m_zeroCopyRequested;
+    std::atomic<bool>              m_zeroCopyActive;
 
     // Callbacks
-    FrameCallback m_frameCallback;
-    ErrorCallback m_errorCallback;
+    FrameCallback     m_frameCallback;
+    FrameInfoCallback m_frameInfoCallback;
+    ErrorCallback     m_errorCallback;
 
     // Frame capture state
-    std::vector<uint8_t>  m_frameBuffer;
-    std::atomic<uint64_t> m_frameNumber;
+    std::vector<FrameMode> m_frameModes; // Read from the streaming descriptors on connect
+    FrameMode              m_frameMode;  // Fixed while streaming
+    std::vector<uint8_t>   m_frameBuffer;
+    std::vector<uint8_t>   m_streamFrame; // Scratch slot used only while the pool is exhausted
+    FrameAssembler         m_streamAssembler;
+    std::atomic<uint64_t>  m_frameNumber;
+    std::atomic<uint64_t>  m_lostFrameCount;
+    uint32_t               m_pendingGap; // Lost frames not yet reported on a delivered frame
+
+    // Device clock to host steady_clock mapping, fed from payload SCR fields
+    DeviceClock m_deviceClock;
+
+    // Frame buffer pool and the buffer currently being assembled
+    std::shared_ptr<FramePool> m_framePool;
+    FrameLease                 m_streamLease;
+    bool                       m_poolExhausted;
+
+    // Real-time streaming; options are fixed while streaming, the status is written by the
+    // capture engine as streaming starts
+    RealtimeOptions                              m_realtime;
+    RealtimeStatus                               m_realtimeStatus;
+    std::vector<std::pair<const void *, size_t>> m_lockedMemory; // Unlocked on stopStreaming()
+    mutable std::mutex                           m_realtimeMutex;
+
+    // Streaming statistics, updated with relaxed atomics from the streaming threads. The rates
+    // are over the time spent streaming unpaused, kept under m_statsTimeMutex.
+    mutable std::mutex    m_statsTimeMutex;
+    int64_t               m_statsActiveNs; // Earlier stretches of unpaused streaming
+    int64_t               m_statsStartNs;  // steady_clock start of this stretch, 0 if none
+    std::atomic<uint64_t> m_statsBytes;
+    std::atomic<uint64_t> m_statsComplete;
+    std::atomic<uint64_t> m_statsIncomplete;
+    std::atomic<uint64_t> m_statsDropped;
+    std::atomic<uint64_t> m_statsBulkTimeouts;
+    std::atomic<uint64_t> m_statsBulkErrors;
+    LatencyHistogram      m_controlLatency;
+    LatencyHistogram      m_callbackTime;
+
+    // In-stream recovery, run on the streaming thread that saw the error
+    std::atomic<int>      m_recoveryTimeoutMs;
+    std::atomic<bool>     m_recoveryPending; // Asynchronous mode: stop resubmitting, recover
+    std::atomic<int>      m_recoveryError;   // The bulk error that triggered it
+    std::atomic<uint64_t> m_statsRecoveries;
+    std::atomic<uint64_t> m_statsRecoveryFailures;
+    LatencyHistogram      m_recoveryTime;
 
-    // Latest frame storage for streaming
-    std::vector<uint8_t> m_latestFrame;
-    std::mutex           m_latestFrameMutex;
+    // Broadcast of completed frames to subscribers
+    FrameBus m_frameBus;
+
+    // Batch capture in progress, filled from the capture thread
+    struct BatchCapture
+    {
+        uint8_t          *buffer   = nullptr;
+        size_t            bytes    = 0;
+        BatchFrameStatus *statuses = nullptr;
+        size_t            count    = 0;
+        size_t            filled   = 0;
+        bool              claimed  = false; // A caller owns the batch until it has the results
+        bool              active   = false; // The capture thread is still filling it
+    };
+    BatchCapture            m_batch;
+    std::atomic<bool>       m_batchActive; // Lets the capture thread skip the lock when idle
+    std::mutex              m_batchMutex;
+    std::condition_variable m_batchCondition;
+
+    // Recording of completed frames, fed from the capture thread
+    CaptureJournal     m_journal;
+    std::atomic<bool>  m_recording;
+    mutable std::mutex m_recordingMutex; // Serialises start/stop against each other
+
+    // Device parameters, keyed for the shadow copy and the control queue
+    enum ControlKey : uint32_t
+    {
+        CONTROL_EXPOSURE,
+        CONTROL_GAIN,
+        CONTROL_BACKLIGHT,
+        CONTROL_MOTOR_SPEED,
+        CONTROL_BARRIER // Queue marker only, never a device control
+    };
+
+    // Shadow copy of the device parameters; a control is trusted only while its bit is set
+    // in m_shadowValid. m_shadowMutex guards the copy and is never held across a transfer;
+    // m_controlMutex keeps device reads and writes in order so the copy matches the last one.
+    // Both are recursive so composite setters can reuse the single-control ones.
+    ScannerParams         m_shadow;
+    uint32_t              m_shadowValid;
+    std::recursive_mutex  m_shadowMutex;
+    std::recursive_mutex  m_controlMutex;
+    std::atomic<uint64_t> m_controlTransferCount;
+
+    // Recent parameter generations and the host time each one reached the device
+    struct ParameterChange
+    {
+        uint64_t             generation = 0;
+        FrameInfo::TimePoint time;
+    };
+    static constexpr size_t PARAMETER_HISTORY = 16;
+
+    std::atomic<uint64_t> m_parameterGeneration;
+    ParameterChange       m_parameterChanges[PARAMETER_HISTORY];
+    size_t                m_parameterChangeNext;
+    mutable std::mutex    m_parameterChangeMutex;
+
+    // Generation tracking on the capture thread
+    FrameInfo::TimePoint m_frameStartTime; // First payload of the frame in progress
+    bool                 m_frameStartPending;
+    uint64_t             m_frameGeneration;
+    uint64_t             m_generationStartFrame;
+
+    // Device arrival/departure monitoring
+    std::unique_ptr<std::thread>   m_hotplugThread;
+    std::atomic<bool>              m_hotplugRunning;
+    bool                           m_hotplugRegistered;
+    libusb_hotplug_callback_handle m_hotplugHandle;
+    HotplugCallback                m_hotplugCallback;
+    int                            m_hotplugPollMs;
+    std::mutex                     m_hotplugMutex; // Also guards m_selectedDevice
+    std::condition_variable        m_hotplugCondition;
+    std::mutex                     m_hotplugDispatchMutex; // Held while a notification runs
+    std::string                    m_deviceLocation; // Port of the open scanner, under the mutex
+
+    // Parameter writes queued from the asynchronous setters
+    ControlQueue<Error> m_controlQueue;
+
+    // Latest frame publication: the capture thread publishes wait-free, readers serialise on
+    // m_latestReaderMutex only among themselves
+    TripleBuffer<FrameLease> m_latestFrame;
+    std::mutex               m_latestReaderMutex;
+
+    // waitForFrame(): the capture thread signals only while m_frameWaiters is non-zero
+    std::atomic<uint64_t>   m_latestFrameNumber; // Newest published frame number + 1, 0 for none
+    std::atomic<int>        m_frameWaiters;
+    uint64_t                m_streamStops; // stopStreaming() calls, under m_frameWaitMutex
+    std::mutex              m_frameWaitMutex;
+    std::condition_variable m_frameWaitCondition;
 
     // Private methods
     Error performControlTransfer(uint8_t  requestType,
@@ -333,12 +1101,66 @@ class Knokke
                                  uint16_t length,
                                  int      timeout = 1000);
 
+    // SET_CUR of one control, leaving the shadow copy and the parameter generation alone
+    Error writeExposureTime(uint32_t exposureTime);
+    Error writeGain(uint16_t gain);
+    Error writeBacklight(const BacklightParams &backlight);
+    Error writeMotorSpeed(int32_t speed);
+
+    bool isShadowValid(ControlKey key) const;
+    void markShadowValid(ControlKey key);
+    void updateShadow(ControlKey key, Error result);
+    void journalParameters();
+    void recordParameterChange();
+    void stampGeneration(FrameInfo &info, uint64_t frameNumber, FrameInfo::TimePoint exposureStart);
+
     Error sendProbeCommit();
+    void  configureTransfers();
+    void  applyFrameMode(const FrameMode &mode);
+    static FrameMode defaultFrameMode();
     void  captureThreadFunction();
+    void  runSynchronousCapture();
+    void  runAsynchronousCapture();
+    Error startEngine();
+    void  stopEngine();
+    Error resumeEngine(bool reconfigure);
+    void  pauseEngine();
+    bool  asynchronousCapture() const;
+    void  processPayload(const uint8_t *payload, int length);
+    void  prepareStreamSlot();
+    void  resetStreamStats();
+    void  setStatsRunning(bool running);
+    bool  recoverStream(int error);
+    void  streamLost();
+    Error recoverDevice(bool reclaim);
+    void  applyRealtimeThread(bool asynchronous);
+    bool  lockStreamMemory(const void *data, size_t bytes);
+    void  unlockStreamMemory();
+    bool  lockTransferBuffers();
+    void  realtimeFailed(bool RealtimeStatus::*applied, const std::string &reason);
+    void  deliverBatchFrame(const uint8_t *data, const FrameInfo &info, uint32_t lost);
+    void  endBatch();
+    Error prepareTransfers();
+    Error submitAsyncTransfers();
+    void  cancelAsyncTransfers();
+    void  drainAsyncTransfers();
+    void  transferFinished();
+    void  freeTransfers();
+    Error allocateTransferBuffer(TransferBuffer &buffer, size_t size);
+    void  freeTransferBuffer(TransferBuffer &buffer);
+
+    static void LIBUSB_CALL transferCallback(libusb_transfer *transfer);
+
+    void                   hotplugThreadFunction();
+    bool                   isOwnDevice(const std::string &location);
+    static int LIBUSB_CALL hotplugCallback(libusb_context      *context,
+                                           libusb_device       *device,
+                                           libusb_hotplug_event event,
+                                           void                *userData);
     void  handleError(Error error, const std::string &message);
-    bool  findDevice();
-    Error claimInterfaces();
-    void  releaseInterfaces();
+    std::unique_ptr<KnokkeTransport> findDevice();
+    void                             loadFrameModes();
+    static std::string readSerialNumber(libusb_device *device);
 };
 
 #endif // KNOKKE_H
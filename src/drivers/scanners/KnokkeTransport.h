@@ -0,0 +1,94 @@
+#ifndef KNOKKETRANSPORT_H
+#define KNOKKETRANSPORT_H
+
+#include <cstdint>
+#include <libusb-1.0/libusb.h>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The link between Knokke and one scanner
+ *
+ * Knokke drives the scanner only through this interface: control transfers for parameters and
+ * probe/commit, and bulk reads of UVC payloads. UsbTransport talks to real hardware; other
+ * implementations stand in for a scanner in tests. Calls return libusb status codes
+ * (LIBUSB_SUCCESS or a negative LIBUSB_ERROR_*) so every transport reports errors the same
+ * way. Control transfers and bulk reads may be issued from different threads at once.
+ */
+class KnokkeTransport
+{
+  public:
+    virtual ~KnokkeTransport() = default;
+
+    /**
+     * @brief Open the device and claim its video streaming interface
+     * @return LIBUSB_SUCCESS or a negative libusb error code
+     */
+    virtual int open() = 0;
+
+    /**
+     * @brief Release the interfaces and close the device; safe to call when not open
+     */
+    virtual void close() = 0;
+
+    /**
+     * @brief Perform a control transfer on the default endpoint
+     * @return Number of bytes transferred or a negative libusb error code
+     */
+    virtual int controlTransfer(uint8_t        requestType,
+                                uint8_t        request,
+                                uint16_t       value,
+                                uint16_t       index,
+                                unsigned char *data,
+                                uint16_t       length,
+                                unsigned int   timeoutMs) = 0;
+
+    /**
+     * @brief Read one bulk transfer from the video endpoint
+     * @param data Destination buffer
+     * @param length Size of the buffer
+     * @param transferred Number of bytes received, also set on timeout
+     * @param timeoutMs Timeout in milliseconds
+     * @return LIBUSB_SUCCESS or a negative libusb error code
+     */
+    virtual int
+    bulkRead(unsigned char *data, int length, int *transferred, unsigned int timeoutMs) = 0;
+
+    /**
+     * @brief Clear a halt (stall) on the video endpoint so bulk reads can resume
+     * @return LIBUSB_SUCCESS or a negative libusb error code; transports whose endpoint
+     * cannot halt have nothing to clear
+     */
+    virtual int clearHalt() { return LIBUSB_SUCCESS; }
+
+    /**
+     * @brief Class-specific descriptors of the video streaming interface, as parsed by
+     * parseFrameModes(); empty if the device does not describe its formats
+     */
+    virtual std::vector<uint8_t> streamingDescriptors() const = 0;
+
+    /**
+     * @brief wMaxPacketSize of the video endpoint, or 0 if unknown
+     */
+    virtual int maxPacketSize() const = 0;
+
+    /**
+     * @brief Human-readable description of the device for logs and getDeviceInfo()
+     */
+    virtual std::string description() const = 0;
+
+    /**
+     * @brief Bus and port path the device is attached at, as UsbContext::locationKey(); empty
+     * for transports that are not on a bus
+     */
+    virtual std::string location() const { return std::string(); }
+
+    /**
+     * @brief libusb handle for asynchronous transfers and kernel-mapped buffers
+     * @return Open handle, or nullptr if the transport is not backed by libusb; Knokke then
+     * streams with blocking bulkRead() calls on its capture thread
+     */
+    virtual libusb_device_handle *nativeHandle() const { return nullptr; }
+};
+
+#endif // KNOKKETRANSPORT_H
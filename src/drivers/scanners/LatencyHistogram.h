@@ -0,0 +1,128 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * @brief Latency distribution in power-of-two microsecond buckets
+ *
+ * Bucket 0 counts samples under 1 us and bucket k samples in [2^(k-1), 2^k) us; the last bucket
+ * takes everything longer. record() is a handful of relaxed atomic adds and never locks, so it
+ * can sit on the capture path; a snapshot taken concurrently may be off by the samples in
+ * flight but is never torn within a single counter.
+ */
+class LatencyHistogram
+{
+  public:
+    static constexpr int BUCKET_COUNT = 32;
+
+    struct Snapshot
+    {
+        uint64_t count                 = 0;
+        uint64_t totalUs               = 0;
+        uint64_t maxUs                 = 0;
+        uint64_t buckets[BUCKET_COUNT] = {};
+
+        double meanUs() const { return count ? static_cast<double>(totalUs) / count : 0.0; }
+
+        /**
+         * @brief Upper bound of the bucket holding the given percentile
+         * @param percentile 0 to 100
+         * @return Latency in microseconds that at least that share of samples stayed under
+         */
+        uint64_t percentileUs(double percentile) const
+        {
+            if (count == 0)
+            {
+                return 0;
+            }
+
+            const double target = count * percentile / 100.0;
+            uint64_t     seen   = 0;
+            for (int i = 0; i < BUCKET_COUNT - 1; ++i)
+            {
+                seen += buckets[i];
+                if (seen >= target)
+                {
+                    return i == 0 ? 1 : uint64_t(1) << i;
+                }
+            }
+            return maxUs;
+        }
+    };
+
+    LatencyHistogram() { reset(); }
+
+    LatencyHistogram(const LatencyHistogram &)            = delete;
+    LatencyHistogram &operator=(const LatencyHistogram &) = delete;
+
+    void record(std::chrono::steady_clock::duration latency)
+    {
+        const auto us = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+        recordUs(us > 0 ? static_cast<uint64_t>(us) : 0);
+    }
+
+    void recordUs(uint64_t us)
+    {
+        m_buckets[bucketFor(us)].fetch_add(1, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        m_totalUs.fetch_add(us, std::memory_order_relaxed);
+
+        uint64_t max = m_maxUs.load(std::memory_order_relaxed);
+        while (us > max && !m_maxUs.compare_exchange_weak(max, us, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    Snapshot snapshot() const
+    {
+        Snapshot snapshot;
+        for (int i = 0; i < BUCKET_COUNT; ++i)
+        {
+            snapshot.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+        }
+        snapshot.count   = m_count.load(std::memory_order_relaxed);
+        snapshot.totalUs = m_totalUs.load(std::memory_order_relaxed);
+        snapshot.maxUs   = m_maxUs.load(std::memory_order_relaxed);
+        return snapshot;
+    }
+
+    void reset()
+    {
+        for (int i = 0; i < BUCKET_COUNT; ++i)
+        {
+            m_buckets[i].store(0, std::memory_order_relaxed);
+        }
+        m_count.store(0, std::memory_order_relaxed);
+        m_totalUs.store(0, std::memory_order_relaxed);
+        m_maxUs.store(0, std::memory_order_relaxed);
+    }
+
+  private:
+    static int bucketFor(uint64_t us)
+    {
+        if (us == 0)
+        {
+            return 0;
+        }
+#if defined(__GNUC__) || defined(__clang__)
+        const int bucket = 64 - __builtin_clzll(us);
+#else
+        int bucket = 0;
+        for (uint64_t v = us; v != 0; v >>= 1)
+        {
+            ++bucket;
+        }
+#endif
+        return bucket < BUCKET_COUNT ? bucket : BUCKET_COUNT - 1;
+    }
+
+    std::atomic<uint64_t> m_buckets[BUCKET_COUNT];
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_totalUs;
+    std::atomic<uint64_t> m_maxUs;
+};
+
+#endif // LATENCYHISTOGRAM_H
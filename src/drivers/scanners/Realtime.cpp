@@ -0,0 +1,117 @@
+#include "Realtime.h"
+
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+namespace
+{
+#ifndef _WIN32
+std::string describe(const char *call, int error)
+{
+    std::string reason = std::string(call) + ": " + std::strerror(error);
+    if (error == EPERM || error == ENOMEM)
+    {
+        reason += " (missing privileges or resource limit)";
+    }
+    return reason;
+}
+#endif
+} // namespace
+
+bool Realtime::pinCurrentThread(int cpu, std::string &error)
+{
+    if (cpu < 0)
+    {
+        error = "invalid core " + std::to_string(cpu);
+        return false;
+    }
+
+#if defined(_WIN32)
+    if (cpu >= static_cast<int>(sizeof(DWORD_PTR) * 8) ||
+        !SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << cpu))
+    {
+        error = "SetThreadAffinityMask failed for core " + std::to_string(cpu);
+        return false;
+    }
+    return true;
+#elif defined(__linux__)
+    if (cpu >= CPU_SETSIZE)
+    {
+        error = "invalid core " + std::to_string(cpu);
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    const int result = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (result != 0)
+    {
+        error = describe("pthread_setaffinity_np", result);
+        return false;
+    }
+    return true;
+#else
+    error = "thread affinity is not supported on this platform";
+    return false;
+#endif
+}
+
+bool Realtime::raiseCurrentThread(int priority, std::string &error)
+{
+#ifdef _WIN32
+    (void)priority;
+    if (!SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL))
+    {
+        error = "SetThreadPriority failed";
+        return false;
+    }
+    return true;
+#else
+    sched_param param;
+    std::memset(&param, 0, sizeof(param));
+    param.sched_priority = priority;
+    const int result     = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (result != 0)
+    {
+        error = describe("pthread_setschedparam(SCHED_FIFO)", result);
+        return false;
+    }
+    return true;
+#endif
+}
+
+bool Realtime::lockMemory(const void *data, size_t bytes, std::string &error)
+{
+#ifdef _WIN32
+    if (!VirtualLock(const_cast<void *>(data), bytes))
+    {
+        error = "VirtualLock failed (working set too small)";
+        return false;
+    }
+    return true;
+#else
+    if (mlock(data, bytes) != 0)
+    {
+        error = describe("mlock", errno);
+        return false;
+    }
+    return true;
+#endif
+}
+
+void Realtime::unlockMemory(const void *data, size_t bytes)
+{
+#ifdef _WIN32
+    VirtualUnlock(const_cast<void *>(data), bytes);
+#else
+    munlock(data, bytes);
+#endif
+}
@@ -0,0 +1,49 @@
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief Platform calls behind Knokke's real-time capture mode
+ *
+ * Each call affects only the calling thread or the given memory, and reports why it failed
+ * instead of throwing: real-time scheduling and memory locking usually need privileges
+ * (CAP_SYS_NICE and RLIMIT_MEMLOCK on Linux) that a desktop session does not have, and the
+ * capture path has to keep running without them.
+ */
+class Realtime
+{
+  public:
+    /**
+     * @brief Pin the calling thread to one CPU core
+     * @param cpu Core index
+     * @param error Output reason on failure
+     * @return true if the thread now runs on that core only
+     */
+    static bool pinCurrentThread(int cpu, std::string &error);
+
+    /**
+     * @brief Move the calling thread into the real-time scheduling class
+     * @param priority SCHED_FIFO priority (1-99); Windows maps any value to time-critical
+     * @param error Output reason on failure
+     * @return true if the thread is now scheduled in real time
+     */
+    static bool raiseCurrentThread(int priority, std::string &error);
+
+    /**
+     * @brief Lock memory into RAM so the capture path never takes a page fault on it
+     * @param data Start of the memory, faulted in by the call
+     * @param bytes Length of the memory
+     * @param error Output reason on failure
+     * @return true if the memory is locked
+     */
+    static bool lockMemory(const void *data, size_t bytes, std::string &error);
+
+    /**
+     * @brief Undo lockMemory()
+     */
+    static void unlockMemory(const void *data, size_t bytes);
+};
+
+#endif // REALTIME_H
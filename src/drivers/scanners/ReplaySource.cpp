@@ -0,0 +1,119 @@
+#include "ReplaySource.h"
+
+#include "BinaryIo.h"
+
+#include <iostream>
+
+std::unique_ptr<ReplaySource> ReplaySource::openFile(const std::string &path,
+                                                     const FrameMode   &rawMode)
+{
+    auto journal = std::make_unique<JournalReplaySource>();
+    if (journal->open(path))
+    {
+        return journal;
+    }
+
+    // A journal this build cannot read must not be replayed as raw lines
+    if (CaptureJournalReader::isJournal(path))
+    {
+        std::cout << "Cannot replay journal " << path << std::endl;
+        return nullptr;
+    }
+
+    auto strip = std::make_unique<RawStripReplaySource>();
+    if (strip->open(path, rawMode))
+    {
+        return strip;
+    }
+
+    std::cout << "Nothing to replay in " << path << std::endl;
+    return nullptr;
+}
+
+bool JournalReplaySource::open(const std::string &path)
+{
+    return m_reader.open(path) && m_reader.frameCount() > 0 &&
+           m_reader.frameMode().frameBytes() > 0;
+}
+
+FrameMode JournalReplaySource::frameMode() const { return m_reader.frameMode(); }
+
+size_t JournalReplaySource::frameCount() const { return m_reader.frameCount(); }
+
+bool JournalReplaySource::readFrame(size_t index, std::vector<uint8_t> &data)
+{
+    // Frames cut short in the recording are padded so every replayed frame is whole
+    if (!m_reader.readFrame(index, data, m_info))
+    {
+        return false;
+    }
+    data.resize(m_reader.frameMode().frameBytes(), 0);
+    return true;
+}
+
+RawStripReplaySource::RawStripReplaySource() : m_file(nullptr), m_frameCount(0) {}
+
+RawStripReplaySource::~RawStripReplaySource()
+{
+    if (m_file)
+    {
+        std::fclose(m_file);
+    }
+}
+
+bool RawStripReplaySource::open(const std::string &path, const FrameMode &mode)
+{
+    if (m_file || mode.frameBytes() == 0)
+    {
+        return false;
+    }
+
+    m_file = std::fopen(path.c_str(), "rb");
+    if (!m_file)
+    {
+        return false;
+    }
+
+    m_mode       = mode;
+    m_frameCount = static_cast<size_t>(fileSize(m_file) / mode.frameBytes());
+    return m_frameCount > 0;
+}
+
+FrameMode RawStripReplaySource::frameMode() const { return m_mode; }
+
+size_t RawStripReplaySource::frameCount() const { return m_frameCount; }
+
+bool RawStripReplaySource::readFrame(size_t index, std::vector<uint8_t> &data)
+{
+    if (index >= m_frameCount)
+    {
+        return false;
+    }
+
+    const size_t   frameBytes = m_mode.frameBytes();
+    const uint64_t offset     = static_cast<uint64_t>(index) * frameBytes;
+
+    data.resize(frameBytes);
+    return seekTo(m_file, offset) && std::fread(data.data(), 1, frameBytes, m_file) == frameBytes;
+}
+
+MemoryReplaySource::MemoryReplaySource(const FrameMode                  &mode,
+                                       std::vector<std::vector<uint8_t>> frames)
+    : m_mode(mode), m_frames(std::move(frames))
+{
+}
+
+FrameMode MemoryReplaySource::frameMode() const { return m_mode; }
+
+size_t MemoryReplaySource::frameCount() const { return m_frames.size(); }
+
+bool MemoryReplaySource::readFrame(size_t index, std::vector<uint8_t> &data)
+{
+    if (index >= m_frames.size())
+    {
+        return false;
+    }
+    data = m_frames[index];
+    data.resize(m_mode.frameBytes(), 0);
+    return true;
+}
@@ -0,0 +1,124 @@
+#ifndef REPLAYSOURCE_H
+#define REPLAYSOURCE_H
+
+#include "CaptureJournal.h"
+#include "UvcDescriptors.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Frames for ReplayTransport to play back
+ *
+ * A source holds a fixed sequence of frames in one frame mode. Frames are 16-bit little-endian
+ * mosaic data exactly as the scanner sends them. readFrame() is only called from the thread
+ * streaming the replay.
+ */
+class ReplaySource
+{
+  public:
+    virtual ~ReplaySource() = default;
+
+    /**
+     * @brief Mode the frames were captured in; its frame interval paces real-time playback
+     */
+    virtual FrameMode frameMode() const = 0;
+
+    virtual size_t frameCount() const = 0;
+
+    /**
+     * @brief Read one frame
+     * @param index Position in the source (0 to frameCount() - 1)
+     * @param data Destination, resized to frameMode().frameBytes()
+     * @return false if the frame cannot be read
+     */
+    virtual bool readFrame(size_t index, std::vector<uint8_t> &data) = 0;
+
+    /**
+     * @brief Open a capture journal or a raw strip, told apart by the journal header
+     * @param path File to replay
+     * @param rawMode Mode a raw strip is cut into frames with; journals carry their own
+     * @return Source, or nullptr if the file cannot be read
+     */
+    static std::unique_ptr<ReplaySource> openFile(const std::string &path,
+                                                  const FrameMode   &rawMode);
+};
+
+/**
+ * @brief Frames recorded with Knokke::startRecording()
+ */
+class JournalReplaySource : public ReplaySource
+{
+  public:
+    /**
+     * @brief Open a journal
+     * @return true if the journal is readable and holds at least one frame
+     */
+    bool open(const std::string &path);
+
+    FrameMode frameMode() const override;
+    size_t    frameCount() const override;
+    bool      readFrame(size_t index, std::vector<uint8_t> &data) override;
+
+  private:
+    CaptureJournalReader m_reader;
+    FrameInfo            m_info;
+};
+
+/**
+ * @brief Headerless file of 16-bit little-endian lines, cut into frames of the given mode
+ *
+ * Lines left over after the last whole frame are ignored.
+ */
+class RawStripReplaySource : public ReplaySource
+{
+  public:
+    RawStripReplaySource();
+    ~RawStripReplaySource();
+
+    RawStripReplaySource(const RawStripReplaySource &)            = delete;
+    RawStripReplaySource &operator=(const RawStripReplaySource &) = delete;
+
+    /**
+     * @brief Open a raw strip
+     * @param path Strip file
+     * @param mode Line width, lines per frame and frame interval of the replay
+     * @return true if the file holds at least one whole frame
+     */
+    bool open(const std::string &path, const FrameMode &mode);
+
+    FrameMode frameMode() const override;
+    size_t    frameCount() const override;
+    bool      readFrame(size_t index, std::vector<uint8_t> &data) override;
+
+  private:
+    std::FILE *m_file;
+    FrameMode  m_mode;
+    size_t     m_frameCount;
+};
+
+/**
+ * @brief Frames held in memory, e.g. decoded from an image strip by the application
+ */
+class MemoryReplaySource : public ReplaySource
+{
+  public:
+    /**
+     * @param mode Mode of the frames
+     * @param frames Frames of mode.frameBytes() each
+     */
+    MemoryReplaySource(const FrameMode &mode, std::vector<std::vector<uint8_t>> frames);
+
+    FrameMode frameMode() const override;
+    size_t    frameCount() const override;
+    bool      readFrame(size_t index, std::vector<uint8_t> &data) override;
+
+  private:
+    FrameMode                         m_mode;
+    std::vector<std::vector<uint8_t>> m_frames;
+};
+
+#endif // REPLAYSOURCE_H
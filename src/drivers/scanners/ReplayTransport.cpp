@@ -0,0 +1,191 @@
+#include "ReplayTransport.h"
+
+#include "BinaryIo.h"
+#include "FrameAssembler.h"
+#include "Knokke.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+constexpr int HEADER_BYTES = 2; // bHeaderLength and bmHeaderInfo only
+
+FrameMode advertisedMode(FrameMode mode)
+{
+    // Modes cut from a raw strip may come without indices; descriptors need both
+    if (mode.formatIndex == 0)
+    {
+        mode.formatIndex = 1;
+    }
+    if (mode.frameIndex == 0)
+    {
+        mode.frameIndex = 1;
+    }
+    return mode;
+}
+} // namespace
+
+ReplayTransport::ReplayTransport(std::unique_ptr<ReplaySource> source, Pacing pacing, bool loop)
+    : m_source(std::move(source)), m_mode(advertisedMode(m_source->frameMode())),
+      m_pacing(pacing), m_loop(loop), m_nextIndex(0), m_offset(0), m_frameLoaded(false),
+      m_fid(0), m_framesPlayed(0), m_finished(false)
+{
+}
+
+int ReplayTransport::open()
+{
+    // Every connect plays the source from the start
+    m_nextIndex     = 0;
+    m_offset        = 0;
+    m_frameLoaded   = false;
+    m_nextFrameTime = std::chrono::steady_clock::now();
+    m_framesPlayed  = 0;
+    m_finished      = false;
+    return LIBUSB_SUCCESS;
+}
+
+void ReplayTransport::close() {}
+
+int ReplayTransport::controlTransfer(uint8_t        requestType,
+                                     uint8_t        request,
+                                     uint16_t       value,
+                                     uint16_t       index,
+                                     unsigned char *data,
+                                     uint16_t       length,
+                                     unsigned int   timeoutMs)
+{
+    (void)timeoutMs;
+
+    std::lock_guard<std::mutex> lock(m_controlMutex);
+    std::vector<uint8_t>       &control = m_controls[std::make_pair(value, index)];
+
+    if (requestType == Knokke::UVC_REQUEST_TYPE_CLASS_OUT)
+    {
+        control.assign(data, data + length);
+
+        // Accept the probe as sent, filling in what the device decides
+        if (value == Knokke::UVC_VS_PROBE_CONTROL && index == Knokke::UVC_STREAMING_INTERFACE &&
+            control.size() >= 26)
+        {
+            writeLe(&control[18], static_cast<uint32_t>(m_mode.frameBytes()), 4);
+            writeLe(&control[22], PAYLOAD_BYTES, 4);
+        }
+        return length;
+    }
+
+    // Controls never written read as zero
+    std::memset(data, 0, length);
+    if (request == Knokke::UVC_GET_CUR)
+    {
+        std::memcpy(data, control.data(), std::min<size_t>(length, control.size()));
+    }
+    return length;
+}
+
+int ReplayTransport::bulkRead(unsigned char *data,
+                              int            length,
+                              int           *transferred,
+                              unsigned int   timeoutMs)
+{
+    *transferred = 0;
+    if (length <= HEADER_BYTES)
+    {
+        return LIBUSB_ERROR_INVALID_PARAM;
+    }
+
+    if (!m_frameLoaded && !loadFrame())
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+        return LIBUSB_ERROR_TIMEOUT;
+    }
+
+    if (m_offset == 0 && m_pacing == Pacing::REAL_TIME)
+    {
+        const auto interval = std::chrono::nanoseconds(m_mode.frameInterval * 100ull);
+        const auto now      = std::chrono::steady_clock::now();
+
+        // After a pause, e.g. between streams, pick up the schedule from now instead of bursting
+        if (now > m_nextFrameTime + interval)
+        {
+            m_nextFrameTime = now;
+        }
+        if (m_nextFrameTime - now > std::chrono::milliseconds(timeoutMs))
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+            return LIBUSB_ERROR_TIMEOUT;
+        }
+
+        std::this_thread::sleep_until(m_nextFrameTime);
+        m_nextFrameTime += interval;
+    }
+
+    const size_t image = std::min<size_t>({m_frame.size() - m_offset,
+                                           static_cast<size_t>(PAYLOAD_BYTES - HEADER_BYTES),
+                                           static_cast<size_t>(length - HEADER_BYTES)});
+    std::memcpy(data + HEADER_BYTES, m_frame.data() + m_offset, image);
+    m_offset += image;
+
+    data[0] = HEADER_BYTES;
+    data[1] = UvcPayloadHeader::UVC_HEADER_EOH | m_fid;
+    if (m_offset == m_frame.size())
+    {
+        data[1] |= UvcPayloadHeader::UVC_HEADER_EOF;
+        m_fid ^= UvcPayloadHeader::UVC_HEADER_FID;
+        m_frameLoaded = false;
+        ++m_framesPlayed;
+    }
+
+    *transferred = static_cast<int>(HEADER_BYTES + image);
+    return LIBUSB_SUCCESS;
+}
+
+std::vector<uint8_t> ReplayTransport::streamingDescriptors() const
+{
+    return buildStreamingDescriptors({m_mode});
+}
+
+int ReplayTransport::maxPacketSize() const { return Knokke::DEFAULT_BULK_PACKET_BYTES; }
+
+std::string ReplayTransport::description() const
+{
+    std::ostringstream description;
+    description << "Replay of " << m_source->frameCount() << " frames, " << m_mode.width << "x"
+                << m_mode.height << " @ " << m_mode.frameRate() << " fps"
+                << (m_pacing == Pacing::REAL_TIME ? "" : ", unpaced")
+                << (m_loop ? ", looping" : "");
+    return description.str();
+}
+
+uint64_t ReplayTransport::framesPlayed() const { return m_framesPlayed; }
+
+bool ReplayTransport::isFinished() const { return m_finished; }
+
+bool ReplayTransport::loadFrame()
+{
+    // Frames that cannot be read are skipped; give up after a full pass of them
+    const size_t count = m_source->frameCount();
+    for (size_t attempt = 0; attempt < count; ++attempt)
+    {
+        if (m_nextIndex >= count)
+        {
+            if (!m_loop)
+            {
+                break;
+            }
+            m_nextIndex = 0;
+        }
+
+        if (m_source->readFrame(m_nextIndex++, m_frame) && !m_frame.empty())
+        {
+            m_offset      = 0;
+            m_frameLoaded = true;
+            return true;
+        }
+    }
+
+    m_finished = true;
+    return false;
+}
@@ -0,0 +1,101 @@
+#ifndef REPLAYTRANSPORT_H
+#define REPLAYTRANSPORT_H
+
+#include "KnokkeTransport.h"
+#include "ReplaySource.h"
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Scanner stand-in that streams frames from a file
+ *
+ * Hands Knokke the frames of a ReplaySource as UVC payloads, so a Knokke constructed on it
+ * offers the whole streaming API (startStreaming(), callbacks, getLatestFrame(),
+ * captureFrames(), subscriptions, recording) with no scanner attached and no USB access at
+ * all. The source's frame mode is advertised through the streaming descriptors and accepted
+ * by probe/commit. Parameter writes are stored and read back like on the device but have no
+ * effect on the replayed frames.
+ */
+class ReplayTransport : public KnokkeTransport
+{
+  public:
+    enum class Pacing
+    {
+        REAL_TIME,  // One frame per frame interval of the source's mode
+        AS_FAST_AS_POSSIBLE
+    };
+
+    /**
+     * @param source Frames to play
+     * @param pacing How fast frames are delivered
+     * @param loop Start over after the last frame instead of going quiet
+     */
+    ReplayTransport(std::unique_ptr<ReplaySource> source, Pacing pacing, bool loop = false);
+
+    int  open() override;
+    void close() override;
+
+    int controlTransfer(uint8_t        requestType,
+                        uint8_t        request,
+                        uint16_t       value,
+                        uint16_t       index,
+                        unsigned char *data,
+                        uint16_t       length,
+                        unsigned int   timeoutMs) override;
+
+    /**
+     * @brief Deliver the next payload; once a non-looping replay has ended, waits out the
+     * timeout and reports LIBUSB_ERROR_TIMEOUT like an idle device
+     */
+    int bulkRead(unsigned char *data,
+                 int            length,
+                 int           *transferred,
+                 unsigned int   timeoutMs) override;
+
+    std::vector<uint8_t> streamingDescriptors() const override;
+    int                  maxPacketSize() const override;
+    std::string          description() const override;
+
+    /**
+     * @brief Number of frames fully delivered since open()
+     */
+    uint64_t framesPlayed() const;
+
+    /**
+     * @brief Whether a non-looping replay has delivered its last frame
+     */
+    bool isFinished() const;
+
+    static constexpr int PAYLOAD_BYTES = 36 * 1024; // dwMaxPayloadTransferSize of the scanner
+
+  private:
+    bool loadFrame();
+
+    std::unique_ptr<ReplaySource> m_source;
+    const FrameMode               m_mode;
+    const Pacing                  m_pacing;
+    const bool                    m_loop;
+
+    // Capture thread only
+    std::vector<uint8_t>                  m_frame;
+    size_t                                m_nextIndex; // Source frame to load next
+    size_t                                m_offset;    // Bytes of m_frame already sent
+    bool                                  m_frameLoaded;
+    uint8_t                               m_fid;
+    std::chrono::steady_clock::time_point m_nextFrameTime;
+
+    std::atomic<uint64_t> m_framesPlayed;
+    std::atomic<bool>     m_finished;
+
+    // Last value written to each control, keyed by wValue and wIndex
+    std::map<std::pair<uint16_t, uint16_t>, std::vector<uint8_t>> m_controls;
+    std::mutex                                                    m_controlMutex;
+};
+
+#endif // REPLAYTRANSPORT_H
@@ -0,0 +1,77 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+/**
+ * @brief Wait-free single-producer latest-value publication
+ *
+ * Three slots rotate between the writer (back), a hand-off position (middle) and the reader
+ * (front). publish() and update() are each a single atomic exchange, so the writer never waits
+ * for the reader and vice versa. Only one thread may publish and only one thread may read at a
+ * time; callers with several readers must serialise them among themselves.
+ */
+template <typename T> class TripleBuffer
+{
+  public:
+    TripleBuffer() : m_middle(1), m_back(0), m_front(2) {}
+
+    /**
+     * @brief Publish a new value (writer thread only)
+     * @param value Value that becomes the newest one
+     */
+    void publish(T value)
+    {
+        m_slots[m_back] = std::move(value);
+        const uint8_t previous = m_middle.exchange(m_back | FRESH, std::memory_order_acq_rel);
+        m_back                 = previous & INDEX_MASK;
+    }
+
+    /**
+     * @brief Take the newest published value, if any (reader thread only)
+     * @return true if front() changed
+     */
+    bool update()
+    {
+        if (!(m_middle.load(std::memory_order_relaxed) & FRESH))
+        {
+            return false;
+        }
+
+        const uint8_t previous = m_middle.exchange(m_front, std::memory_order_acq_rel);
+        m_front                = previous & INDEX_MASK;
+        return true;
+    }
+
+    /**
+     * @brief Value taken by the last update() (reader thread only)
+     */
+    const T &front() const { return m_slots[m_front]; }
+
+    /**
+     * @brief Drop every stored value (no publisher or reader may be active)
+     */
+    void clear()
+    {
+        for (T &slot : m_slots)
+        {
+            slot = T();
+        }
+        m_middle.store(1, std::memory_order_relaxed);
+        m_back  = 0;
+        m_front = 2;
+    }
+
+  private:
+    static constexpr uint8_t INDEX_MASK = 0x03;
+    static constexpr uint8_t FRESH      = 0x04;
+
+    T                    m_slots[3];
+    std::atomic<uint8_t> m_middle;
+    uint8_t              m_back;
+    uint8_t              m_front;
+};
+
+#endif // TRIPLEBUFFER_H
@@ -0,0 +1,163 @@
+#include "UsbContext.h"
+
+#include "Realtime.h"
+
+#include <iostream>
+#include <system_error>
+
+std::shared_ptr<UsbContext> UsbContext::shared()
+{
+    static std::mutex                creationMutex;
+    static std::weak_ptr<UsbContext> instance;
+
+    std::lock_guard<std::mutex> lock(creationMutex);
+    std::shared_ptr<UsbContext> context = instance.lock();
+    if (context)
+    {
+        return context;
+    }
+
+    libusb_context *raw    = nullptr;
+    int             result = libusb_init(&raw);
+    if (result < 0)
+    {
+        std::cout << "Failed to initialize libusb: " << libusb_error_name(result) << std::endl;
+        return nullptr;
+    }
+
+    // Set debug level to reduce verbosity
+    libusb_set_option(raw, LIBUSB_OPTION_LOG_LEVEL, LIBUSB_LOG_LEVEL_WARNING);
+
+    context.reset(new UsbContext(raw));
+    instance = context;
+    return context;
+}
+
+UsbContext::UsbContext(libusb_context *context)
+    : m_context(context), m_eventsRunning(false), m_realtimeCpu(-1), m_realtimePriority(0),
+      m_realtimeRequested(0), m_realtimeApplied(0)
+{
+}
+
+UsbContext::~UsbContext()
+{
+    // The event thread may be inside libusb, it has to be gone before the context is
+    m_eventsRunning = false;
+    if (m_eventThread.joinable())
+    {
+        wakeEvents();
+        m_eventThread.join();
+    }
+    libusb_exit(m_context);
+}
+
+libusb_context *UsbContext::get() const { return m_context; }
+
+bool UsbContext::acquireDevice(const std::string &key)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_acquired.insert(key).second;
+}
+
+void UsbContext::releaseDevice(const std::string &key)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_acquired.erase(key);
+}
+
+bool UsbContext::isDeviceAcquired(const std::string &key) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_acquired.count(key) != 0;
+}
+
+std::string UsbContext::locationKey(libusb_device *device)
+{
+    std::string key = std::to_string(libusb_get_bus_number(device));
+
+    uint8_t   ports[8];
+    const int depth = libusb_get_port_numbers(device, ports, sizeof(ports));
+    for (int i = 0; i < depth; ++i)
+    {
+        key += (i == 0 ? "-" : ".") + std::to_string(ports[i]);
+    }
+    return key;
+}
+
+bool UsbContext::startEvents()
+{
+    std::lock_guard<std::mutex> lock(m_eventMutex);
+    if (m_eventThread.joinable())
+    {
+        return true;
+    }
+
+    m_eventsRunning = true;
+    try
+    {
+        m_eventThread = std::thread(&UsbContext::eventThreadFunction, this);
+    }
+    catch (const std::system_error &)
+    {
+        m_eventsRunning = false;
+        return false;
+    }
+    return true;
+}
+
+UsbContext::RealtimeResult UsbContext::setEventRealtime(int cpu, int priority)
+{
+    std::unique_lock<std::mutex> lock(m_eventMutex);
+    if (!m_eventThread.joinable())
+    {
+        RealtimeResult result;
+        result.pinError   = cpu >= 0 ? "USB event thread is not running" : "";
+        result.raiseError = "USB event thread is not running";
+        return result;
+    }
+
+    m_realtimeCpu          = cpu;
+    m_realtimePriority     = priority;
+    const uint64_t request = ++m_realtimeRequested;
+    wakeEvents();
+    m_eventCondition.wait(lock, [this, request] { return m_realtimeApplied >= request; });
+    return m_realtimeResult;
+}
+
+void UsbContext::eventThreadFunction()
+{
+    while (m_eventsRunning)
+    {
+        applyEventRealtime();
+
+        timeval tv = {0, EVENT_TIMEOUT_US};
+        libusb_handle_events_timeout_completed(m_context, &tv, nullptr);
+    }
+}
+
+void UsbContext::applyEventRealtime()
+{
+    std::lock_guard<std::mutex> lock(m_eventMutex);
+    if (m_realtimeApplied == m_realtimeRequested)
+    {
+        return;
+    }
+
+    RealtimeResult result;
+    if (m_realtimeCpu >= 0)
+    {
+        result.pinned = Realtime::pinCurrentThread(m_realtimeCpu, result.pinError);
+    }
+    result.raised     = Realtime::raiseCurrentThread(m_realtimePriority, result.raiseError);
+    m_realtimeResult  = result;
+    m_realtimeApplied = m_realtimeRequested;
+    m_eventCondition.notify_all();
+}
+
+void UsbContext::wakeEvents()
+{
+    // Older libusb cannot interrupt the wait, the thread then notices within EVENT_TIMEOUT_US
+#if defined(LIBUSB_API_VERSION) && (LIBUSB_API_VERSION >= 0x01000105)
+    libusb_interrupt_event_handler(m_context);
+#endif
+}
@@ -0,0 +1,110 @@
+#ifndef USBCONTEXT_H
+#define USBCONTEXT_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <libusb-1.0/libusb.h>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+/**
+ * @brief One libusb context shared by every scanner in the process
+ *
+ * libusb serialises event handling per context, so instances that each open their own context
+ * work but cannot see which devices the others hold. The shared context lives while any
+ * instance holds it, and keeps track of the devices already opened through it so that two
+ * instances asking for "any scanner" end up on different ones.
+ *
+ * Its events are handled on one thread of its own: every transfer completion and hotplug
+ * notification, whichever instance it belongs to, runs there and nowhere else. Real-time
+ * settings given to that thread therefore cover all of it.
+ */
+class UsbContext
+{
+  public:
+    // Outcome of setEventRealtime()
+    struct RealtimeResult
+    {
+        bool        pinned = false; // The event thread runs on the requested core
+        bool        raised = false; // The event thread runs in the real-time class
+        std::string pinError;       // Why pinning failed, empty if it worked or was not asked
+        std::string raiseError;     // Why raising failed, empty if it worked
+    };
+
+    /**
+     * @brief Get the process-wide context, creating it on first use
+     * @return Shared context, or nullptr if libusb could not be initialised
+     */
+    static std::shared_ptr<UsbContext> shared();
+
+    ~UsbContext();
+
+    UsbContext(const UsbContext &)            = delete;
+    UsbContext &operator=(const UsbContext &) = delete;
+
+    libusb_context *get() const;
+
+    /**
+     * @brief Mark a device as opened by one of this process's instances
+     * @param key Location of the device (see locationKey())
+     * @return false if another instance already holds it
+     */
+    bool acquireDevice(const std::string &key);
+
+    void releaseDevice(const std::string &key);
+
+    bool isDeviceAcquired(const std::string &key) const;
+
+    /**
+     * @brief Stable name for the physical port a device is plugged into, e.g. "1-2.3"
+     */
+    static std::string locationKey(libusb_device *device);
+
+    /**
+     * @brief Start handling the context's events, if that is not already happening
+     *
+     * The event thread then runs until the context goes away. Nothing else may call libusb's
+     * event handling on this context; wait for the callbacks to report instead.
+     * @return false if the thread could not be created
+     */
+    bool startEvents();
+
+    /**
+     * @brief Pin the event thread to a core and move it into the real-time class
+     *
+     * Waits until the event thread has applied the settings. They stay until replaced: the
+     * thread serves every instance, so the latest settings asked for win.
+     * @param cpu Core to pin the thread to, -1 to leave its affinity alone
+     * @param priority SCHED_FIFO priority (1-99)
+     * @return What the event thread managed to apply
+     */
+    RealtimeResult setEventRealtime(int cpu, int priority);
+
+  private:
+    static constexpr long EVENT_TIMEOUT_US = 100000; // Longest wait before m_eventsRunning is seen
+
+    explicit UsbContext(libusb_context *context);
+    void eventThreadFunction();
+    void applyEventRealtime();
+    void wakeEvents();
+
+    libusb_context       *m_context;
+    mutable std::mutex    m_mutex;
+    std::set<std::string> m_acquired;
+
+    std::thread             m_eventThread;
+    std::atomic<bool>       m_eventsRunning;
+    std::mutex              m_eventMutex; // Guards m_eventThread and the real-time request
+    std::condition_variable m_eventCondition;
+    int                     m_realtimeCpu;
+    int                     m_realtimePriority;
+    uint64_t                m_realtimeRequested; // Requests made
+    uint64_t                m_realtimeApplied;   // Requests the event thread has acted on
+    RealtimeResult          m_realtimeResult;
+};
+
+#endif // USBCONTEXT_H
@@ -0,0 +1,340 @@
+#include "UsbTransport.h"
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+UsbTransport::UsbTransport(std::shared_ptr<UsbContext> context,
+                           libusb_device              *device,
+                           uint8_t                     endpoint)
+    : m_context(std::move(context)), m_device(libusb_ref_device(device)), m_handle(nullptr),
+      m_endpoint(endpoint), m_location(UsbContext::locationKey(device)), m_maxPacketSize(0)
+{
+}
+
+UsbTransport::~UsbTransport()
+{
+    close();
+    libusb_unref_device(m_device);
+}
+
+int UsbTransport::open()
+{
+    if (m_handle)
+    {
+        return LIBUSB_SUCCESS;
+    }
+
+    if (!m_context->acquireDevice(m_location))
+    {
+        std::cout << "Scanner at " << m_location << " is already open" << std::endl;
+        return LIBUSB_ERROR_BUSY;
+    }
+
+    int result = libusb_open(m_device, &m_handle);
+    if (result == LIBUSB_ERROR_NO_DEVICE && refreshDevice())
+    {
+        result = libusb_open(m_device, &m_handle);
+    }
+    if (result < 0)
+    {
+        std::cout << "Failed to open device: " << libusb_error_name(result) << std::endl;
+        m_handle = nullptr;
+        m_context->releaseDevice(m_location);
+        return result;
+    }
+    std::cout << "Successfully opened Knokke scanner at " << m_location << std::endl;
+
+    std::cout << "Calling claimInterfaces()..." << std::endl;
+    result = claimInterfaces();
+    if (result < 0)
+    {
+        std::cout << "claimInterfaces() failed with error: " << libusb_error_name(result)
+                  << std::endl;
+        close();
+        return result;
+    }
+
+    return LIBUSB_SUCCESS;
+}
+
+bool UsbTransport::refreshDevice()
+{
+    libusb_device_descriptor wanted;
+    if (libusb_get_device_descriptor(m_device, &wanted) != LIBUSB_SUCCESS)
+    {
+        return false;
+    }
+
+    libusb_device **devices;
+    const ssize_t   count = libusb_get_device_list(m_context->get(), &devices);
+    if (count < 0)
+    {
+        return false;
+    }
+
+    // The port identifies the scanner; only one device can sit on it at a time
+    bool found = false;
+    for (ssize_t i = 0; i < count && !found; ++i)
+    {
+        libusb_device_descriptor desc;
+        if (devices[i] == m_device ||
+            libusb_get_device_descriptor(devices[i], &desc) != LIBUSB_SUCCESS ||
+            desc.idVendor != wanted.idVendor || desc.idProduct != wanted.idProduct ||
+            UsbContext::locationKey(devices[i]) != m_location)
+        {
+            continue;
+        }
+        libusb_unref_device(m_device);
+        m_device = libusb_ref_device(devices[i]);
+        found    = true;
+        std::cout << "Scanner at " << m_location << " came back as a new device" << std::endl;
+    }
+
+    libusb_free_device_list(devices, 1);
+    return found;
+}
+
+void UsbTransport::close()
+{
+    if (!m_handle)
+    {
+        return;
+    }
+
+    releaseInterfaces();
+    libusb_close(m_handle);
+    m_handle = nullptr;
+    m_context->releaseDevice(m_location);
+}
+
+int UsbTransport::controlTransfer(uint8_t        requestType,
+                                  uint8_t        request,
+                                  uint16_t       value,
+                                  uint16_t       index,
+                                  unsigned char *data,
+                                  uint16_t       length,
+                                  unsigned int   timeoutMs)
+{
+    if (!m_handle)
+    {
+        return LIBUSB_ERROR_NO_DEVICE;
+    }
+    return libusb_control_transfer(
+        m_handle, requestType, request, value, index, data, length, timeoutMs);
+}
+
+int UsbTransport::bulkRead(unsigned char *data,
+                           int            length,
+                           int           *transferred,
+                           unsigned int   timeoutMs)
+{
+    if (!m_handle)
+    {
+        return LIBUSB_ERROR_NO_DEVICE;
+    }
+    return libusb_bulk_transfer(m_handle, m_endpoint, data, length, transferred, timeoutMs);
+}
+
+int UsbTransport::clearHalt()
+{
+    if (!m_handle)
+    {
+        return LIBUSB_ERROR_NO_DEVICE;
+    }
+    return libusb_clear_halt(m_handle, m_endpoint);
+}
+
+std::vector<uint8_t> UsbTransport::streamingDescriptors() const { return m_streamingDescriptors; }
+
+int UsbTransport::maxPacketSize() const { return m_maxPacketSize; }
+
+std::string UsbTransport::location() const { return m_location; }
+
+std::string UsbTransport::description() const
+{
+    libusb_device_descriptor desc;
+    if (libusb_get_device_descriptor(m_device, &desc) != LIBUSB_SUCCESS)
+    {
+        return "Knokke Film Scanner at " + m_location;
+    }
+
+    std::ostringstream oss;
+    oss << "Knokke Film Scanner (VID: 0x" << std::hex << std::uppercase << std::setfill('0')
+        << std::setw(4) << desc.idVendor << ", PID: 0x" << std::setw(4) << desc.idProduct
+        << std::dec << ", port " << m_location << ")";
+    return oss.str();
+}
+
+libusb_device_handle *UsbTransport::nativeHandle() const { return m_handle; }
+
+int UsbTransport::claimInterfaces()
+{
+    std::cout << "Claiming interfaces..." << std::endl;
+
+    // Ensure configuration 1 is active
+    int currentCfg = -1;
+    libusb_get_configuration(m_handle, &currentCfg);
+    std::cout << "Current configuration: " << currentCfg << std::endl;
+
+    if (currentCfg != 1)
+    {
+        std::cout << "Setting configuration to 1..." << std::endl;
+        int result = libusb_set_configuration(m_handle, 1);
+        if (result < 0)
+        {
+            std::cout << "Failed to set configuration: " << libusb_error_name(result) << std::endl;
+            return result;
+        }
+        std::cout << "Configuration set successfully" << std::endl;
+    }
+
+    // Find the streaming interface
+    std::cout << "Getting active config descriptor..." << std::endl;
+    libusb_config_descriptor *cfg = nullptr;
+    int cfgResult = libusb_get_active_config_descriptor(libusb_get_device(m_handle), &cfg);
+    if (cfgResult < 0)
+    {
+        std::cout << "Failed to get config descriptor: " << libusb_error_name(cfgResult)
+                  << std::endl;
+        return cfgResult;
+    }
+    std::cout << "Config descriptor retrieved successfully" << std::endl;
+
+    int                     streamIfNum = -1;
+    int                     streamAlt   = -1;
+    bool                    epFound     = false;
+    const libusb_interface *streamIface = nullptr;
+
+    std::cout << "Scanning " << (int)cfg->bNumInterfaces << " interfaces..." << std::endl;
+
+    for (uint8_t i = 0; i < cfg->bNumInterfaces && !epFound; ++i)
+    {
+        std::cout << "Checking interface " << (int)i << "..." << std::endl;
+        const libusb_interface &iface = cfg->interface[i];
+        std::cout << "Interface " << (int)i << " has " << iface.num_altsetting << " alt settings"
+                  << std::endl;
+
+        for (int a = 0; a < iface.num_altsetting && !epFound; ++a)
+        {
+            std::cout << "Checking alt setting " << a << "..." << std::endl;
+            const libusb_interface_descriptor &idesc = iface.altsetting[a];
+            std::cout << "Alt setting " << a << " has " << (int)idesc.bNumEndpoints << " endpoints"
+                      << std::endl;
+            std::cout << "Interface descriptor: bInterfaceNumber=" << (int)idesc.bInterfaceNumber
+                      << ", bAlternateSetting=" << (int)idesc.bAlternateSetting << std::endl;
+
+            for (uint8_t e = 0; e < idesc.bNumEndpoints && !epFound; ++e)
+            {
+                std::cout << "Checking endpoint " << (int)e << "..." << std::endl;
+                const libusb_endpoint_descriptor &ep   = idesc.endpoint[e];
+                uint8_t                           addr = ep.bEndpointAddress;
+                uint8_t                           attr = ep.bmAttributes & 0x3;
+                std::cout << "Endpoint " << (int)e << ": addr=0x" << std::hex << (int)addr
+                          << std::dec << ", attr=" << (int)attr << std::endl;
+
+                if ((addr == m_endpoint) && (attr == LIBUSB_TRANSFER_TYPE_BULK))
+                {
+                    std::cout << "Found matching endpoint! Interface="
+                              << (int)idesc.bInterfaceNumber
+                              << ", Alt=" << (int)idesc.bAlternateSetting << std::endl;
+                    // Use the actual interface number where the endpoint was found
+                    streamIfNum = idesc.bInterfaceNumber;
+                    streamAlt   = idesc.bAlternateSetting;
+                    epFound     = true;
+                    streamIface = &iface;
+                    // Bits 10:0 hold the packet size, the rest are high-bandwidth flags
+                    m_maxPacketSize = ep.wMaxPacketSize & 0x7ff;
+                    std::cout << "Using actual values: streamIfNum=" << streamIfNum
+                              << ", streamAlt=" << streamAlt << std::endl;
+                }
+            }
+        }
+    }
+
+    std::cout << "Interface scanning complete. epFound=" << epFound
+              << ", streamIfNum=" << streamIfNum << ", streamAlt=" << streamAlt << std::endl;
+
+    if (!epFound)
+    {
+        std::cout << "Could not locate BULK IN endpoint 0x" << std::hex << (int)m_endpoint
+                  << std::dec << std::endl;
+        libusb_free_config_descriptor(cfg);
+        return LIBUSB_ERROR_NOT_FOUND;
+    }
+
+    // Format and frame descriptors follow the first alternate setting of the streaming interface
+    const libusb_interface_descriptor &vsDesc = streamIface->altsetting[0];
+    m_streamingDescriptors.assign(vsDesc.extra, vsDesc.extra + vsDesc.extra_length);
+
+    // Try to claim both interfaces since we don't know which one is correct
+    std::cout << "Trying to claim interface 0..." << std::endl;
+    int result = libusb_claim_interface(m_handle, 0);
+    if (result < 0)
+    {
+        std::cout << "Failed to claim interface 0: " << libusb_error_name(result) << std::endl;
+    }
+    else
+    {
+        std::cout << "Successfully claimed interface 0" << std::endl;
+    }
+
+    std::cout << "Trying to claim interface 1..." << std::endl;
+    result = libusb_claim_interface(m_handle, 1);
+    if (result < 0)
+    {
+        std::cout << "Failed to claim interface 1: " << libusb_error_name(result) << std::endl;
+    }
+    else
+    {
+        std::cout << "Successfully claimed interface 1" << std::endl;
+    }
+
+    // Also try the corrupted interface numbers
+    std::cout << "Trying to claim interface 16..." << std::endl;
+    result = libusb_claim_interface(m_handle, 16);
+    if (result < 0)
+    {
+        std::cout << "Failed to claim interface 16: " << libusb_error_name(result) << std::endl;
+    }
+    else
+    {
+        std::cout << "Successfully claimed interface 16" << std::endl;
+    }
+
+    std::cout << "Trying to claim interface 17..." << std::endl;
+    result = libusb_claim_interface(m_handle, 17);
+    if (result < 0)
+    {
+        std::cout << "Failed to claim interface 17: " << libusb_error_name(result) << std::endl;
+    }
+    else
+    {
+        std::cout << "Successfully claimed interface 17" << std::endl;
+    }
+
+    if (streamAlt > 0)
+    {
+        result = libusb_set_interface_alt_setting(m_handle, streamIfNum, streamAlt);
+        if (result < 0)
+        {
+            std::cout << "Failed to set alternate setting: " << libusb_error_name(result)
+                      << std::endl;
+            libusb_free_config_descriptor(cfg);
+            return result;
+        }
+    }
+
+    libusb_free_config_descriptor(cfg);
+    std::cout << "claimInterfaces() completed successfully!" << std::endl;
+    return LIBUSB_SUCCESS;
+}
+
+void UsbTransport::releaseInterfaces()
+{
+    // Release all interfaces
+    for (int i = 0; i < 8; ++i)
+    { // Check first 8 interfaces
+        libusb_release_interface(m_handle, i);
+    }
+}
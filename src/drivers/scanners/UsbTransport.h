@@ -0,0 +1,68 @@
+#ifndef USBTRANSPORT_H
+#define USBTRANSPORT_H
+
+#include "KnokkeTransport.h"
+#include "UsbContext.h"
+
+#include <memory>
+
+/**
+ * @brief KnokkeTransport over libusb for a physical scanner
+ *
+ * Holds a reference on the libusb device so it can be reopened after a disconnect, and marks
+ * the device as taken in the shared UsbContext while it is open. A scanner that was unplugged
+ * and comes back is a new libusb device; open() finds it again on the same port.
+ */
+class UsbTransport : public KnokkeTransport
+{
+  public:
+    /**
+     * @param context Shared context the device was enumerated from
+     * @param device Device to open; a reference is taken for the transport's lifetime
+     * @param endpoint Bulk IN endpoint carrying the video payloads
+     */
+    UsbTransport(std::shared_ptr<UsbContext> context, libusb_device *device, uint8_t endpoint);
+    ~UsbTransport() override;
+
+    UsbTransport(const UsbTransport &)            = delete;
+    UsbTransport &operator=(const UsbTransport &) = delete;
+
+    int  open() override;
+    void close() override;
+
+    int controlTransfer(uint8_t        requestType,
+                        uint8_t        request,
+                        uint16_t       value,
+                        uint16_t       index,
+                        unsigned char *data,
+                        uint16_t       length,
+                        unsigned int   timeoutMs) override;
+
+    int bulkRead(unsigned char *data,
+                 int            length,
+                 int           *transferred,
+                 unsigned int   timeoutMs) override;
+
+    int clearHalt() override;
+
+    std::vector<uint8_t>  streamingDescriptors() const override;
+    int                   maxPacketSize() const override;
+    std::string           description() const override;
+    std::string           location() const override;
+    libusb_device_handle *nativeHandle() const override;
+
+  private:
+    int  claimInterfaces();
+    void releaseInterfaces();
+    bool refreshDevice();
+
+    std::shared_ptr<UsbContext> m_context;
+    libusb_device              *m_device;
+    libusb_device_handle       *m_handle;
+    uint8_t                     m_endpoint;
+    std::string                 m_location; // Port path, also the key held in m_context
+    std::vector<uint8_t>        m_streamingDescriptors;
+    int                         m_maxPacketSize;
+};
+
+#endif // USBTRANSPORT_H
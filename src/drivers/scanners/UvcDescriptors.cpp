@@ -0,0 +1,161 @@
+#include "UvcDescriptors.h"
+
+#include "BinaryIo.h"
+
+namespace
+{
+// Class-specific descriptor type and VS interface subtypes (UVC 1.1, appendix A)
+constexpr uint8_t CS_INTERFACE              = 0x24;
+constexpr uint8_t VS_FORMAT_UNCOMPRESSED    = 0x04;
+constexpr uint8_t VS_FRAME_UNCOMPRESSED     = 0x05;
+constexpr uint8_t VS_FORMAT_FRAME_BASED     = 0x10;
+constexpr uint8_t VS_FRAME_FRAME_BASED      = 0x11;
+constexpr int     FORMAT_DESCRIPTOR_LENGTH  = 22; // Up to and including bBitsPerPixel
+constexpr int     UNCOMPRESSED_FORMAT_BYTES = 27;
+constexpr int     UNCOMPRESSED_FRAME_BYTES  = 26; // Without the interval table
+} // namespace
+
+std::vector<FrameMode> parseFrameModes(const unsigned char *extra, int length)
+{
+    std::vector<FrameMode> modes;
+    uint8_t                formatIndex  = 0;
+    uint8_t                bitsPerPixel = 0;
+
+    int offset = 0;
+    while (extra && offset + 3 <= length)
+    {
+        const unsigned char *desc    = extra + offset;
+        const int            descLen = desc[0];
+        if (descLen < 3 || offset + descLen > length)
+        {
+            break;
+        }
+        offset += descLen;
+
+        if (desc[1] != CS_INTERFACE)
+        {
+            continue;
+        }
+
+        const uint8_t subtype = desc[2];
+        if (subtype == VS_FORMAT_UNCOMPRESSED || subtype == VS_FORMAT_FRAME_BASED)
+        {
+            if (descLen < FORMAT_DESCRIPTOR_LENGTH)
+            {
+                formatIndex = 0;
+                continue;
+            }
+            formatIndex  = desc[3];
+            bitsPerPixel = desc[21];
+            continue;
+        }
+
+        if ((subtype != VS_FRAME_UNCOMPRESSED && subtype != VS_FRAME_FRAME_BASED) ||
+            formatIndex == 0)
+        {
+            continue;
+        }
+
+        // The two frame descriptors differ only in where the interval table starts
+        const bool frameBased     = subtype == VS_FRAME_FRAME_BASED;
+        const int  defaultOffset  = frameBased ? 17 : 21;
+        const int  typeOffset     = frameBased ? 21 : 25;
+        const int  intervalOffset = 26;
+        if (descLen < intervalOffset)
+        {
+            continue;
+        }
+
+        FrameMode mode;
+        mode.formatIndex   = formatIndex;
+        mode.frameIndex    = desc[3];
+        mode.width         = static_cast<uint16_t>(readLe(&desc[5], 2));
+        mode.height        = static_cast<uint16_t>(readLe(&desc[7], 2));
+        mode.bitsPerPixel  = bitsPerPixel;
+        mode.frameInterval = static_cast<uint32_t>(readLe(&desc[defaultOffset], 4));
+
+        const int intervalType = desc[typeOffset];
+        if (intervalType == 0 || descLen < intervalOffset + 4 * intervalType)
+        {
+            modes.push_back(mode);
+            continue;
+        }
+
+        for (int i = 0; i < intervalType; ++i)
+        {
+            mode.frameInterval = static_cast<uint32_t>(readLe(&desc[intervalOffset + 4 * i], 4));
+            modes.push_back(mode);
+        }
+    }
+
+    return modes;
+}
+
+std::vector<uint8_t> buildStreamingDescriptors(const std::vector<FrameMode> &modes)
+{
+    std::vector<uint8_t> bytes;
+
+    size_t i = 0;
+    while (i < modes.size())
+    {
+        // One format descriptor per run of modes with the same format index
+        const FrameMode &first      = modes[i];
+        size_t           formatEnd  = i;
+        uint8_t          frameCount = 0;
+        while (formatEnd < modes.size() && modes[formatEnd].formatIndex == first.formatIndex)
+        {
+            if (formatEnd == i || modes[formatEnd].frameIndex != modes[formatEnd - 1].frameIndex)
+            {
+                ++frameCount;
+            }
+            ++formatEnd;
+        }
+
+        const size_t format = bytes.size();
+        bytes.resize(format + UNCOMPRESSED_FORMAT_BYTES, 0);
+        bytes[format + 0]  = UNCOMPRESSED_FORMAT_BYTES;
+        bytes[format + 1]  = CS_INTERFACE;
+        bytes[format + 2]  = VS_FORMAT_UNCOMPRESSED;
+        bytes[format + 3]  = first.formatIndex;
+        bytes[format + 4]  = frameCount;
+        bytes[format + 21] = first.bitsPerPixel;
+        bytes[format + 22] = first.frameIndex; // bDefaultFrameIndex
+
+        while (i < formatEnd)
+        {
+            size_t frameEnd = i;
+            while (frameEnd < formatEnd && modes[frameEnd].frameIndex == modes[i].frameIndex)
+            {
+                ++frameEnd;
+            }
+
+            const FrameMode &mode       = modes[i];
+            const int        intervals  = static_cast<int>(frameEnd - i);
+            const int        length     = UNCOMPRESSED_FRAME_BYTES + 4 * intervals;
+            const uint32_t   frameBytes = static_cast<uint32_t>(mode.frameBytes());
+            const uint32_t   bitRate =
+                mode.frameInterval ? static_cast<uint32_t>(frameBytes * 8 * mode.frameRate()) : 0;
+
+            const size_t frame = bytes.size();
+            bytes.resize(frame + length, 0);
+            bytes[frame + 0] = static_cast<uint8_t>(length);
+            bytes[frame + 1] = CS_INTERFACE;
+            bytes[frame + 2] = VS_FRAME_UNCOMPRESSED;
+            bytes[frame + 3] = mode.frameIndex;
+            writeLe(&bytes[frame + 5], mode.width, 2);
+            writeLe(&bytes[frame + 7], mode.height, 2);
+            writeLe(&bytes[frame + 9], bitRate, 4);
+            writeLe(&bytes[frame + 13], bitRate, 4);
+            writeLe(&bytes[frame + 17], frameBytes, 4);
+            writeLe(&bytes[frame + 21], mode.frameInterval, 4);
+            bytes[frame + 25] = static_cast<uint8_t>(intervals);
+            for (int k = 0; k < intervals; ++k)
+            {
+                writeLe(&bytes[frame + 26 + 4 * k], modes[i + k].frameInterval, 4);
+            }
+            i = frameEnd;
+        }
+    }
+
+    return bytes;
+}
@@ -0,0 +1,54 @@
+#ifndef UVCDESCRIPTORS_H
+#define UVCDESCRIPTORS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief One streamable video mode: a VS frame descriptor at one of its frame intervals
+ */
+struct FrameMode
+{
+    uint8_t  formatIndex   = 0; // bFormatIndex of the owning format descriptor
+    uint8_t  frameIndex    = 0; // bFrameIndex of the frame descriptor
+    uint16_t width         = 0; // Pixels per line
+    uint16_t height        = 0; // Lines per frame
+    uint8_t  bitsPerPixel  = 0; // From the format descriptor
+    uint32_t frameInterval = 0; // Frame period in 100 ns units
+
+    size_t frameBytes() const { return static_cast<size_t>(width) * height * bitsPerPixel / 8; }
+
+    double frameRate() const { return frameInterval ? 10000000.0 / frameInterval : 0.0; }
+
+    bool operator==(const FrameMode &other) const
+    {
+        return formatIndex == other.formatIndex && frameIndex == other.frameIndex &&
+               frameInterval == other.frameInterval;
+    }
+};
+
+/**
+ * @brief Parse the class-specific descriptors of a UVC video streaming interface
+ *
+ * Understands uncompressed and frame-based formats (UVC 1.1, sections 3.9.2.3 and 3.9.2.4 of
+ * the payload specs). Each discrete frame interval becomes its own mode; a frame with a
+ * continuous interval range is listed once at its default interval. Truncated or malformed
+ * descriptors are skipped.
+ * @param extra Descriptor bytes following the interface descriptor (libusb "extra")
+ * @param length Number of bytes in extra
+ * @return Modes in descriptor order
+ */
+std::vector<FrameMode> parseFrameModes(const unsigned char *extra, int length);
+
+/**
+ * @brief Build uncompressed format and frame descriptors describing the given modes
+ *
+ * The inverse of parseFrameModes(), for transports that stand in for a scanner. Consecutive
+ * modes sharing a format and frame index become one frame descriptor with an interval list.
+ * @param modes Modes to describe, grouped by format index
+ * @return Descriptor bytes as they would follow the interface descriptor
+ */
+std::vector<uint8_t> buildStreamingDescriptors(const std::vector<FrameMode> &modes);
+
+#endif // UVCDESCRIPTORS_H
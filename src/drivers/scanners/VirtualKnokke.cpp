@@ -0,0 +1,489 @@
+#include "VirtualKnokke.h"
+
+#include "BinaryIo.h"
+#include "FrameAssembler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+constexpr int PLAIN_HEADER_BYTES     = 2;  // bHeaderLength and bmHeaderInfo
+constexpr int TIMESTAMP_HEADER_BYTES = 12; // Plus PTS and SCR
+
+// Control ranges reported for GET_MIN and GET_MAX
+constexpr uint32_t MAX_EXPOSURE_TIME = 1000000; // microseconds
+constexpr uint16_t MAX_GAIN          = 4800;    // 48 dB
+constexpr int32_t  MAX_MOTOR_SPEED   = 10000;   // steps/s
+
+VirtualKnokke::Options withDefaults(VirtualKnokke::Options options)
+{
+    if (options.mode.frameBytes() == 0 || options.mode.frameInterval == 0)
+    {
+        options.mode.formatIndex   = Knokke::DEFAULT_FORMAT_INDEX;
+        options.mode.frameIndex    = Knokke::DEFAULT_FRAME_INDEX;
+        options.mode.width         = Knokke::DEFAULT_FRAME_WIDTH;
+        options.mode.height        = Knokke::DEFAULT_FRAME_HEIGHT;
+        options.mode.bitsPerPixel  = Knokke::DEFAULT_BITS_PER_PIXEL;
+        options.mode.frameInterval = Knokke::DEFAULT_FRAME_INTERVAL;
+    }
+    if (options.rateMultiplier <= 0)
+    {
+        options.rateMultiplier = 1.0;
+    }
+    return options;
+}
+
+/**
+ * @brief Wire format of one parameter control, or 0 bytes if the control is not one of them
+ */
+uint16_t encodeControl(uint16_t                     value,
+                       uint16_t                     index,
+                       const Knokke::ScannerParams &params,
+                       unsigned char               *data)
+{
+    if (index == Knokke::UVC_CAMERA_TERMINAL && value == Knokke::UVC_EXPOSURE_CONTROL)
+    {
+        writeLe(data, params.exposure_time, 4);
+        return 4;
+    }
+    if (index == Knokke::UVC_CAMERA_TERMINAL && value == Knokke::UVC_GAIN_CONTROL)
+    {
+        writeLe(data, params.gain, 2);
+        return 2;
+    }
+    if (index == Knokke::UVC_EXTENSION_UNIT && value == Knokke::UVC_BACKLIGHT_CONTROL)
+    {
+        writeLe(data + 0, params.backlight.red, 2);
+        writeLe(data + 2, params.backlight.green, 2);
+        writeLe(data + 4, params.backlight.blue, 2);
+        return 6;
+    }
+    if (index == Knokke::UVC_EXTENSION_UNIT && value == Knokke::UVC_MOTOR_SPEED_CONTROL)
+    {
+        writeLe(data, static_cast<uint32_t>(params.motor_speed), 4);
+        return 4;
+    }
+    if (index == Knokke::UVC_EXTENSION_UNIT && value == Knokke::UVC_UPDATE_CONTROL)
+    {
+        data[0] = params.enter_bootloader ? 1 : 0;
+        return 1;
+    }
+    return 0;
+}
+
+void decodeControl(uint16_t               value,
+                   uint16_t               index,
+                   const unsigned char   *data,
+                   Knokke::ScannerParams &params)
+{
+    if (index == Knokke::UVC_CAMERA_TERMINAL && value == Knokke::UVC_EXPOSURE_CONTROL)
+    {
+        params.exposure_time = static_cast<uint32_t>(readLe(data, 4));
+    }
+    else if (index == Knokke::UVC_CAMERA_TERMINAL && value == Knokke::UVC_GAIN_CONTROL)
+    {
+        params.gain = static_cast<uint16_t>(readLe(data, 2));
+    }
+    else if (index == Knokke::UVC_EXTENSION_UNIT && value == Knokke::UVC_BACKLIGHT_CONTROL)
+    {
+        params.backlight.red   = static_cast<uint16_t>(readLe(data + 0, 2));
+        params.backlight.green = static_cast<uint16_t>(readLe(data + 2, 2));
+        params.backlight.blue  = static_cast<uint16_t>(readLe(data + 4, 2));
+    }
+    else if (index == Knokke::UVC_EXTENSION_UNIT && value == Knokke::UVC_MOTOR_SPEED_CONTROL)
+    {
+        params.motor_speed = static_cast<int32_t>(readLe(data, 4));
+    }
+    else if (index == Knokke::UVC_EXTENSION_UNIT && value == Knokke::UVC_UPDATE_CONTROL)
+    {
+        params.enter_bootloader = data[0] != 0;
+    }
+}
+} // namespace
+
+VirtualKnokke::VirtualKnokke() : VirtualKnokke(Options()) {}
+
+VirtualKnokke::VirtualKnokke(const Options &options)
+    : m_options(withDefaults(options)), m_epoch(std::chrono::steady_clock::now()),
+      m_frame(m_options.mode.frameBytes()), m_sequence(0), m_offset(0), m_frameEnd(0),
+      m_inFrame(false), m_dropEof(false), m_haltPending(false), m_timeoutPending(false),
+      m_disconnectPending(false), m_fid(0), m_framePts(0), m_halted(false),
+      m_disconnected(false), m_framesSent(0), m_random(m_options.seed)
+{
+    for (int i = 0; i < FAULT_COUNT; ++i)
+    {
+        m_pendingFaults[i]    = 0;
+        m_faultProbability[i] = 0.0;
+        m_faultCounts[i]      = 0;
+    }
+}
+
+int VirtualKnokke::open()
+{
+    if (m_disconnected)
+    {
+        return LIBUSB_ERROR_NO_DEVICE;
+    }
+
+    // Reopening resets the endpoint; the device itself keeps counting frames
+    m_halted        = false;
+    m_inFrame       = false;
+    m_silentUntil   = std::chrono::steady_clock::time_point();
+    m_nextFrameTime = std::chrono::steady_clock::now();
+    return LIBUSB_SUCCESS;
+}
+
+void VirtualKnokke::close() {}
+
+int VirtualKnokke::controlTransfer(uint8_t        requestType,
+                                   uint8_t        request,
+                                   uint16_t       value,
+                                   uint16_t       index,
+                                   unsigned char *data,
+                                   uint16_t       length,
+                                   unsigned int   timeoutMs)
+{
+    if (m_disconnected)
+    {
+        return LIBUSB_ERROR_NO_DEVICE;
+    }
+
+    std::this_thread::sleep_for(std::chrono::microseconds(m_options.controlLatencyUs));
+    if (takeFault(Fault::CONTROL_TIMEOUT))
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+        return LIBUSB_ERROR_TIMEOUT;
+    }
+
+    const bool                  set = requestType == Knokke::UVC_REQUEST_TYPE_CLASS_OUT;
+    std::lock_guard<std::mutex> lock(m_controlMutex);
+
+    if (index == Knokke::UVC_STREAMING_INTERFACE &&
+        (value == Knokke::UVC_VS_PROBE_CONTROL || value == Knokke::UVC_VS_COMMIT_CONTROL))
+    {
+        std::vector<uint8_t> &control = m_streamingControls[std::make_pair(value, index)];
+        if (set)
+        {
+            control.assign(data, data + length);
+
+            // The device settles on its one mode whatever was asked for
+            if (value == Knokke::UVC_VS_PROBE_CONTROL && control.size() >= 30)
+            {
+                control[2] = m_options.mode.formatIndex;
+                control[3] = m_options.mode.frameIndex;
+                writeLe(&control[4], m_options.mode.frameInterval, 4);
+                writeLe(&control[18], m_options.mode.frameBytes(), 4);
+                writeLe(&control[22], static_cast<uint32_t>(m_options.payloadBytes), 4);
+                writeLe(&control[26], DEFAULT_CLOCK_FREQUENCY, 4);
+            }
+            return length;
+        }
+
+        std::memset(data, 0, length);
+        std::memcpy(data, control.data(), std::min<size_t>(length, control.size()));
+        return length;
+    }
+
+    // Parameter controls; anything else stalls the control pipe like on the device
+    unsigned char encoded[8];
+    const int     size = encodeControl(value, index, m_params, encoded);
+    if (size == 0 || length < size)
+    {
+        return LIBUSB_ERROR_PIPE;
+    }
+
+    if (set)
+    {
+        if (request != Knokke::UVC_SET_CUR)
+        {
+            return LIBUSB_ERROR_PIPE;
+        }
+        decodeControl(value, index, data, m_params);
+        return size;
+    }
+
+    Knokke::ScannerParams limits;
+    switch (request)
+    {
+    case Knokke::UVC_GET_CUR:
+        limits = m_params;
+        break;
+    case Knokke::UVC_GET_MIN:
+        limits.exposure_time = 1;
+        limits.motor_speed   = -MAX_MOTOR_SPEED;
+        break;
+    case Knokke::UVC_GET_MAX:
+        limits.exposure_time   = MAX_EXPOSURE_TIME;
+        limits.gain            = MAX_GAIN;
+        limits.backlight.red   = 0xffff;
+        limits.backlight.green = 0xffff;
+        limits.backlight.blue  = 0xffff;
+        limits.motor_speed     = MAX_MOTOR_SPEED;
+        break;
+    case Knokke::UVC_GET_DEF:
+        break;
+    case Knokke::UVC_GET_LEN:
+        writeLe(data, size, 2);
+        return 2;
+    case Knokke::UVC_GET_INFO:
+        data[0] = 0x03; // Supports GET and SET
+        return 1;
+    default:
+        return LIBUSB_ERROR_PIPE;
+    }
+
+    encodeControl(value, index, limits, data);
+    return size;
+}
+
+int VirtualKnokke::bulkRead(unsigned char *data,
+                            int            length,
+                            int           *transferred,
+                            unsigned int   timeoutMs)
+{
+    *transferred = 0;
+    if (m_disconnected)
+    {
+        return LIBUSB_ERROR_NO_DEVICE;
+    }
+    if (m_halted)
+    {
+        return LIBUSB_ERROR_PIPE;
+    }
+
+    const int headerBytes = m_options.timestamps ? TIMESTAMP_HEADER_BYTES : PLAIN_HEADER_BYTES;
+    if (length <= headerBytes)
+    {
+        return LIBUSB_ERROR_INVALID_PARAM;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (now < m_silentUntil)
+    {
+        std::this_thread::sleep_for(
+            std::min<std::chrono::steady_clock::duration>(m_silentUntil - now,
+                                                          std::chrono::milliseconds(timeoutMs)));
+        return LIBUSB_ERROR_TIMEOUT;
+    }
+
+    if (!m_inFrame)
+    {
+        const auto interval = std::chrono::nanoseconds(static_cast<int64_t>(
+            m_options.mode.frameInterval * 100.0 / m_options.rateMultiplier));
+
+        // After a pause pick up the schedule from now instead of bursting
+        if (now > m_nextFrameTime + interval)
+        {
+            m_nextFrameTime = now;
+        }
+        if (m_nextFrameTime - now > std::chrono::milliseconds(timeoutMs))
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+            return LIBUSB_ERROR_TIMEOUT;
+        }
+        std::this_thread::sleep_until(m_nextFrameTime);
+        m_nextFrameTime += interval;
+
+        beginFrame();
+    }
+
+    // Faults that hit in the middle of a frame wait for half of it to go out
+    if (m_offset >= m_frame.size() / 2)
+    {
+        if (m_disconnectPending)
+        {
+            m_disconnectPending = false;
+            m_inFrame           = false;
+            m_disconnected      = true;
+            return LIBUSB_ERROR_NO_DEVICE;
+        }
+        if (m_haltPending)
+        {
+            m_haltPending = false;
+            m_inFrame     = false;
+            m_halted      = true;
+            return LIBUSB_ERROR_PIPE;
+        }
+        if (m_timeoutPending)
+        {
+            m_timeoutPending = false;
+            m_silentUntil    = std::chrono::steady_clock::now() +
+                            std::chrono::milliseconds(m_options.bulkTimeoutMs);
+            return bulkRead(data, length, transferred, timeoutMs);
+        }
+    }
+
+    const size_t payloadImage = static_cast<size_t>(m_options.payloadBytes - headerBytes);
+    const size_t image        = std::min<size_t>(
+        {m_frameEnd - m_offset, payloadImage, static_cast<size_t>(length - headerBytes)});
+
+    data[0] = static_cast<unsigned char>(headerBytes);
+    data[1] = UvcPayloadHeader::UVC_HEADER_EOH | m_fid;
+    if (m_options.timestamps)
+    {
+        // SOF is the 1 kHz USB frame number, 11 bits
+        const auto sinceEpoch = std::chrono::steady_clock::now() - m_epoch;
+        const auto sof = std::chrono::duration_cast<std::chrono::milliseconds>(sinceEpoch).count();
+        data[1] |= UvcPayloadHeader::UVC_HEADER_PTS | UvcPayloadHeader::UVC_HEADER_SCR;
+        writeLe(data + 2, m_framePts, 4);
+        writeLe(data + 6, deviceClock(), 4);
+        writeLe(data + 10, static_cast<uint64_t>(sof) & 0x07ff, 2);
+    }
+
+    std::memcpy(data + headerBytes, m_frame.data() + m_offset, image);
+    m_offset += image;
+
+    if (m_offset == m_frameEnd)
+    {
+        m_inFrame = false;
+        if (!m_dropEof)
+        {
+            data[1] |= UvcPayloadHeader::UVC_HEADER_EOF;
+        }
+        if (!m_dropEof && m_frameEnd == m_frame.size())
+        {
+            ++m_framesSent;
+        }
+    }
+
+    *transferred = static_cast<int>(headerBytes + image);
+    return LIBUSB_SUCCESS;
+}
+
+int VirtualKnokke::clearHalt()
+{
+    if (m_disconnected)
+    {
+        return LIBUSB_ERROR_NO_DEVICE;
+    }
+
+    // The frame cut off by the stall is abandoned, the next read starts a new one
+    m_halted = false;
+    return LIBUSB_SUCCESS;
+}
+
+std::vector<uint8_t> VirtualKnokke::streamingDescriptors() const
+{
+    return buildStreamingDescriptors({m_options.mode});
+}
+
+int VirtualKnokke::maxPacketSize() const { return Knokke::DEFAULT_BULK_PACKET_BYTES; }
+
+std::string VirtualKnokke::description() const
+{
+    std::ostringstream description;
+    description << "Virtual Knokke, " << m_options.mode.width << "x" << m_options.mode.height
+                << " @ " << m_options.mode.frameRate() * m_options.rateMultiplier << " fps";
+    return description.str();
+}
+
+void VirtualKnokke::injectFault(Fault fault, int count)
+{
+    std::lock_guard<std::mutex> lock(m_faultMutex);
+    m_pendingFaults[static_cast<int>(fault)] += count;
+}
+
+void VirtualKnokke::setFaultProbability(Fault fault, double probability)
+{
+    std::lock_guard<std::mutex> lock(m_faultMutex);
+    m_faultProbability[static_cast<int>(fault)] = std::min(std::max(probability, 0.0), 1.0);
+}
+
+uint64_t VirtualKnokke::faultCount(Fault fault) const
+{
+    return m_faultCounts[static_cast<int>(fault)];
+}
+
+void VirtualKnokke::reconnect()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_controlMutex);
+        m_params = Knokke::ScannerParams();
+    }
+    m_halted       = false;
+    m_disconnected = false;
+}
+
+bool VirtualKnokke::isDisconnected() const { return m_disconnected; }
+
+uint64_t VirtualKnokke::framesSent() const { return m_framesSent; }
+
+Knokke::ScannerParams VirtualKnokke::parameters() const
+{
+    std::lock_guard<std::mutex> lock(m_controlMutex);
+    return m_params;
+}
+
+bool VirtualKnokke::checkFrame(const uint8_t *data, size_t size, uint64_t *sequence)
+{
+    if (!data || size < 8)
+    {
+        return false;
+    }
+
+    const uint64_t number = readLe(data, 8);
+    const uint8_t  fill   = static_cast<uint8_t>(number);
+    for (size_t i = 8; i < size; ++i)
+    {
+        if (data[i] != fill)
+        {
+            return false;
+        }
+    }
+
+    if (sequence)
+    {
+        *sequence = number;
+    }
+    return true;
+}
+
+bool VirtualKnokke::takeFault(Fault fault)
+{
+    const int                   i = static_cast<int>(fault);
+    std::lock_guard<std::mutex> lock(m_faultMutex);
+    if (m_pendingFaults[i] > 0)
+    {
+        --m_pendingFaults[i];
+    }
+    else if (m_faultProbability[i] <= 0 ||
+             std::uniform_real_distribution<double>(0.0, 1.0)(m_random) >= m_faultProbability[i])
+    {
+        return false;
+    }
+
+    ++m_faultCounts[i];
+    return true;
+}
+
+void VirtualKnokke::beginFrame()
+{
+    // FID toggles on every frame, including after one that was cut off. Mid-frame faults
+    // still pending from a frame that ended early carry over to this one. A frame is torn one
+    // way at most, so every frame fault costs exactly one frame.
+    m_fid ^= UvcPayloadHeader::UVC_HEADER_FID;
+
+    writeLe(m_frame.data(), m_sequence, 8);
+    std::memset(m_frame.data() + 8, static_cast<uint8_t>(m_sequence), m_frame.size() - 8);
+    ++m_sequence;
+
+    m_offset            = 0;
+    m_frameEnd          = takeFault(Fault::SHORT_FRAME) ? m_frame.size() / 2 : m_frame.size();
+    m_dropEof           = m_frameEnd == m_frame.size() && takeFault(Fault::MISSING_EOF);
+    m_haltPending       = m_haltPending || takeFault(Fault::STALL);
+    m_timeoutPending    = m_timeoutPending || takeFault(Fault::BULK_TIMEOUT);
+    m_disconnectPending = m_disconnectPending || takeFault(Fault::DISCONNECT);
+    m_framePts          = deviceClock();
+    m_inFrame           = true;
+}
+
+uint32_t VirtualKnokke::deviceClock() const
+{
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - m_epoch);
+    return static_cast<uint32_t>(
+        static_cast<uint64_t>(elapsed.count() * (DEFAULT_CLOCK_FREQUENCY / 1e9)));
+}
@@ -0,0 +1,176 @@
+#ifndef VIRTUALKNOKKE_H
+#define VIRTUALKNOKKE_H
+
+#include "Knokke.h"
+#include "KnokkeTransport.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <random>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Emulated scanner for exercising Knokke without hardware
+ *
+ * Implements the scanner's side of every transfer Knokke makes: probe/commit, GET/SET of
+ * exposure, gain, backlight and motor speed with a realistic round-trip latency, and a bulk
+ * stream of synthetic frames in UVC payloads with FID, EOF, PTS and SCR. The stream can run
+ * faster than the real scanner (Options::rateMultiplier) so long soak tests finish quickly.
+ *
+ * Faults are injected on purpose, either queued for the next frames with injectFault() or at
+ * random with setFaultProbability(), to drive the reassembly and recovery paths:
+ * - SHORT_FRAME: the frame ends with EOF after half its bytes
+ * - MISSING_EOF: the frame's last payload lacks EOF, the next frame just toggles FID
+ * - STALL: the bulk endpoint halts mid-frame; reads fail with LIBUSB_ERROR_PIPE until the
+ *   halt is cleared or the device is opened again
+ * - BULK_TIMEOUT: the device sends nothing for Options::bulkTimeoutMs mid-frame
+ * - CONTROL_TIMEOUT: the next control transfer times out
+ * - DISCONNECT: the device vanishes mid-frame; every call fails with LIBUSB_ERROR_NO_DEVICE
+ *   until reconnect(), after which it comes back with its parameters at their defaults
+ *
+ * Each frame starts with its 64-bit sequence number and is filled with the sequence's low byte,
+ * so checkFrame() can tell intact frames from torn or stitched ones.
+ */
+class VirtualKnokke : public KnokkeTransport
+{
+  public:
+    enum class Fault
+    {
+        SHORT_FRAME,
+        MISSING_EOF,
+        STALL,
+        BULK_TIMEOUT,
+        CONTROL_TIMEOUT,
+        DISCONNECT
+    };
+    static constexpr int FAULT_COUNT = 6;
+
+    static constexpr uint32_t DEFAULT_CLOCK_FREQUENCY = 48000000; // Device clock, Hz
+    static constexpr int      DEFAULT_PAYLOAD_BYTES   = 36 * 1024;
+
+    struct Options
+    {
+        FrameMode mode;                    // Default: the scanner's 3840x12 RAW16 at 400 fps
+        double    rateMultiplier   = 1.0;  // Frames per frame interval of the mode
+        int       controlLatencyUs = 1000; // Round trip of one control transfer
+        int       payloadBytes     = DEFAULT_PAYLOAD_BYTES;
+        bool      timestamps       = true; // PTS and SCR in every payload header
+        int       bulkTimeoutMs    = 250;  // Silence caused by a BULK_TIMEOUT fault
+        uint32_t  seed             = 1;    // Random faults are reproducible per seed
+    };
+
+    VirtualKnokke();
+    explicit VirtualKnokke(const Options &options);
+
+    int  open() override;
+    void close() override;
+
+    int controlTransfer(uint8_t        requestType,
+                        uint8_t        request,
+                        uint16_t       value,
+                        uint16_t       index,
+                        unsigned char *data,
+                        uint16_t       length,
+                        unsigned int   timeoutMs) override;
+
+    int bulkRead(unsigned char *data,
+                 int            length,
+                 int           *transferred,
+                 unsigned int   timeoutMs) override;
+
+    int clearHalt() override;
+
+    std::vector<uint8_t> streamingDescriptors() const override;
+    int                  maxPacketSize() const override;
+    std::string          description() const override;
+
+    /**
+     * @brief Queue a fault for the next frames (or control transfers for CONTROL_TIMEOUT)
+     * @param fault Fault to inject
+     * @param count Number of consecutive occurrences
+     */
+    void injectFault(Fault fault, int count = 1);
+
+    /**
+     * @brief Inject a fault at random
+     * @param fault Fault to inject
+     * @param probability Chance per frame (per control transfer for CONTROL_TIMEOUT), 0 to 1
+     */
+    void setFaultProbability(Fault fault, double probability);
+
+    /**
+     * @brief Number of times a fault has been injected
+     */
+    uint64_t faultCount(Fault fault) const;
+
+    /**
+     * @brief Plug the device back in after a DISCONNECT fault, like after a power cycle
+     */
+    void reconnect();
+
+    bool isDisconnected() const;
+
+    /**
+     * @brief Number of frames sent in full and intact
+     */
+    uint64_t framesSent() const;
+
+    /**
+     * @brief Parameter values the device currently holds
+     */
+    Knokke::ScannerParams parameters() const;
+
+    /**
+     * @brief Check a received frame against the synthetic pattern
+     * @param data Frame bytes
+     * @param size Frame size
+     * @param sequence Output sequence number the frame was sent with
+     * @return true if the frame is one whole synthetic frame
+     */
+    static bool checkFrame(const uint8_t *data, size_t size, uint64_t *sequence = nullptr);
+
+  private:
+    bool     takeFault(Fault fault);
+    void     beginFrame();
+    uint32_t deviceClock() const;
+
+    const Options                               m_options;
+    const std::chrono::steady_clock::time_point m_epoch; // Device clock zero
+
+    // Capture thread only
+    std::vector<uint8_t>                  m_frame;
+    uint64_t                              m_sequence;
+    size_t                                m_offset;
+    size_t                                m_frameEnd; // Bytes this frame carries, less if short
+    bool                                  m_inFrame;
+    bool                                  m_dropEof;
+    bool                                  m_haltPending;
+    bool                                  m_timeoutPending;
+    bool                                  m_disconnectPending;
+    uint8_t                               m_fid;
+    uint32_t                              m_framePts;
+    std::chrono::steady_clock::time_point m_nextFrameTime;
+    std::chrono::steady_clock::time_point m_silentUntil; // End of a BULK_TIMEOUT
+
+    std::atomic<bool>     m_halted;
+    std::atomic<bool>     m_disconnected;
+    std::atomic<uint64_t> m_framesSent;
+
+    // Faults, shared with the control path and the test driving the device
+    mutable std::mutex    m_faultMutex;
+    int                   m_pendingFaults[FAULT_COUNT];
+    double                m_faultProbability[FAULT_COUNT];
+    std::atomic<uint64_t> m_faultCounts[FAULT_COUNT];
+    std::mt19937          m_random;
+
+    // Device-side state written through control transfers
+    mutable std::mutex                                            m_controlMutex;
+    Knokke::ScannerParams                                         m_params;
+    std::map<std::pair<uint16_t, uint16_t>, std::vector<uint8_t>> m_streamingControls;
+};
+
+#endif // VIRTUALKNOKKE_H
@@ -0,0 +1,158 @@
+#include "scanners/UsbContext.h"
+#include "scanners/VirtualKnokke.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+constexpr int    MEASURE_MS  = 1000;
+constexpr double MIN_SHARE   = 0.9; // Each of two devices keeps this share of the solo rate
+constexpr int    NO_SUCH_CPU = 4096;
+
+struct StreamResult
+{
+    uint64_t frames = 0;
+    uint64_t lost   = 0;
+};
+
+/**
+ * @brief Stream from several paced simulated scanners at once, one Knokke each
+ *
+ * VirtualKnokke has no libusb handle, so every instance reads with blocking calls on its own
+ * engine thread. This shows instances do not hold each other up; it says nothing about USB
+ * bandwidth or the shared event thread, which testSharedContext() covers.
+ */
+std::vector<StreamResult> streamConcurrently(int deviceCount)
+{
+    std::vector<std::unique_ptr<Knokke>>                scanners;
+    std::vector<std::unique_ptr<std::atomic<uint64_t>>> counts;
+    for (int i = 0; i < deviceCount; ++i)
+    {
+        scanners.push_back(std::make_unique<Knokke>(std::make_unique<VirtualKnokke>()));
+        counts.push_back(std::make_unique<std::atomic<uint64_t>>(0));
+
+        std::atomic<uint64_t> *count = counts.back().get();
+        scanners.back()->setFrameCallback([count](const uint8_t *, size_t, uint64_t)
+                                          { ++*count; });
+        if (scanners.back()->connect() != Knokke::Error::SUCCESS ||
+            scanners.back()->startStreaming() != Knokke::Error::SUCCESS)
+        {
+            std::cout << "FAIL: could not start simulated scanner " << i << std::endl;
+            return {};
+        }
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(MEASURE_MS));
+
+    std::vector<StreamResult> results(deviceCount);
+    for (int i = 0; i < deviceCount; ++i)
+    {
+        results[i].frames = *counts[i];
+        results[i].lost   = scanners[i]->getLostFrameCount();
+        scanners[i]->stopStreaming();
+        scanners[i]->disconnect();
+    }
+    return results;
+}
+
+/**
+ * @brief Instances share one libusb context and its event thread, and never hold the same
+ * device twice
+ */
+bool testSharedContext()
+{
+    std::shared_ptr<UsbContext> first  = UsbContext::shared();
+    std::shared_ptr<UsbContext> second = UsbContext::shared();
+    if (!first)
+    {
+        std::cout << "SKIP: libusb could not be initialised" << std::endl;
+        return true;
+    }
+    if (first != second || first->get() != second->get())
+    {
+        std::cout << "FAIL: UsbContext::shared() created a second context" << std::endl;
+        return false;
+    }
+
+    const std::string portA = "1-2.3";
+    const std::string portB = "1-2.4";
+    if (!first->acquireDevice(portA) || second->acquireDevice(portA) ||
+        !second->acquireDevice(portB) || !first->isDeviceAcquired(portB))
+    {
+        std::cout << "FAIL: a device held by one instance was handed to another" << std::endl;
+        return false;
+    }
+
+    first->releaseDevice(portA);
+    if (second->isDeviceAcquired(portA) || !second->acquireDevice(portA))
+    {
+        std::cout << "FAIL: a released device could not be acquired again" << std::endl;
+        return false;
+    }
+    second->releaseDevice(portA);
+    second->releaseDevice(portB);
+
+    // Starting events again reuses the one thread; what it cannot apply is reported, not fatal
+    if (!first->startEvents() || !second->startEvents())
+    {
+        std::cout << "FAIL: the USB event thread could not be started" << std::endl;
+        return false;
+    }
+    const UsbContext::RealtimeResult realtime = second->setEventRealtime(NO_SUCH_CPU, 1);
+    if (realtime.pinned || realtime.pinError.empty())
+    {
+        std::cout << "FAIL: pinning the USB event thread to a missing core went unreported"
+                  << std::endl;
+        return false;
+    }
+    return true;
+}
+} // namespace
+
+int main()
+{
+    if (!testSharedContext())
+    {
+        return 1;
+    }
+
+    const std::vector<StreamResult> solo = streamConcurrently(1);
+    if (solo.empty() || solo[0].frames == 0)
+    {
+        std::cout << "FAIL: single simulated scanner delivered no frames" << std::endl;
+        return 1;
+    }
+    std::cout << "1 device: " << solo[0].frames << " frames, " << solo[0].lost << " lost"
+              << std::endl;
+
+    const std::vector<StreamResult> pair = streamConcurrently(2);
+    if (pair.size() != 2)
+    {
+        return 1;
+    }
+
+    bool ok = true;
+    for (size_t i = 0; i < pair.size(); ++i)
+    {
+        std::cout << "2 devices, #" << i << ": " << pair[i].frames << " frames, " << pair[i].lost
+                  << " lost" << std::endl;
+        if (pair[i].frames < solo[0].frames * MIN_SHARE)
+        {
+            std::cout << "FAIL: device " << i << " fell below " << MIN_SHARE * 100
+                      << "% of the single-device rate" << std::endl;
+            ok = false;
+        }
+    }
+
+    const uint64_t total = pair[0].frames + pair[1].frames;
+    std::cout << "Simulated scanners, blocking reads: 2 devices delivered "
+              << static_cast<double>(total) / solo[0].frames << "x the frames of one"
+              << std::endl;
+    return ok ? 0 : 1;
+}
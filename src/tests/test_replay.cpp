@@ -0,0 +1,279 @@
+#include "scanners/Knokke.h"
+#include "scanners/ReplayTransport.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+constexpr int    FRAME_COUNT      = 200;
+constexpr int    PACED_MS         = 500;
+constexpr double PACING_TOLERANCE = 0.2; // Real-time replay may be this far off the mode's rate
+
+FrameMode testMode()
+{
+    FrameMode mode;
+    mode.formatIndex   = Knokke::DEFAULT_FORMAT_INDEX;
+    mode.frameIndex    = Knokke::DEFAULT_FRAME_INDEX;
+    mode.width         = Knokke::DEFAULT_FRAME_WIDTH;
+    mode.height        = Knokke::DEFAULT_FRAME_HEIGHT;
+    mode.bitsPerPixel  = Knokke::DEFAULT_BITS_PER_PIXEL;
+    mode.frameInterval = Knokke::DEFAULT_FRAME_INTERVAL;
+    return mode;
+}
+
+// Every byte depends on the frame and its position, so reordered or torn frames show up
+std::vector<uint8_t> testFrame(int index, size_t bytes)
+{
+    std::vector<uint8_t> frame(bytes);
+    for (size_t i = 0; i < bytes; ++i)
+    {
+        frame[i] = static_cast<uint8_t>(index * 31 + i * 7);
+    }
+    return frame;
+}
+
+/**
+ * @brief Write the test frames to a journal as Knokke::startRecording() does
+ */
+bool writeJournal(const std::string &path, const FrameMode &mode, bool compress)
+{
+    CaptureJournal          journal;
+    CaptureJournal::Options options;
+    options.mode     = mode;
+    options.compress = compress;
+    if (!journal.open(path, options))
+    {
+        std::cout << "FAIL: could not create " << path << std::endl;
+        return false;
+    }
+    for (int i = 0; i < FRAME_COUNT; ++i)
+    {
+        const std::vector<uint8_t> frame = testFrame(i, mode.frameBytes());
+        FrameInfo                  info;
+        info.frameNumber = i;
+        info.size        = frame.size();
+
+        // A slow disk must not cost test frames, wait for the writer instead
+        while (!journal.appendFrame(frame.data(), info))
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    journal.close();
+    return true;
+}
+
+/**
+ * @brief Replay a source as fast as possible and check every frame arrives intact and in order
+ */
+bool replayMatches(std::unique_ptr<ReplaySource> source, const std::string &name)
+{
+    if (!source)
+    {
+        std::cout << "FAIL: " << name << ": could not open the file" << std::endl;
+        return false;
+    }
+
+    const size_t frameBytes = source->frameMode().frameBytes();
+    auto         transport  = std::make_unique<ReplayTransport>(
+        std::move(source), ReplayTransport::Pacing::AS_FAST_AS_POSSIBLE);
+    ReplayTransport *replay = transport.get();
+
+    Knokke                            scanner(std::move(transport));
+    std::mutex                        mutex;
+    std::vector<std::vector<uint8_t>> received;
+    scanner.setFrameCallback(
+        [&](const uint8_t *data, size_t size, uint64_t)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            received.emplace_back(data, data + size);
+        });
+
+    if (scanner.connect() != Knokke::Error::SUCCESS ||
+        scanner.startStreaming() != Knokke::Error::SUCCESS)
+    {
+        std::cout << "FAIL: " << name << ": could not start the replay" << std::endl;
+        return false;
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!replay->isFinished() && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    scanner.stopStreaming();
+    scanner.disconnect();
+
+    if (received.size() != FRAME_COUNT)
+    {
+        std::cout << "FAIL: " << name << ": " << received.size() << " of " << FRAME_COUNT
+                  << " frames replayed" << std::endl;
+        return false;
+    }
+    for (int i = 0; i < FRAME_COUNT; ++i)
+    {
+        if (received[i] != testFrame(i, frameBytes))
+        {
+            std::cout << "FAIL: " << name << ": frame " << i << " differs" << std::endl;
+            return false;
+        }
+    }
+
+    std::cout << name << ": " << FRAME_COUNT << " frames replayed intact" << std::endl;
+    return true;
+}
+
+/**
+ * @brief Sizes and counts a damaged journal claims are checked against the file, not allocated
+ */
+bool survivesDamage(const std::string &path)
+{
+    std::FILE *file = std::fopen(path.c_str(), "r+b");
+    if (!file)
+    {
+        std::cout << "FAIL: could not reopen " << path << std::endl;
+        return false;
+    }
+    uint8_t offset[8] = {};
+    std::fseek(file, 24, SEEK_SET);
+    const bool haveIndex = std::fread(offset, 1, sizeof(offset), file) == sizeof(offset);
+    uint64_t   index     = 0;
+    for (int i = 7; i >= 0; --i)
+    {
+        index = index << 8 | offset[i];
+    }
+
+    // An index claiming every frame there could be, and a first frame of 4 GiB
+    const uint8_t huge[8] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x0f};
+    std::fseek(file, static_cast<long>(index + 8), SEEK_SET);
+    std::fwrite(huge, 1, sizeof(huge), file);
+    std::fseek(file, 64 + 8, SEEK_SET);
+    std::fwrite(huge, 1, 4, file);
+    std::fclose(file);
+
+    CaptureJournalReader reader;
+    std::vector<uint8_t> data;
+    FrameInfo            info;
+    if (!haveIndex || !reader.open(path) || reader.frameCount() != FRAME_COUNT ||
+        reader.readFrame(0, data, info) || !reader.readFrame(1, data, info))
+    {
+        std::cout << "FAIL: a damaged index or frame size was not caught" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief A journal of another version is refused, not misread or replayed as a raw strip
+ */
+bool rejectsOtherVersion(const std::string &path, const FrameMode &mode)
+{
+    std::FILE *file = std::fopen(path.c_str(), "r+b");
+    if (!file)
+    {
+        std::cout << "FAIL: could not reopen " << path << std::endl;
+        return false;
+    }
+    const uint8_t version[4] = {1, 0, 0, 0};
+    std::fseek(file, 8, SEEK_SET);
+    std::fwrite(version, 1, sizeof(version), file);
+    std::fclose(file);
+
+    CaptureJournalReader reader;
+    if (reader.open(path) || ReplaySource::openFile(path, mode))
+    {
+        std::cout << "FAIL: a journal of another version was opened" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Replay in real time and check the delivered rate against the mode's frame rate
+ */
+bool replayPaced(const FrameMode &mode)
+{
+    std::vector<std::vector<uint8_t>> frames(1, testFrame(0, mode.frameBytes()));
+    auto source = std::make_unique<MemoryReplaySource>(mode, std::move(frames));
+
+    Knokke scanner(std::make_unique<ReplayTransport>(
+        std::move(source), ReplayTransport::Pacing::REAL_TIME, true));
+    std::atomic<uint64_t> count(0);
+    scanner.setFrameCallback([&count](const uint8_t *, size_t, uint64_t) { ++count; });
+
+    if (scanner.connect() != Knokke::Error::SUCCESS ||
+        scanner.startStreaming() != Knokke::Error::SUCCESS)
+    {
+        std::cout << "FAIL: could not start the paced replay" << std::endl;
+        return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(PACED_MS));
+    scanner.stopStreaming();
+    scanner.disconnect();
+
+    const double rate     = count * 1000.0 / PACED_MS;
+    const double expected = mode.frameRate();
+    std::cout << "Real-time replay: " << rate << " fps (mode " << expected << " fps)" << std::endl;
+    if (rate < expected * (1 - PACING_TOLERANCE) || rate > expected * (1 + PACING_TOLERANCE))
+    {
+        std::cout << "FAIL: real-time replay is off the mode's frame rate" << std::endl;
+        return false;
+    }
+    return true;
+}
+} // namespace
+
+int main()
+{
+    const FrameMode   mode           = testMode();
+    const std::string journalPath    = "test_replay.journal";
+    const std::string compressedPath = "test_replay.lz4.journal";
+    const std::string stripPath      = "test_replay.raw";
+
+    if (!writeJournal(journalPath, mode, false))
+    {
+        return 1;
+    }
+
+    // The same frames as a headerless strip of lines
+    {
+        std::FILE *strip = std::fopen(stripPath.c_str(), "wb");
+        if (!strip)
+        {
+            std::cout << "FAIL: could not create " << stripPath << std::endl;
+            return 1;
+        }
+        for (int i = 0; i < FRAME_COUNT; ++i)
+        {
+            const std::vector<uint8_t> frame = testFrame(i, mode.frameBytes());
+            std::fwrite(frame.data(), 1, frame.size(), strip);
+        }
+        std::fclose(strip);
+    }
+
+    bool ok = replayMatches(ReplaySource::openFile(journalPath, FrameMode()), "Journal") &&
+              replayMatches(ReplaySource::openFile(stripPath, mode), "Raw strip") &&
+              replayPaced(mode) && survivesDamage(journalPath) &&
+              rejectsOtherVersion(journalPath, mode);
+
+    // Compressed frames must come back byte for byte as well
+    if (ok && CaptureJournal::compressionAvailable())
+    {
+        ok = writeJournal(compressedPath, mode, true) &&
+             replayMatches(ReplaySource::openFile(compressedPath, FrameMode()), "LZ4 journal");
+    }
+
+    std::remove(journalPath.c_str());
+    std::remove(compressedPath.c_str());
+    std::remove(stripPath.c_str());
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,149 @@
+#include "scanners/UvcDescriptors.h"
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+FrameMode makeMode(uint8_t format, uint8_t frame, uint16_t width, uint16_t height, uint8_t bits,
+                   uint32_t interval)
+{
+    FrameMode mode;
+    mode.formatIndex   = format;
+    mode.frameIndex    = frame;
+    mode.width         = width;
+    mode.height        = height;
+    mode.bitsPerPixel  = bits;
+    mode.frameInterval = interval;
+    return mode;
+}
+
+// Two formats; the first has a frame with two discrete intervals
+std::vector<FrameMode> testModes()
+{
+    return {makeMode(1, 1, 4096, 1, 16, 100000), makeMode(1, 1, 4096, 1, 16, 200000),
+            makeMode(1, 2, 2048, 1, 16, 50000), makeMode(2, 1, 1024, 4, 8, 400000)};
+}
+
+bool sameModes(const std::vector<FrameMode> &parsed, const std::vector<FrameMode> &expected)
+{
+    if (parsed.size() != expected.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < parsed.size(); ++i)
+    {
+        if (!(parsed[i] == expected[i]) || parsed[i].width != expected[i].width ||
+            parsed[i].height != expected[i].height ||
+            parsed[i].bitsPerPixel != expected[i].bitsPerPixel)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<FrameMode> parse(const std::vector<uint8_t> &bytes)
+{
+    return parseFrameModes(bytes.data(), static_cast<int>(bytes.size()));
+}
+
+bool check(bool condition, const std::string &what)
+{
+    if (!condition)
+    {
+        std::cout << "FAIL: " << what << std::endl;
+    }
+    return condition;
+}
+
+/**
+ * @brief Descriptors built for a set of modes parse back to the same modes
+ */
+bool testRoundTrip()
+{
+    const std::vector<FrameMode> modes = testModes();
+    const std::vector<uint8_t>   bytes = buildStreamingDescriptors(modes);
+
+    // Non-streaming descriptors in between are skipped
+    std::vector<uint8_t> withEndpoint = bytes;
+    const uint8_t        endpoint[]   = {7, 0x05, 0x81, 0x02, 0x00, 0x02, 0x00};
+    withEndpoint.insert(withEndpoint.begin(), endpoint, endpoint + sizeof(endpoint));
+
+    return check(sameModes(parse(bytes), modes), "built descriptors did not parse back") &&
+           check(sameModes(parse(withEndpoint), modes), "an endpoint descriptor broke parsing") &&
+           check(parseFrameModes(nullptr, 64).empty(), "a null buffer produced modes") &&
+           check(parseFrameModes(bytes.data(), 0).empty(), "an empty buffer produced modes");
+}
+
+/**
+ * @brief A buffer cut short keeps the modes of every descriptor that arrived whole
+ */
+bool testTruncated()
+{
+    const std::vector<FrameMode> modes = testModes();
+    const std::vector<uint8_t>   bytes = buildStreamingDescriptors(modes);
+
+    std::vector<FrameMode> firstFormat(modes.begin(), modes.begin() + 3);
+    std::vector<uint8_t>   cut(bytes.begin(), bytes.end() - 1);
+    if (!check(sameModes(parse(cut), firstFormat), "a cut frame descriptor was not dropped"))
+    {
+        return false;
+    }
+
+    // Every shorter prefix parses without reading past the end
+    for (size_t length = 0; length < bytes.size(); ++length)
+    {
+        if (!check(parseFrameModes(bytes.data(), static_cast<int>(length)).size() <= modes.size(),
+                   "a truncated buffer produced extra modes"))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Malformed descriptors are skipped or end the walk, never misread
+ */
+bool testMalformed()
+{
+    const std::vector<FrameMode> modes = testModes();
+    const std::vector<uint8_t>   bytes = buildStreamingDescriptors(modes);
+
+    // bLength of zero would otherwise never advance
+    std::vector<uint8_t> zeroLength = bytes;
+    zeroLength[0]                   = 0;
+
+    // A frame without a format descriptor before it has no format to belong to
+    const std::vector<uint8_t> frameOnly(bytes.begin() + 27, bytes.begin() + 27 + 34);
+
+    // A format descriptor too short to hold bBitsPerPixel orphans the frames that follow
+    std::vector<uint8_t> shortFormat = bytes;
+    shortFormat.erase(shortFormat.begin() + 21, shortFormat.begin() + 27);
+    shortFormat[0] = 21;
+
+    // An interval table longer than the descriptor falls back to the default interval
+    std::vector<uint8_t> badIntervals = bytes;
+    badIntervals[27 + 25]             = 9;
+
+    std::vector<FrameMode> defaultOnly = {modes[0], modes[2], modes[3]};
+    return check(parse(zeroLength).empty(), "a zero-length descriptor was walked past") &&
+           check(parse(frameOnly).empty(), "a frame without a format produced modes") &&
+           check(sameModes(parse(shortFormat), {modes[3]}), "a short format was accepted") &&
+           check(sameModes(parse(badIntervals), defaultOnly),
+                 "an overlong interval table was read");
+}
+} // namespace
+
+int main()
+{
+    bool ok = testRoundTrip() && testTruncated() && testMalformed();
+    if (ok)
+    {
+        std::cout << "UVC descriptors parsed as expected" << std::endl;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,666 @@
+#include "scanners/VirtualKnokke.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+constexpr double RATE_MULTIPLIER    = 10.0; // 4000 fps in the default mode
+constexpr int    SOAK_MS            = 2000;
+constexpr double FRAME_FAULT_RATE   = 0.02; // Per frame, for each of the two frame faults
+constexpr double MIN_DELIVERED      = 0.5;  // Share of the nominal rate that must arrive
+constexpr int    RECOVERY_WAIT_MS   = 2000;
+constexpr int    LOST_RECOVERY_MS   = 200; // Recovery timeout for a device that stays away
+constexpr int    CONTROL_LATENCY_US = 1000;
+constexpr size_t BATCH_FRAMES       = 200;
+constexpr int    PAUSE_CYCLES       = 20;
+constexpr int    RECORD_PHASE_MS    = 30; // Recorded before, during and after a change
+constexpr int    NO_SUCH_CPU        = 4096; // Beyond every platform's affinity mask
+
+/**
+ * @brief Counts what arrives and checks every frame against the device's pattern
+ */
+class FrameChecker
+{
+  public:
+    void onFrame(const uint8_t *data, const FrameInfo &info)
+    {
+        uint64_t                    sequence = 0;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_frames;
+        m_thread = std::this_thread::get_id();
+        if (!VirtualKnokke::checkFrame(data, info.size, &sequence))
+        {
+            ++m_corrupt;
+            return;
+        }
+
+        // Every frame the device sent in between must be reported as lost
+        if (m_haveSequence && sequence - m_lastSequence != info.gapCount + 1ull)
+        {
+            ++m_gapMismatches;
+        }
+        m_lastSequence = sequence;
+        m_haveSequence = true;
+    }
+
+    uint64_t frames() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_frames;
+    }
+
+    std::thread::id thread() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_thread;
+    }
+
+    bool check(const std::string &phase) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_corrupt != 0 || m_gapMismatches != 0)
+        {
+            std::cout << "FAIL: " << phase << ": " << m_corrupt << " corrupt frames, "
+                      << m_gapMismatches << " misreported gaps" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    void reset()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_frames       = 0;
+        m_haveSequence = false;
+    }
+
+  private:
+    mutable std::mutex m_mutex;
+    uint64_t           m_frames        = 0;
+    uint64_t           m_corrupt       = 0;
+    uint64_t           m_gapMismatches = 0;
+    uint64_t           m_lastSequence  = 0;
+    bool               m_haveSequence  = false;
+    std::thread::id    m_thread; // Thread the last frame was delivered on
+};
+
+bool waitForFrames(const FrameChecker &checker, uint64_t count)
+{
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(RECOVERY_WAIT_MS);
+    while (checker.frames() < count)
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+        {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return true;
+}
+
+bool waitForRecovery(const Knokke &scanner, uint64_t recoveries)
+{
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(RECOVERY_WAIT_MS);
+    while (scanner.getStreamStats().recoveries < recoveries)
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+        {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return true;
+}
+
+bool testControls(Knokke &scanner, VirtualKnokke &device)
+{
+    Knokke::ScannerParams params;
+    params.exposure_time   = 2500;
+    params.gain            = 600;
+    params.backlight.red   = 1000;
+    params.backlight.green = 2000;
+    params.backlight.blue  = 3000;
+    params.motor_speed     = -400;
+
+    const auto start = std::chrono::steady_clock::now();
+    if (scanner.setParameters(params) != Knokke::Error::SUCCESS)
+    {
+        std::cout << "FAIL: parameter writes failed" << std::endl;
+        return false;
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    const Knokke::ScannerParams held = device.parameters();
+    if (held.exposure_time != params.exposure_time || held.gain != params.gain ||
+        held.backlight.red != params.backlight.red ||
+        held.backlight.green != params.backlight.green ||
+        held.backlight.blue != params.backlight.blue || held.motor_speed != params.motor_speed)
+    {
+        std::cout << "FAIL: device does not hold the parameters written" << std::endl;
+        return false;
+    }
+    if (elapsed < std::chrono::microseconds(4 * CONTROL_LATENCY_US))
+    {
+        std::cout << "FAIL: four control writes completed faster than the device latency"
+                  << std::endl;
+        return false;
+    }
+
+    // A timed-out write fails on its own and leaves the next one unaffected
+    device.injectFault(VirtualKnokke::Fault::CONTROL_TIMEOUT);
+    if (scanner.setGain(700) == Knokke::Error::SUCCESS ||
+        scanner.setGain(800) != Knokke::Error::SUCCESS || device.parameters().gain != 800)
+    {
+        std::cout << "FAIL: control timeout was not contained" << std::endl;
+        return false;
+    }
+
+    std::cout << "Controls: written and read back, timeout contained" << std::endl;
+    return true;
+}
+
+/**
+ * @brief Capture a batch from the running stream and check it holds consecutive frames
+ */
+bool testBatch(Knokke &scanner)
+{
+    const size_t                          frameBytes = scanner.getFrameMode().frameBytes();
+    std::vector<uint8_t>                  buffer(BATCH_FRAMES * frameBytes);
+    std::vector<Knokke::BatchFrameStatus> statuses(BATCH_FRAMES);
+
+    if (scanner.captureBatch(buffer.data(), buffer.size(), BATCH_FRAMES, statuses.data()) !=
+        Knokke::Error::SUCCESS)
+    {
+        std::cout << "FAIL: batch capture failed" << std::endl;
+        return false;
+    }
+
+    uint64_t previous = 0;
+    for (size_t i = 0; i < BATCH_FRAMES; ++i)
+    {
+        uint64_t sequence = 0;
+        if (statuses[i].status != Knokke::Error::SUCCESS ||
+            !VirtualKnokke::checkFrame(buffer.data() + i * frameBytes, frameBytes, &sequence) ||
+            (i > 0 && sequence != previous + statuses[i].info.gapCount + 1))
+        {
+            std::cout << "FAIL: batch frame " << i << " is not the next frame of the stream"
+                      << std::endl;
+            return false;
+        }
+        previous = sequence;
+    }
+
+    std::cout << "Batch: " << BATCH_FRAMES << " consecutive frames captured" << std::endl;
+    return true;
+}
+
+/**
+ * @brief Pause and resume the running stream, then stop and start it again
+ *
+ * Nothing may arrive while paused, the first frame after a resume must follow within about a
+ * frame period, and every frame must come from the same engine thread throughout.
+ */
+bool testPauseResume(Knokke &scanner, FrameChecker &checker)
+{
+    const auto framePeriod = std::chrono::duration<double, std::micro>(
+        1e6 / scanner.getFrameMode().frameRate());
+    const std::thread::id engine = checker.thread();
+
+    std::vector<double> latencies;
+    for (int cycle = 0; cycle < PAUSE_CYCLES; ++cycle)
+    {
+        if (scanner.pauseStreaming() != Knokke::Error::SUCCESS || !scanner.isPaused())
+        {
+            std::cout << "FAIL: could not pause" << std::endl;
+            return false;
+        }
+        const uint64_t paused = checker.frames();
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        if (checker.frames() != paused)
+        {
+            std::cout << "FAIL: frames delivered while paused" << std::endl;
+            return false;
+        }
+
+        // Poll finely here, waitForFrames() is far too coarse to time a single frame
+        checker.reset();
+        const auto start    = std::chrono::steady_clock::now();
+        const auto deadline = start + std::chrono::milliseconds(RECOVERY_WAIT_MS);
+        if (scanner.resumeStreaming() != Knokke::Error::SUCCESS)
+        {
+            std::cout << "FAIL: could not resume" << std::endl;
+            return false;
+        }
+        while (checker.frames() == 0)
+        {
+            if (std::chrono::steady_clock::now() > deadline)
+            {
+                std::cout << "FAIL: stream did not resume" << std::endl;
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+        latencies.push_back(
+            std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start)
+                .count());
+    }
+
+    // Stopping parks the same engine, the next start wakes it again
+    scanner.stopStreaming();
+    checker.reset();
+    if (scanner.startStreaming() != Knokke::Error::SUCCESS || !waitForFrames(checker, 10) ||
+        !checker.check("pause"))
+    {
+        std::cout << "FAIL: stream did not restart" << std::endl;
+        return false;
+    }
+    if (checker.thread() != engine)
+    {
+        std::cout << "FAIL: frames arrive on a new thread after pause and restart" << std::endl;
+        return false;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    const double median = latencies[latencies.size() / 2];
+    std::cout << "Pause/resume: first frame after " << median << " us (median), frame period "
+              << framePeriod.count() << " us" << std::endl;
+    if (median > framePeriod.count())
+    {
+        std::cout << "FAIL: resuming takes longer than a frame period" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Record across an exposure change and check each frame's journaled parameters
+ *
+ * Every recorded frame must find the state of its generation in the journal, and that state
+ * must be the exposure the frame was taken with: the old one, the changed one, then the old
+ * one again.
+ */
+bool testRecordingGenerations(Knokke &scanner)
+{
+    const std::string path = "test_virtual_device.journal";
+    uint32_t          base = 0;
+    if (scanner.getExposureTime(base) != Knokke::Error::SUCCESS ||
+        scanner.startRecording(path) != Knokke::Error::SUCCESS)
+    {
+        std::cout << "FAIL: could not start recording" << std::endl;
+        return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(RECORD_PHASE_MS));
+    scanner.setExposureTime(base + 500);
+    std::this_thread::sleep_for(std::chrono::milliseconds(RECORD_PHASE_MS));
+    scanner.setExposureTime(base);
+    std::this_thread::sleep_for(std::chrono::milliseconds(RECORD_PHASE_MS));
+    scanner.stopRecording();
+
+    CaptureJournalReader reader;
+    if (!reader.open(path))
+    {
+        std::cout << "FAIL: could not read the recording back" << std::endl;
+        return false;
+    }
+
+    // Exposures in the order the frames saw them, one entry per run
+    std::vector<uint32_t> exposures;
+    std::vector<uint8_t>  data;
+    bool                  ok = true;
+    for (size_t i = 0; i < reader.frameCount() && ok; ++i)
+    {
+        FrameInfo         info;
+        JournalParameters parameters;
+        ok = reader.readFrame(i, data, info) &&
+             reader.parametersFor(info.parameterGeneration, parameters);
+        if (ok && (exposures.empty() || exposures.back() != parameters.exposureTime))
+        {
+            exposures.push_back(parameters.exposureTime);
+        }
+    }
+    reader.close();
+    std::remove(path.c_str());
+
+    if (!ok || exposures != std::vector<uint32_t>{base, base + 500, base})
+    {
+        std::cout << "FAIL: recorded frames do not carry the parameters they were exposed with"
+                  << std::endl;
+        return false;
+    }
+    std::cout << "Recording: parameters journaled with the generation they open" << std::endl;
+    return true;
+}
+
+/**
+ * @brief Stream with real-time options the process cannot fully apply
+ *
+ * Pinning to a core that does not exist always fails; priority and memory locking fail too
+ * unless the test runs privileged. Either way the stream must run and the status must say
+ * what was skipped.
+ */
+bool testRealtimeDegrades()
+{
+    VirtualKnokke::Options options;
+    options.rateMultiplier = RATE_MULTIPLIER;
+    Knokke       scanner(std::make_unique<VirtualKnokke>(options));
+    FrameChecker checker;
+    scanner.setFrameInfoCallback([&checker](const uint8_t *data, const FrameInfo &info)
+                                 { checker.onFrame(data, info); });
+
+    Knokke::RealtimeOptions realtime;
+    realtime.enabled    = true;
+    realtime.priority   = 1;
+    realtime.captureCpu = NO_SUCH_CPU;
+    if (scanner.connect() != Knokke::Error::SUCCESS ||
+        scanner.setRealtimeOptions(realtime) != Knokke::Error::SUCCESS ||
+        scanner.startStreaming() != Knokke::Error::SUCCESS)
+    {
+        std::cout << "FAIL: could not stream with real-time options" << std::endl;
+        return false;
+    }
+
+    // The engine has tried the thread options by the time the start returns
+    const Knokke::RealtimeStatus started = scanner.getRealtimeStatus();
+    if (started.affinity || started.message.empty())
+    {
+        std::cout << "FAIL: the real-time status was read before the engine reported it"
+                  << std::endl;
+        scanner.stopStreaming();
+        return false;
+    }
+    bool streamed = waitForFrames(checker, 100) && checker.check("real-time");
+    scanner.stopStreaming();
+    const Knokke::RealtimeStatus first = scanner.getRealtimeStatus();
+
+    // A second start reuses the buffers and must report them as they are, not as requested
+    streamed = streamed && scanner.startStreaming() == Knokke::Error::SUCCESS &&
+               waitForFrames(checker, checker.frames() + 100);
+    scanner.stopStreaming();
+    scanner.disconnect();
+
+    const Knokke::RealtimeStatus status = scanner.getRealtimeStatus();
+    if (status.memoryLocked != first.memoryLocked)
+    {
+        std::cout << "FAIL: a restart reported memory as locked differently" << std::endl;
+        return false;
+    }
+    if (!streamed || status.affinity || status.message.empty())
+    {
+        std::cout << "FAIL: real-time options that could not be applied stopped the stream or "
+                     "went unreported"
+                  << std::endl;
+        return false;
+    }
+    std::cout << "Real-time: priority " << (status.priority ? "applied" : "skipped")
+              << ", memory " << (status.memoryLocked ? "locked" : "not locked") << " ("
+              << status.message << ")" << std::endl;
+    return true;
+}
+
+/**
+ * @brief Wait for frames one after another, then check a paused and a stopped stream
+ */
+bool testWaitForFrame(Knokke &scanner)
+{
+    FrameLease frame;
+    uint64_t   seen = Knokke::NO_FRAME;
+    for (int i = 0; i < 100; ++i)
+    {
+        if (scanner.waitForFrame(seen, frame) != Knokke::Error::SUCCESS ||
+            (seen != Knokke::NO_FRAME && frame.info().frameNumber <= seen))
+        {
+            std::cout << "FAIL: waitForFrame did not return a newer frame" << std::endl;
+            return false;
+        }
+        seen = frame.info().frameNumber;
+    }
+
+    // Nothing newer arrives while paused
+    scanner.pauseStreaming();
+    seen = scanner.leaseLatestFrame().info().frameNumber;
+    if (scanner.waitForFrame(seen, frame, 50) != Knokke::Error::TIMEOUT)
+    {
+        std::cout << "FAIL: waitForFrame returned a frame while paused" << std::endl;
+        return false;
+    }
+
+    // Stopping wakes a waiter at once instead of leaving it to its timeout
+    Knokke::Error result = Knokke::Error::SUCCESS;
+    std::thread   waiter(
+        [&scanner, &result, seen]()
+        {
+            FrameLease ignored;
+            result = scanner.waitForFrame(seen, ignored, RECOVERY_WAIT_MS);
+        });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    const auto start = std::chrono::steady_clock::now();
+    scanner.stopStreaming();
+    waiter.join();
+    if (result != Knokke::Error::STREAMING_NOT_STARTED ||
+        std::chrono::steady_clock::now() - start > std::chrono::milliseconds(RECOVERY_WAIT_MS / 2))
+    {
+        std::cout << "FAIL: stopping did not wake a waitForFrame caller" << std::endl;
+        return false;
+    }
+
+    std::cout << "Wait for frame: woken by each new frame and by stopping" << std::endl;
+    return true;
+}
+
+/**
+ * @brief A device that stays away stops the stream, which starts again once it is back
+ */
+bool testStreamLost(Knokke                 &scanner,
+                    VirtualKnokke          &device,
+                    FrameChecker           &checker,
+                    const std::atomic<int> &streamsLost)
+{
+    if (scanner.setRecoveryTimeout(LOST_RECOVERY_MS) != Knokke::Error::SUCCESS ||
+        scanner.startStreaming() != Knokke::Error::SUCCESS ||
+        !waitForFrames(checker, checker.frames() + 100))
+    {
+        std::cout << "FAIL: could not stream before losing the device" << std::endl;
+        return false;
+    }
+
+    // Waiters return once recovery gives up instead of running into their timeout
+    FrameLease    frame;
+    uint64_t      seen = scanner.leaseLatestFrame().info().frameNumber;
+    Knokke::Error result;
+    device.injectFault(VirtualKnokke::Fault::DISCONNECT);
+    while ((result = scanner.waitForFrame(seen, frame, RECOVERY_WAIT_MS)) ==
+           Knokke::Error::SUCCESS)
+    {
+        seen = frame.info().frameNumber;
+    }
+    frame.reset();
+    if (result != Knokke::Error::STREAMING_NOT_STARTED || scanner.isStreaming() ||
+        streamsLost != 1)
+    {
+        std::cout << "FAIL: a device that stayed away did not stop the stream" << std::endl;
+        return false;
+    }
+
+    device.reconnect();
+    if (scanner.startStreaming() != Knokke::Error::SUCCESS ||
+        !waitForFrames(checker, checker.frames() + 100))
+    {
+        std::cout << "FAIL: stream did not start again after it was lost" << std::endl;
+        return false;
+    }
+    scanner.stopStreaming();
+
+    std::cout << "Lost device: stream stopped and started again" << std::endl;
+    return true;
+}
+
+} // namespace
+
+int main()
+{
+    VirtualKnokke::Options options;
+    options.rateMultiplier   = RATE_MULTIPLIER;
+    options.controlLatencyUs = CONTROL_LATENCY_US;
+    options.bulkTimeoutMs    = 100;
+
+    auto           transport = std::make_unique<VirtualKnokke>(options);
+    VirtualKnokke &device    = *transport;
+    Knokke         scanner(std::move(transport));
+
+    FrameChecker     checker;
+    std::atomic<int> usbErrors(0);
+    std::atomic<int> streamsLost(0);
+    scanner.setFrameInfoCallback([&checker](const uint8_t *data, const FrameInfo &info)
+                                 { checker.onFrame(data, info); });
+    scanner.setErrorCallback(
+        [&usbErrors, &streamsLost](Knokke::Error error, const std::string &)
+        {
+            if (error == Knokke::Error::USB_ERROR)
+            {
+                ++usbErrors;
+            }
+            else if (error == Knokke::Error::STREAM_LOST)
+            {
+                ++streamsLost;
+            }
+        });
+
+    if (!testRealtimeDegrades() || scanner.connect() != Knokke::Error::SUCCESS ||
+        !testControls(scanner, device))
+    {
+        return 1;
+    }
+
+    if (scanner.startStreaming() != Knokke::Error::SUCCESS)
+    {
+        std::cout << "FAIL: could not start streaming" << std::endl;
+        return 1;
+    }
+    if (!testBatch(scanner) || !testPauseResume(scanner, checker) ||
+        !testRecordingGenerations(scanner))
+    {
+        return 1;
+    }
+
+    // Soak: torn frames at random must be dropped and reported, never delivered
+    device.setFaultProbability(VirtualKnokke::Fault::SHORT_FRAME, FRAME_FAULT_RATE);
+    device.setFaultProbability(VirtualKnokke::Fault::MISSING_EOF, FRAME_FAULT_RATE);
+    std::this_thread::sleep_for(std::chrono::milliseconds(SOAK_MS));
+    device.setFaultProbability(VirtualKnokke::Fault::SHORT_FRAME, 0);
+    device.setFaultProbability(VirtualKnokke::Fault::MISSING_EOF, 0);
+
+    // Let a clean frame follow the last faulty one so its loss has been counted, then pause so
+    // no frame is halfway through its callback while the counters are compared
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    scanner.pauseStreaming();
+    const double nominal = scanner.getFrameMode().frameRate() * RATE_MULTIPLIER * SOAK_MS / 1000;
+    const uint64_t            delivered = checker.frames();
+    const Knokke::StreamStats stats     = scanner.getStreamStats();
+    std::cout << "Stats: " << stats.framesPerSecond << " fps, " << stats.bytesPerSecond / 1e6
+              << " MB/s, " << stats.completeFrames << " complete, " << stats.incompleteFrames
+              << " incomplete, callbacks p99 " << stats.callbackTime.percentileUs(99) << " us"
+              << std::endl;
+    std::cout << "Soak: " << checker.frames() << " frames of " << nominal << " nominal, "
+              << scanner.getLostFrameCount() << " lost, "
+              << device.faultCount(VirtualKnokke::Fault::SHORT_FRAME) << " short, "
+              << device.faultCount(VirtualKnokke::Fault::MISSING_EOF) << " without EOF"
+              << std::endl;
+    const uint64_t faults = device.faultCount(VirtualKnokke::Fault::SHORT_FRAME) +
+                            device.faultCount(VirtualKnokke::Fault::MISSING_EOF);
+    if (stats.incompleteFrames < faults || stats.completeFrames < delivered ||
+        stats.framesPerSecond <= 0 || stats.callbackTime.count < delivered)
+    {
+        std::cout << "FAIL: stream statistics do not match what was delivered" << std::endl;
+        return 1;
+    }
+
+    // Rates are over the time the stream ran, a pause does not dilute them
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    if (scanner.getStreamStats().elapsedSeconds != stats.elapsedSeconds)
+    {
+        std::cout << "FAIL: paused time counted towards the stream statistics" << std::endl;
+        return 1;
+    }
+    if (!checker.check("soak") || checker.frames() < nominal * MIN_DELIVERED ||
+        scanner.getLostFrameCount() < faults)
+    {
+        std::cout << "FAIL: soak" << std::endl;
+        return 1;
+    }
+
+    // The stream picks up by itself once a silent device sends again
+    checker.reset();
+    scanner.resumeStreaming();
+    device.injectFault(VirtualKnokke::Fault::BULK_TIMEOUT);
+    if (!waitForFrames(checker, 100) || !checker.check("bulk timeout"))
+    {
+        std::cout << "FAIL: stream did not resume after a bulk timeout" << std::endl;
+        return 1;
+    }
+    std::cout << "Bulk timeout: stream resumed" << std::endl;
+
+    // A halted endpoint is reported and cleared without stopping the stream; the frame it cut
+    // off shows up as a gap
+    const int      errorsBeforeStall = usbErrors;
+    const uint64_t generation        = scanner.getParameterGeneration();
+    device.injectFault(VirtualKnokke::Fault::STALL);
+    if (!waitForRecovery(scanner, 1) || usbErrors == errorsBeforeStall ||
+        !waitForFrames(checker, checker.frames() + 100) || !checker.check("stall"))
+    {
+        std::cout << "FAIL: endpoint stall was not reported or not recovered" << std::endl;
+        return 1;
+    }
+    std::cout << "Stall: recovered in " << scanner.getStreamStats().recoveryTime.maxUs / 1000
+              << " ms" << std::endl;
+
+    // A device that vanishes and comes back reset is re-claimed and gets its parameters back
+    const int errorsBeforeDisconnect = usbErrors;
+    device.injectFault(VirtualKnokke::Fault::DISCONNECT);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    if (usbErrors == errorsBeforeDisconnect || !device.isDisconnected())
+    {
+        std::cout << "FAIL: disconnect was not reported" << std::endl;
+        return 1;
+    }
+    device.reconnect();
+    if (!waitForRecovery(scanner, 2) || !waitForFrames(checker, checker.frames() + 100) ||
+        !checker.check("disconnect"))
+    {
+        std::cout << "FAIL: stream did not resume after reconnecting" << std::endl;
+        return 1;
+    }
+    const Knokke::ScannerParams restored = device.parameters();
+    if (restored.exposure_time != 2500 || restored.gain != 800 ||
+        restored.backlight.green != 2000 || restored.motor_speed != -400)
+    {
+        std::cout << "FAIL: parameters were not restored after reconnecting" << std::endl;
+        return 1;
+    }
+
+    // Writing the same values back is no parameter change
+    if (scanner.getParameterGeneration() != generation)
+    {
+        std::cout << "FAIL: recovery opened a new parameter generation" << std::endl;
+        return 1;
+    }
+    std::cout << "Disconnect: recovered with parameters restored" << std::endl;
+
+    if (!testWaitForFrame(scanner) || !testStreamLost(scanner, device, checker, streamsLost))
+    {
+        return 1;
+    }
+
+    scanner.disconnect();
+    return 0;
+}